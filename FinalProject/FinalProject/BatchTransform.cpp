@@ -0,0 +1,532 @@
+#include "BatchTransform.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BATCH_TRANSFORM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC allows any intrinsic in any function; GCC and Clang need the instruction set enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_SSE
+#define TARGET_AVX2
+#endif
+
+// ---------------
+// TransformArrays
+// ---------------
+
+size_t TransformArrays::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	rotationX.push_back(rotation.x);
+	rotationY.push_back(rotation.y);
+	rotationZ.push_back(rotation.z);
+	rotationW.push_back(rotation.w);
+	scaleX.push_back(scale.x);
+	scaleY.push_back(scale.y);
+	scaleZ.push_back(scale.z);
+	return positionX.size() - 1;
+}
+
+void TransformArrays::Resize(size_t count)
+{
+	positionX.resize(count, 0.0f);
+	positionY.resize(count, 0.0f);
+	positionZ.resize(count, 0.0f);
+	rotationX.resize(count, 0.0f);
+	rotationY.resize(count, 0.0f);
+	rotationZ.resize(count, 0.0f);
+	rotationW.resize(count, 1.0f);
+	scaleX.resize(count, 1.0f);
+	scaleY.resize(count, 1.0f);
+	scaleZ.resize(count, 1.0f);
+}
+
+// ---------------
+// CPU detection
+// ---------------
+
+#if BATCH_TRANSFORM_X86
+static void Cpuid(int info[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = static_cast<int>(a);
+	info[1] = static_cast<int>(b);
+	info[2] = static_cast<int>(c);
+	info[3] = static_cast<int>(d);
+#endif
+}
+
+/// <summary>
+/// Reads the XCR0 register, which tells which register sets the operating system saves on context switches.
+/// </summary>
+static unsigned long long ReadXcr0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+static SimdLevel DetectSimdLevelUncached()
+{
+#if BATCH_TRANSFORM_X86
+	int info[4];
+	Cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+
+	Cpuid(info, 1, 0);
+	bool hasSse2 = (info[3] & (1 << 26)) != 0;
+	bool hasFma = (info[2] & (1 << 12)) != 0;
+	bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+	bool hasAvx = (info[2] & (1 << 28)) != 0;
+	if (!hasSse2)
+	{
+		return SimdScalar;
+	}
+
+	// AVX registers are only usable if the OS saves the upper halves (XMM and YMM state enabled in XCR0)
+	bool osSavesAvx = hasOsxsave && (ReadXcr0() & 0x6) == 0x6;
+	if (hasAvx && hasFma && osSavesAvx && maxLeaf >= 7)
+	{
+		Cpuid(info, 7, 0);
+		if ((info[1] & (1 << 5)) != 0)
+		{
+			return SimdAvx2;
+		}
+	}
+	return SimdSse;
+#else
+	return SimdScalar;
+#endif
+}
+
+SimdLevel DetectSimdLevel()
+{
+	static const SimdLevel level = DetectSimdLevelUncached();
+	return level;
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdSse:
+		return "SSE";
+	case SimdAvx2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
+// ---------------
+// Scalar kernels
+// ---------------
+
+static void ComposeScalar(const TransformArrays& t, size_t first, size_t count, const float* viewProjection, float* models, float* modelViewProjections)
+{
+	for (size_t j = 0; j < count; j++)
+	{
+		size_t i = first + j;
+		float x = t.rotationX[i], y = t.rotationY[i], z = t.rotationZ[i], w = t.rotationW[i];
+		float sx = t.scaleX[i], sy = t.scaleY[i], sz = t.scaleZ[i];
+
+		float xx = x * x, yy = y * y, zz = z * z;
+		float xy = x * y, xz = x * z, yz = y * z;
+		float wx = w * x, wy = w * y, wz = w * z;
+
+		// Columns of the rotation matrix, scaled per axis, then the translation
+		float* m = models + j * 16;
+		m[0] = (1.0f - 2.0f * (yy + zz)) * sx;
+		m[1] = 2.0f * (xy + wz) * sx;
+		m[2] = 2.0f * (xz - wy) * sx;
+		m[3] = 0.0f;
+		m[4] = 2.0f * (xy - wz) * sy;
+		m[5] = (1.0f - 2.0f * (xx + zz)) * sy;
+		m[6] = 2.0f * (yz + wx) * sy;
+		m[7] = 0.0f;
+		m[8] = 2.0f * (xz + wy) * sz;
+		m[9] = 2.0f * (yz - wx) * sz;
+		m[10] = (1.0f - 2.0f * (xx + yy)) * sz;
+		m[11] = 0.0f;
+		m[12] = t.positionX[i];
+		m[13] = t.positionY[i];
+		m[14] = t.positionZ[i];
+		m[15] = 1.0f;
+
+		if (viewProjection != nullptr)
+		{
+			float* result = modelViewProjections + j * 16;
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					result[c * 4 + r] = viewProjection[r] * m[c * 4] + viewProjection[4 + r] * m[c * 4 + 1]
+						+ viewProjection[8 + r] * m[c * 4 + 2] + viewProjection[12 + r] * m[c * 4 + 3];
+				}
+			}
+		}
+	}
+}
+
+static void MultiplyScalar(const float* left, const float* rights, float* results, size_t count)
+{
+	for (size_t j = 0; j < count; j++)
+	{
+		const float* right = rights + j * 16;
+		float* result = results + j * 16;
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				result[c * 4 + r] = left[r] * right[c * 4] + left[4 + r] * right[c * 4 + 1]
+					+ left[8 + r] * right[c * 4 + 2] + left[12 + r] * right[c * 4 + 3];
+			}
+		}
+	}
+}
+
+#if BATCH_TRANSFORM_X86
+
+// ---------------
+// SSE kernels
+// ---------------
+
+/// <summary>
+/// Writes one matrix column of 4 objects. Register k holds row k of the column for all 4 objects.
+/// </summary>
+TARGET_SSE static inline void StoreColumn4(__m128 r0, __m128 r1, __m128 r2, __m128 r3, float* matrices, int column)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(matrices + 0 * 16 + column * 4, r0);
+	_mm_storeu_ps(matrices + 1 * 16 + column * 4, r1);
+	_mm_storeu_ps(matrices + 2 * 16 + column * 4, r2);
+	_mm_storeu_ps(matrices + 3 * 16 + column * 4, r3);
+}
+
+TARGET_SSE static size_t ComposeSse(const TransformArrays& t, size_t first, size_t count, const float* viewProjection, float* models, float* modelViewProjections)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 vp[16];
+	if (viewProjection != nullptr)
+	{
+		for (int k = 0; k < 16; k++)
+		{
+			vp[k] = _mm_set1_ps(viewProjection[k]);
+		}
+	}
+
+	size_t j = 0;
+	for (; j + 4 <= count; j += 4)
+	{
+		size_t i = first + j;
+		__m128 x = _mm_loadu_ps(&t.rotationX[i]);
+		__m128 y = _mm_loadu_ps(&t.rotationY[i]);
+		__m128 z = _mm_loadu_ps(&t.rotationZ[i]);
+		__m128 w = _mm_loadu_ps(&t.rotationW[i]);
+		__m128 sx = _mm_loadu_ps(&t.scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&t.scaleY[i]);
+		__m128 sz = _mm_loadu_ps(&t.scaleZ[i]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// m[c][r] for 4 objects at once
+		__m128 m[4][4];
+		m[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		m[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		m[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		m[0][3] = zero;
+		m[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		m[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		m[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		m[1][3] = zero;
+		m[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		m[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		m[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		m[2][3] = zero;
+		m[3][0] = _mm_loadu_ps(&t.positionX[i]);
+		m[3][1] = _mm_loadu_ps(&t.positionY[i]);
+		m[3][2] = _mm_loadu_ps(&t.positionZ[i]);
+		m[3][3] = one;
+
+		float* modelOut = models + j * 16;
+		for (int c = 0; c < 4; c++)
+		{
+			StoreColumn4(m[c][0], m[c][1], m[c][2], m[c][3], modelOut, c);
+		}
+
+		if (viewProjection != nullptr)
+		{
+			float* resultOut = modelViewProjections + j * 16;
+			for (int c = 0; c < 4; c++)
+			{
+				__m128 column[4];
+				for (int r = 0; r < 4; r++)
+				{
+					// The last row of the model matrix is (0, 0, 0, 1), so only column 3 picks up vp[3][r]
+					__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vp[r], m[c][0]), _mm_mul_ps(vp[4 + r], m[c][1])),
+						_mm_mul_ps(vp[8 + r], m[c][2]));
+					column[r] = c == 3 ? _mm_add_ps(sum, vp[12 + r]) : sum;
+				}
+				StoreColumn4(column[0], column[1], column[2], column[3], resultOut, c);
+			}
+		}
+	}
+	return j;
+}
+
+TARGET_SSE static size_t MultiplySse(const float* left, const float* rights, float* results, size_t count)
+{
+	__m128 l0 = _mm_loadu_ps(left);
+	__m128 l1 = _mm_loadu_ps(left + 4);
+	__m128 l2 = _mm_loadu_ps(left + 8);
+	__m128 l3 = _mm_loadu_ps(left + 12);
+
+	for (size_t j = 0; j < count; j++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			__m128 column = _mm_loadu_ps(rights + j * 16 + c * 4);
+			__m128 result = _mm_mul_ps(l0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+			result = _mm_add_ps(result, _mm_mul_ps(l1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+			result = _mm_add_ps(result, _mm_mul_ps(l2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+			result = _mm_add_ps(result, _mm_mul_ps(l3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(results + j * 16 + c * 4, result);
+		}
+	}
+	return count;
+}
+
+// ---------------
+// AVX2 kernels
+// ---------------
+
+/// <summary>
+/// Writes one matrix column of 8 objects. Register k holds row k of the column for all 8 objects.
+/// </summary>
+TARGET_AVX2 static inline void StoreColumn8(__m256 r0, __m256 r1, __m256 r2, __m256 r3, float* matrices, int column)
+{
+	// Transpose the 4x4 blocks inside both 128-bit halves: the low halves hold objects 0-3, the high halves 4-7
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	__m256 o0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 o1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 o2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 o3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+	float* out = matrices + column * 4;
+	_mm_storeu_ps(out + 0 * 16, _mm256_castps256_ps128(o0));
+	_mm_storeu_ps(out + 1 * 16, _mm256_castps256_ps128(o1));
+	_mm_storeu_ps(out + 2 * 16, _mm256_castps256_ps128(o2));
+	_mm_storeu_ps(out + 3 * 16, _mm256_castps256_ps128(o3));
+	_mm_storeu_ps(out + 4 * 16, _mm256_extractf128_ps(o0, 1));
+	_mm_storeu_ps(out + 5 * 16, _mm256_extractf128_ps(o1, 1));
+	_mm_storeu_ps(out + 6 * 16, _mm256_extractf128_ps(o2, 1));
+	_mm_storeu_ps(out + 7 * 16, _mm256_extractf128_ps(o3, 1));
+}
+
+TARGET_AVX2 static size_t ComposeAvx2(const TransformArrays& t, size_t first, size_t count, const float* viewProjection, float* models, float* modelViewProjections)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 vp[16];
+	if (viewProjection != nullptr)
+	{
+		for (int k = 0; k < 16; k++)
+		{
+			vp[k] = _mm256_set1_ps(viewProjection[k]);
+		}
+	}
+
+	size_t j = 0;
+	for (; j + 8 <= count; j += 8)
+	{
+		size_t i = first + j;
+		__m256 x = _mm256_loadu_ps(&t.rotationX[i]);
+		__m256 y = _mm256_loadu_ps(&t.rotationY[i]);
+		__m256 z = _mm256_loadu_ps(&t.rotationZ[i]);
+		__m256 w = _mm256_loadu_ps(&t.rotationW[i]);
+		__m256 sx = _mm256_loadu_ps(&t.scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&t.scaleY[i]);
+		__m256 sz = _mm256_loadu_ps(&t.scaleZ[i]);
+
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		// m[c][r] for 8 objects at once; 1 - 2a is computed as fnmadd(2, a, 1)
+		__m256 m[4][4];
+		m[0][0] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx);
+		m[0][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		m[0][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		m[0][3] = zero;
+		m[1][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		m[1][1] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy);
+		m[1][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		m[1][3] = zero;
+		m[2][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		m[2][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		m[2][2] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz);
+		m[2][3] = zero;
+		m[3][0] = _mm256_loadu_ps(&t.positionX[i]);
+		m[3][1] = _mm256_loadu_ps(&t.positionY[i]);
+		m[3][2] = _mm256_loadu_ps(&t.positionZ[i]);
+		m[3][3] = one;
+
+		float* modelOut = models + j * 16;
+		for (int c = 0; c < 4; c++)
+		{
+			StoreColumn8(m[c][0], m[c][1], m[c][2], m[c][3], modelOut, c);
+		}
+
+		if (viewProjection != nullptr)
+		{
+			float* resultOut = modelViewProjections + j * 16;
+			for (int c = 0; c < 4; c++)
+			{
+				__m256 column[4];
+				for (int r = 0; r < 4; r++)
+				{
+					// The last row of the model matrix is (0, 0, 0, 1), so only column 3 picks up vp[3][r]
+					__m256 sum = c == 3 ? vp[12 + r] : zero;
+					sum = _mm256_fmadd_ps(vp[r], m[c][0], sum);
+					sum = _mm256_fmadd_ps(vp[4 + r], m[c][1], sum);
+					column[r] = _mm256_fmadd_ps(vp[8 + r], m[c][2], sum);
+				}
+				StoreColumn8(column[0], column[1], column[2], column[3], resultOut, c);
+			}
+		}
+	}
+	return j;
+}
+
+TARGET_AVX2 static size_t MultiplyAvx2(const float* left, const float* rights, float* results, size_t count)
+{
+	// Every column of the left matrix is repeated in both halves, so two columns of the right matrix are done at once
+	__m256 l0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left));
+	__m256 l1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 4));
+	__m256 l2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 8));
+	__m256 l3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 12));
+
+	for (size_t j = 0; j < count; j++)
+	{
+		for (int c = 0; c < 4; c += 2)
+		{
+			__m256 columns = _mm256_loadu_ps(rights + j * 16 + c * 4);
+			__m256 result = _mm256_mul_ps(l0, _mm256_permute_ps(columns, _MM_SHUFFLE(0, 0, 0, 0)));
+			result = _mm256_fmadd_ps(l1, _mm256_permute_ps(columns, _MM_SHUFFLE(1, 1, 1, 1)), result);
+			result = _mm256_fmadd_ps(l2, _mm256_permute_ps(columns, _MM_SHUFFLE(2, 2, 2, 2)), result);
+			result = _mm256_fmadd_ps(l3, _mm256_permute_ps(columns, _MM_SHUFFLE(3, 3, 3, 3)), result);
+			_mm256_storeu_ps(results + j * 16 + c * 4, result);
+		}
+	}
+	return count;
+}
+
+#endif
+
+// ---------------
+// Dispatch
+// ---------------
+
+void ComposeTransforms(const TransformArrays& transforms, size_t first, size_t count, const glm::mat4* viewProjection,
+	glm::mat4* models, glm::mat4* modelViewProjections, SimdLevel level)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const float* viewProjectionData = viewProjection != nullptr ? glm::value_ptr(*viewProjection) : nullptr;
+	float* modelData = glm::value_ptr(models[0]);
+	float* resultData = viewProjection != nullptr ? glm::value_ptr(modelViewProjections[0]) : nullptr;
+
+	// The vector kernels handle whole groups of objects; whatever is left over goes through the scalar kernel
+	size_t done = 0;
+#if BATCH_TRANSFORM_X86
+	if (level == SimdAvx2)
+	{
+		done = ComposeAvx2(transforms, first, count, viewProjectionData, modelData, resultData);
+	}
+	else if (level == SimdSse)
+	{
+		done = ComposeSse(transforms, first, count, viewProjectionData, modelData, resultData);
+	}
+#endif
+
+	if (done < count)
+	{
+		ComposeScalar(transforms, first + done, count - done, viewProjectionData, modelData + done * 16,
+			resultData != nullptr ? resultData + done * 16 : nullptr);
+	}
+}
+
+void ComposeTransforms(const TransformArrays& transforms, size_t first, size_t count, const glm::mat4* viewProjection,
+	glm::mat4* models, glm::mat4* modelViewProjections)
+{
+	ComposeTransforms(transforms, first, count, viewProjection, models, modelViewProjections, DetectSimdLevel());
+}
+
+void MultiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count, SimdLevel level)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const float* leftData = glm::value_ptr(left);
+	const float* rightData = glm::value_ptr(rights[0]);
+	float* resultData = glm::value_ptr(results[0]);
+
+	size_t done = 0;
+#if BATCH_TRANSFORM_X86
+	if (level == SimdAvx2)
+	{
+		done = MultiplyAvx2(leftData, rightData, resultData, count);
+	}
+	else if (level == SimdSse)
+	{
+		done = MultiplySse(leftData, rightData, resultData, count);
+	}
+#endif
+
+	if (done < count)
+	{
+		MultiplyScalar(leftData, rightData + done * 16, resultData + done * 16, count - done);
+	}
+}
+
+void MultiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count)
+{
+	MultiplyMatrices(left, rights, results, count, DetectSimdLevel());
+}
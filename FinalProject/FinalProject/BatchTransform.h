@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/// <summary>
+/// Instruction sets that the batch transform kernels can run on.
+/// </summary>
+enum SimdLevel
+{
+	SimdScalar = 0,
+	SimdSse,		// 4 objects per iteration
+	SimdAvx2,		// 8 objects per iteration, with fused multiply-add
+	SimdLevelCount
+};
+
+/// <summary>
+/// Translation, rotation and scale of many objects, stored as one array per component (structure of arrays)
+/// so that the kernels can load the same component of 4 or 8 objects with one instruction.
+/// </summary>
+struct TransformArrays
+{
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;	// Unit quaternion
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	/// <summary>
+	/// Appends a transform.
+	/// </summary>
+	/// <returns>Index of the transform</returns>
+	size_t Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	/// <summary>
+	/// Changes the number of transforms; new transforms are identities.
+	/// </summary>
+	void Resize(size_t count);
+
+	size_t Size() const { return positionX.size(); }
+};
+
+/// <returns>The best instruction set supported by this CPU and operating system (checked once)</returns>
+SimdLevel DetectSimdLevel();
+
+/// <returns>Human-readable name of an instruction set</returns>
+const char* GetSimdLevelName(SimdLevel level);
+
+/// <summary>
+/// Builds the model matrices (translation * rotation * scale) of a range of transforms and, optionally,
+/// their products with a view-projection matrix.
+/// </summary>
+/// <param name="transforms">Source transforms</param>
+/// <param name="first">First transform to process</param>
+/// <param name="count">Number of transforms to process</param>
+/// <param name="viewProjection">Projection * view matrix, or nullptr to only build the model matrices</param>
+/// <param name="models">Receives count model matrices</param>
+/// <param name="modelViewProjections">Receives count projection * view * model matrices (ignored if viewProjection is nullptr)</param>
+/// <param name="level">Instruction set to use; it must be supported (see DetectSimdLevel())</param>
+void ComposeTransforms(const TransformArrays& transforms, size_t first, size_t count, const glm::mat4* viewProjection,
+	glm::mat4* models, glm::mat4* modelViewProjections, SimdLevel level);
+
+/// <summary>
+/// Same as above, with the best instruction set of this machine.
+/// </summary>
+void ComposeTransforms(const TransformArrays& transforms, size_t first, size_t count, const glm::mat4* viewProjection,
+	glm::mat4* models, glm::mat4* modelViewProjections);
+
+/// <summary>
+/// Multiplies one matrix with many matrices: results[i] = left * rights[i].
+/// </summary>
+/// <param name="level">Instruction set to use; it must be supported (see DetectSimdLevel())</param>
+void MultiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count, SimdLevel level);
+
+/// <summary>
+/// Same as above, with the best instruction set of this machine.
+/// </summary>
+void MultiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count);
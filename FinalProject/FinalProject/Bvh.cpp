@@ -0,0 +1,552 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+// Number of buckets that candidate split positions are binned into along each axis
+static const int SahBinCount = 12;
+
+// Relative cost of visiting a node compared to testing an item
+static const float SahTraversalCost = 1.0f;
+
+// Leaves never hold more than this many items, even if the heuristic prefers not to split
+static const int MaxLeafItems = 8;
+
+// Below this depth, nodes are split at the median instead of with the heuristic. Median splits halve the item
+// count, so no leaf is deeper than this plus log2 of the item count (at most 31), however lopsided the SAH splits are.
+static const int MaxSahDepth = 32;
+
+// Entries of the traversal stacks; a traversal holds at most one entry per level plus one
+static const int TraversalStackSize = MaxSahDepth + 32 + 1;
+
+// ---------------
+// Aabb
+// ---------------
+
+Aabb Aabb::Empty()
+{
+	Aabb box;
+	box.min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	return box;
+}
+
+Aabb Aabb::Transform(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix)
+{
+	Aabb box = Empty();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		box.Extend(glm::vec3(matrix * glm::vec4(position, 1.0f)));
+	}
+	return box;
+}
+
+void Aabb::Extend(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void Aabb::Extend(const Aabb& other)
+{
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+}
+
+float Aabb::SurfaceArea() const
+{
+	glm::vec3 size = max - min;
+	if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+	{
+		return 0.0f;
+	}
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool Aabb::Overlaps(const Aabb& other) const
+{
+	return min.x <= other.max.x && max.x >= other.min.x
+		&& min.y <= other.max.y && max.y >= other.min.y
+		&& min.z <= other.max.z && max.z >= other.min.z;
+}
+
+bool Aabb::IntersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const
+{
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax)
+		{
+			return false;
+		}
+	}
+
+	distance = tMin;
+	return true;
+}
+
+// ---------------
+// Frustum
+// ---------------
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann plane extraction from the rows of the matrix
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];	// Left
+	frustum.planes[1] = rows[3] - rows[0];	// Right
+	frustum.planes[2] = rows[3] + rows[1];	// Bottom
+	frustum.planes[3] = rows[3] - rows[1];	// Top
+	frustum.planes[4] = rows[3] + rows[2];	// Near
+	frustum.planes[5] = rows[3] - rows[2];	// Far
+	return frustum;
+}
+
+bool Frustum::Intersects(const Aabb& box) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		// Test the corner of the box that is farthest along the plane normal
+		glm::vec3 farthest(plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (plane.x * farthest.x + plane.y * farthest.y + plane.z * farthest.z + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool IntersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction,
+	const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& distance)
+{
+	glm::vec3 edge1 = b - a;
+	glm::vec3 edge2 = c - a;
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::fabs(determinant) < 1e-10f)
+	{
+		return false;
+	}
+
+	float inverseDeterminant = 1.0f / determinant;
+	glm::vec3 toOrigin = origin - a;
+	float u = glm::dot(toOrigin, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+
+	glm::vec3 q = glm::cross(toOrigin, edge1);
+	float v = glm::dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+
+	float t = glm::dot(edge2, q) * inverseDeterminant;
+	if (t <= 0.0f)
+	{
+		return false;
+	}
+
+	distance = t;
+	return true;
+}
+
+// ---------------
+// Bvh
+// ---------------
+
+void Bvh::Build(const std::vector<Aabb>& bounds)
+{
+	itemBounds = bounds;
+	itemOrder.resize(bounds.size());
+	itemLeaf.assign(bounds.size(), 0);
+	for (size_t i = 0; i < bounds.size(); i++)
+	{
+		itemOrder[i] = static_cast<int>(i);
+	}
+
+	nodes.clear();
+	if (bounds.empty())
+	{
+		return;
+	}
+
+	// A binary tree with n leaves has at most 2n - 1 nodes
+	nodes.reserve(bounds.size() * 2);
+
+	Node root;
+	root.first = 0;
+	root.count = static_cast<int>(bounds.size());
+	root.parent = -1;
+	nodes.push_back(root);
+	Subdivide(0, 0, static_cast<int>(bounds.size()), 0);
+}
+
+void Bvh::Subdivide(int nodeIndex, int begin, int end, int depth)
+{
+	Aabb nodeBounds = Aabb::Empty();
+	Aabb centroidBounds = Aabb::Empty();
+	for (int i = begin; i < end; i++)
+	{
+		nodeBounds.Extend(itemBounds[itemOrder[i]]);
+		centroidBounds.Extend(itemBounds[itemOrder[i]].Center());
+	}
+
+	nodes[nodeIndex].bounds = nodeBounds;
+	nodes[nodeIndex].first = begin;
+	nodes[nodeIndex].count = end - begin;
+
+	int count = end - begin;
+	if (count <= 1)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			itemLeaf[itemOrder[i]] = nodeIndex;
+		}
+		return;
+	}
+
+	// Evaluate the surface area heuristic at the bucket boundaries of every axis
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+
+		Aabb binBounds[SahBinCount];
+		int binCounts[SahBinCount] = {};
+		for (int b = 0; b < SahBinCount; b++)
+		{
+			binBounds[b] = Aabb::Empty();
+		}
+
+		float scale = SahBinCount / extent;
+		for (int i = begin; i < end; i++)
+		{
+			const Aabb& box = itemBounds[itemOrder[i]];
+			int bin = std::min(SahBinCount - 1, static_cast<int>((box.Center()[axis] - centroidBounds.min[axis]) * scale));
+			binBounds[bin].Extend(box);
+			binCounts[bin]++;
+		}
+
+		// Sweep from both sides to get the area and count on each side of every boundary
+		float leftAreas[SahBinCount - 1];
+		int leftCounts[SahBinCount - 1];
+		Aabb running = Aabb::Empty();
+		int runningCount = 0;
+		for (int b = 0; b < SahBinCount - 1; b++)
+		{
+			running.Extend(binBounds[b]);
+			runningCount += binCounts[b];
+			leftAreas[b] = running.SurfaceArea();
+			leftCounts[b] = runningCount;
+		}
+
+		running = Aabb::Empty();
+		runningCount = 0;
+		for (int b = SahBinCount - 1; b > 0; b--)
+		{
+			running.Extend(binBounds[b]);
+			runningCount += binCounts[b];
+			int split = b - 1;
+			if (leftCounts[split] == 0 || runningCount == 0)
+			{
+				continue;
+			}
+
+			float cost = leftAreas[split] * leftCounts[split] + running.SurfaceArea() * runningCount;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	float parentArea = nodeBounds.SurfaceArea();
+	float leafCost = static_cast<float>(count);
+	float splitCost = parentArea > 0.0f ? SahTraversalCost + bestCost / parentArea : FLT_MAX;
+
+	// Keep the node as a leaf if splitting does not pay off (or is impossible)
+	if (bestAxis < 0 || (splitCost >= leafCost && count <= MaxLeafItems))
+	{
+		if (bestAxis < 0 && count > MaxLeafItems)
+		{
+			// All centroids coincide, so split in the middle of the list to keep leaves small
+			bestAxis = 0;
+		}
+		else
+		{
+			for (int i = begin; i < end; i++)
+			{
+				itemLeaf[itemOrder[i]] = nodeIndex;
+			}
+			return;
+		}
+	}
+
+	int middle;
+	float extent = centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis];
+	if (depth >= MaxSahDepth)
+	{
+		// Too deep: split at the median along the axis with the largest centroid spread
+		glm::vec3 spread = centroidBounds.max - centroidBounds.min;
+		int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+		middle = begin + count / 2;
+		std::nth_element(itemOrder.begin() + begin, itemOrder.begin() + middle, itemOrder.begin() + end, [&](int a, int b)
+		{
+			return itemBounds[a].Center()[axis] < itemBounds[b].Center()[axis];
+		});
+	}
+	else if (extent > 0.0f)
+	{
+		float scale = SahBinCount / extent;
+		int* split = std::partition(itemOrder.data() + begin, itemOrder.data() + end, [&](int item)
+		{
+			int bin = std::min(SahBinCount - 1, static_cast<int>((itemBounds[item].Center()[bestAxis] - centroidBounds.min[bestAxis]) * scale));
+			return bin <= bestSplit;
+		});
+		middle = static_cast<int>(split - itemOrder.data());
+	}
+	else
+	{
+		middle = begin + count / 2;
+	}
+
+	if (middle == begin || middle == end)
+	{
+		middle = begin + count / 2;
+	}
+
+	int leftIndex = static_cast<int>(nodes.size());
+	Node child;
+	child.parent = nodeIndex;
+	child.first = 0;
+	child.count = 0;
+	nodes.push_back(child);
+	nodes.push_back(child);
+
+	nodes[nodeIndex].first = leftIndex;
+	nodes[nodeIndex].count = 0;
+
+	Subdivide(leftIndex, begin, middle, depth + 1);
+	Subdivide(leftIndex + 1, middle, end, depth + 1);
+}
+
+void Bvh::Update(int item, const Aabb& bounds)
+{
+	itemBounds[item] = bounds;
+
+	int nodeIndex = itemLeaf[item];
+	while (nodeIndex >= 0)
+	{
+		RefitNode(nodeIndex);
+		nodeIndex = nodes[nodeIndex].parent;
+	}
+}
+
+void Bvh::RefitNode(int nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+	if (node.count > 0)
+	{
+		node.bounds = Aabb::Empty();
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			node.bounds.Extend(itemBounds[itemOrder[i]]);
+		}
+	}
+	else
+	{
+		node.bounds = nodes[node.first].bounds;
+		node.bounds.Extend(nodes[node.first + 1].bounds);
+	}
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<int>& items) const
+{
+	items.clear();
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	int stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!frustum.Intersects(node.bounds))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				if (frustum.Intersects(itemBounds[itemOrder[i]]))
+				{
+					items.push_back(itemOrder[i]);
+				}
+			}
+		}
+		else
+		{
+			assert(stackSize + 2 <= TraversalStackSize);
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+}
+
+void Bvh::QueryAabb(const Aabb& box, std::vector<int>& items) const
+{
+	items.clear();
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	int stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!box.Overlaps(node.bounds))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				if (box.Overlaps(itemBounds[itemOrder[i]]))
+				{
+					items.push_back(itemOrder[i]);
+				}
+			}
+		}
+		else
+		{
+			assert(stackSize + 2 <= TraversalStackSize);
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+}
+
+bool Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+	const std::function<bool(int, float&)>& intersectItem, int& hitItem, float& hitDistance) const
+{
+	hitItem = -1;
+	hitDistance = maxDistance;
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	int stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		float boxDistance;
+		if (!node.bounds.IntersectRay(origin, inverseDirection, hitDistance, boxDistance))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				int item = itemOrder[i];
+				if (!itemBounds[item].IntersectRay(origin, inverseDirection, hitDistance, boxDistance))
+				{
+					continue;
+				}
+
+				if (intersectItem)
+				{
+					if (intersectItem(item, hitDistance))
+					{
+						hitItem = item;
+					}
+				}
+				else if (boxDistance < hitDistance)
+				{
+					hitDistance = boxDistance;
+					hitItem = item;
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearer child first so that farther subtrees are more likely to be rejected
+			assert(stackSize + 2 <= TraversalStackSize);
+			float leftDistance, rightDistance;
+			bool hitLeft = nodes[node.first].bounds.IntersectRay(origin, inverseDirection, hitDistance, leftDistance);
+			bool hitRight = nodes[node.first + 1].bounds.IntersectRay(origin, inverseDirection, hitDistance, rightDistance);
+			if (hitLeft && hitRight)
+			{
+				if (leftDistance < rightDistance)
+				{
+					stack[stackSize++] = node.first + 1;
+					stack[stackSize++] = node.first;
+				}
+				else
+				{
+					stack[stackSize++] = node.first;
+					stack[stackSize++] = node.first + 1;
+				}
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = node.first;
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+	}
+
+	return hitItem >= 0;
+}
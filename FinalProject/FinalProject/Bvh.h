@@ -0,0 +1,139 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Axis-aligned bounding box.
+/// </summary>
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	/// <returns>A box that contains nothing, which can be grown with Extend()</returns>
+	static Aabb Empty();
+
+	/// <returns>The world-space box around an object-space box transformed by the given matrix</returns>
+	static Aabb Transform(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix);
+
+	void Extend(const glm::vec3& point);
+	void Extend(const Aabb& other);
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	float SurfaceArea() const;
+	bool Overlaps(const Aabb& other) const;
+
+	/// <summary>
+	/// Intersects a ray with the box (slab test).
+	/// </summary>
+	/// <param name="origin">Ray origin</param>
+	/// <param name="inverseDirection">1 / ray direction, per component</param>
+	/// <param name="maxDistance">Only hits closer than this count</param>
+	/// <param name="distance">Receives the distance along the ray where it enters the box</param>
+	/// <returns>True if the ray hits the box</returns>
+	bool IntersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const;
+};
+
+/// <summary>
+/// The six planes of a view volume, extracted from a projection * view matrix.
+/// Works for both perspective (camera) and orthographic (directional light) projections.
+/// </summary>
+struct Frustum
+{
+	glm::vec4 planes[6];	// Plane normals point into the volume
+
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+	/// <returns>False if the box is completely outside of the volume</returns>
+	bool Intersects(const Aabb& box) const;
+};
+
+/// <summary>
+/// Intersects a ray with a triangle (Moller-Trumbore). Both sides of the triangle count as hits.
+/// </summary>
+/// <param name="distance">Receives the distance along the ray, in multiples of the direction</param>
+/// <returns>True if the ray hits the triangle in front of its origin</returns>
+bool IntersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction,
+	const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& distance);
+
+/// <summary>
+/// Bounding volume hierarchy over a set of items (scene objects, triangles, ...) identified by their index.
+/// Nodes are stored in one flat array and built top-down with the surface area heuristic.
+/// When items move, Update() refits the boxes along the path to the root instead of rebuilding the tree.
+/// </summary>
+class Bvh
+{
+public:
+	/// <summary>
+	/// Builds the hierarchy from scratch.
+	/// </summary>
+	/// <param name="bounds">Bounding box of every item; the item's index is what the queries return</param>
+	void Build(const std::vector<Aabb>& bounds);
+
+	/// <summary>
+	/// Changes the bounding box of one item and refits its leaf and all of the leaf's ancestors.
+	/// </summary>
+	void Update(int item, const Aabb& bounds);
+
+	/// <summary>
+	/// Collects every item whose box is at least partially inside the frustum.
+	/// </summary>
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& items) const;
+
+	/// <summary>
+	/// Collects every item whose box overlaps the given box.
+	/// </summary>
+	void QueryAabb(const Aabb& box, std::vector<int>& items) const;
+
+	/// <summary>
+	/// Finds the closest item hit by a ray.
+	/// </summary>
+	/// <param name="origin">Ray origin</param>
+	/// <param name="direction">Ray direction (does not need to be normalized; distances are in multiples of it)</param>
+	/// <param name="maxDistance">Only hits closer than this count</param>
+	/// <param name="intersectItem">Optional exact test for an item whose box is hit. It receives the item and the
+	/// current closest distance, and returns true (updating the distance) if the item is hit closer than that.
+	/// If empty, the distance to the item's box is used.</param>
+	/// <param name="hitItem">Receives the closest item that was hit</param>
+	/// <param name="hitDistance">Receives the distance to the closest hit</param>
+	/// <returns>True if anything was hit</returns>
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+		const std::function<bool(int, float&)>& intersectItem, int& hitItem, float& hitDistance) const;
+
+	/// <returns>Number of items in the hierarchy</returns>
+	size_t GetItemCount() const { return itemBounds.size(); }
+
+	/// <returns>Bounding box of an item</returns>
+	const Aabb& GetItemBounds(int item) const { return itemBounds[item]; }
+
+private:
+	/// <summary>
+	/// Node of the hierarchy. Inner nodes store their two children next to each other starting at 'first';
+	/// leaves store 'count' items starting at 'first' in the item order array.
+	/// </summary>
+	struct Node
+	{
+		Aabb bounds;
+		int first;
+		int count;	// 0 for inner nodes
+		int parent;
+	};
+
+	/// <summary>
+	/// Recursively splits the items [begin, end) of the item order array below the given node.
+	/// </summary>
+	/// <param name="depth">Depth of the node; deep nodes are split at the median to bound the tree's depth</param>
+	void Subdivide(int nodeIndex, int begin, int end, int depth);
+
+	/// <summary>
+	/// Recomputes the box of a node from its items or its children.
+	/// </summary>
+	void RefitNode(int nodeIndex);
+
+	std::vector<Node> nodes;
+	std::vector<int> itemOrder;		// Items sorted so that every leaf owns a contiguous range
+	std::vector<int> itemLeaf;		// Leaf node that contains each item
+	std::vector<Aabb> itemBounds;
+};
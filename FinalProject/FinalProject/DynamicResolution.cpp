@@ -0,0 +1,135 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "RenderStats.h"
+
+// Lowest and highest resolution scale (per axis)
+static const float MinScale = 0.5f;
+static const float MaxScale = 1.0f;
+
+// Largest change of the scale per measured frame; going down is allowed to be faster than going up
+static const float MaxScaleDownStep = 0.85f;
+static const float MaxScaleUpStep = 1.05f;
+
+// The scale only goes up once the GPU is this much faster than the target, so it doesn't oscillate around it
+static const double ScaleUpHeadroom = 1.15;
+
+void DynamicResolution::Create(int windowWidth, int windowHeight, double targetFrameTime)
+{
+	this->targetFrameTime = targetFrameTime;
+	this->windowWidth = windowWidth;
+	this->windowHeight = windowHeight;
+	UpdateRenderSize();
+
+	if (queries[0] == 0)
+	{
+		glGenQueries(GpuTimerQueryCount, queries);
+	}
+}
+
+void DynamicResolution::Destroy()
+{
+	if (queries[0] != 0)
+	{
+		glDeleteQueries(GpuTimerQueryCount, queries);
+		std::fill(queries, queries + GpuTimerQueryCount, 0u);
+		std::fill(queryPending, queryPending + GpuTimerQueryCount, false);
+	}
+}
+
+void DynamicResolution::Resize(int windowWidth, int windowHeight)
+{
+	this->windowWidth = windowWidth;
+	this->windowHeight = windowHeight;
+	UpdateRenderSize();
+}
+
+void DynamicResolution::BeginFrame()
+{
+	// Collect the results of the frames that the GPU has finished, oldest first. The slot of queryIndex is the oldest
+	// one: it is the next to be reused. The GPU finishes the frames in order, so the first result that isn't
+	// available yet ends the search; a newer result is never applied before an older one.
+	for (int i = 0; i < GpuTimerQueryCount; i++)
+	{
+		int index = (queryIndex + i) % GpuTimerQueryCount;
+		if (!queryPending[index])
+		{
+			continue;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			break;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+		queryPending[index] = false;
+		gpuFrameTime = elapsed / 1000000.0;
+
+		scaleSum += scale;
+		measuredFrames++;
+
+		if (enabled && gpuFrameTime > 0.0)
+		{
+			double ratio = targetFrameTime / gpuFrameTime;
+			if (ratio < 1.0 || ratio > ScaleUpHeadroom)
+			{
+				float factor = static_cast<float>(std::sqrt(ratio));
+				factor = std::min(std::max(factor, MaxScaleDownStep), MaxScaleUpStep);
+				scale = std::min(std::max(scale * factor, MinScale), MaxScale);
+			}
+		}
+	}
+
+	UpdateRenderSize();
+
+	// If the query of this slot is still in flight, the GPU is more than a few frames behind; skip timing this frame
+	if (!queryPending[queryIndex])
+	{
+		glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+	}
+}
+
+void DynamicResolution::EndFrame()
+{
+	if (!queryPending[queryIndex])
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		queryPending[queryIndex] = true;
+		queryIndex = (queryIndex + 1) % GpuTimerQueryCount;
+	}
+}
+
+void DynamicResolution::Present(GLuint sourceFramebuffer, GLuint targetFramebuffer) const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+
+	// A linear filter only pays off when the image is actually stretched
+	GLenum filter = (renderWidth == windowWidth && renderHeight == windowHeight) ? GL_NEAREST : GL_LINEAR;
+	glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, filter);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	RenderStats::CountStateChange(2);
+}
+
+void DynamicResolution::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+	if (!enabled)
+	{
+		scale = MaxScale;
+		UpdateRenderSize();
+	}
+}
+
+void DynamicResolution::UpdateRenderSize()
+{
+	renderWidth = std::max(1, static_cast<int>(windowWidth * scale));
+	renderHeight = std::max(1, static_cast<int>(windowHeight * scale));
+}
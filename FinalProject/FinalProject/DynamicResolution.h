@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Number of GPU timer queries in flight; results are read a few frames late so that reading never stalls
+const int GpuTimerQueryCount = 4;
+
+/// <summary>
+/// Picks the resolution that the scene is rendered at from the measured GPU frame time.
+///
+/// The GPU time of every frame is measured with GL_TIME_ELAPSED queries. When the GPU is slower than the target
+/// frame time, the resolution scale goes down (and back up when there is headroom); since the cost of a frame is
+/// mostly proportional to the number of pixels, the scale is changed by the square root of the time ratio.
+/// The render targets are allocated at the full window size (by the render graph) and only the scaled
+/// sub-rectangle is rendered into, so changing the scale never reallocates anything. The result is stretched to
+/// the window with a linear blit.
+/// </summary>
+class DynamicResolution
+{
+public:
+	/// <summary>
+	/// Creates the timer queries.
+	/// </summary>
+	/// <param name="windowWidth">Width of the window's framebuffer</param>
+	/// <param name="windowHeight">Height of the window's framebuffer</param>
+	/// <param name="targetFrameTime">GPU time per frame to aim for, in milliseconds</param>
+	void Create(int windowWidth, int windowHeight, double targetFrameTime);
+
+	/// <summary>
+	/// Deletes the timer queries.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Follows a new window size.
+	/// </summary>
+	void Resize(int windowWidth, int windowHeight);
+
+	/// <summary>
+	/// Reads the finished timer queries, updates the resolution scale, and starts timing the new frame.
+	/// </summary>
+	void BeginFrame();
+
+	/// <summary>
+	/// Stops timing the frame. Call after Present(), so that the blit is measured too.
+	/// </summary>
+	void EndFrame();
+
+	/// <summary>
+	/// Stretches the rendered sub-rectangle over the whole window.
+	/// </summary>
+	/// <param name="sourceFramebuffer">Framebuffer with the rendered image as its color attachment</param>
+	/// <param name="targetFramebuffer">Framebuffer of the window's size to present into (0 for the window's)</param>
+	void Present(GLuint sourceFramebuffer, GLuint targetFramebuffer) const;
+
+	/// <summary>
+	/// Turns scaling on or off. When off, the scale is fixed at 1 (native resolution).
+	/// </summary>
+	void SetEnabled(bool enabled);
+
+	bool IsEnabled() const { return enabled; }
+	int GetRenderWidth() const { return renderWidth; }
+	int GetRenderHeight() const { return renderHeight; }
+	int GetWindowWidth() const { return windowWidth; }
+	int GetWindowHeight() const { return windowHeight; }
+	float GetScale() const { return scale; }
+
+	/// <returns>Most recent GPU frame time in milliseconds</returns>
+	double GetGpuFrameTime() const { return gpuFrameTime; }
+
+	/// <returns>Average resolution scale over all measured frames</returns>
+	double GetAverageScale() const { return measuredFrames > 0 ? scaleSum / measuredFrames : scale; }
+
+private:
+	/// <summary>
+	/// Computes the render size from the window size and the current scale.
+	/// </summary>
+	void UpdateRenderSize();
+
+	GLuint queries[GpuTimerQueryCount] = {};
+	bool queryPending[GpuTimerQueryCount] = {};
+	int queryIndex = 0;
+
+	int windowWidth = 0;
+	int windowHeight = 0;
+	int renderWidth = 0;
+	int renderHeight = 0;
+
+	bool enabled = true;
+	float scale = 1.0f;
+	double targetFrameTime = 16.0;
+	double gpuFrameTime = 0.0;
+
+	double scaleSum = 0.0;
+	long long measuredFrames = 0;
+};
@@ -0,0 +1,294 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// stb_image_write.h is not part of the project: like stb_image.h, it comes from https://github.com/nothings/stb
+// (public domain) and has to be copied into the include directory next to stb_image.h
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "Profiler.h"
+
+#if defined(_WIN32)
+#define OpenPipe(command) _popen(command, "wb")
+#define ClosePipe(pipe) _pclose(pipe)
+#else
+#define OpenPipe(command) popen(command, "w")
+#define ClosePipe(pipe) pclose(pipe)
+#endif
+
+// How long a single glClientWaitSync call may block before we try again (in nanoseconds)
+static const GLuint64 FenceWaitTimeout = 1000000;
+
+FrameCapture::~FrameCapture()
+{
+	// Without a GL context, only the worker and the pipe can be cleaned up here; Stop() should have been called
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		frameQueued.notify_all();
+		worker.join();
+	}
+	if (pipe != nullptr)
+	{
+		ClosePipe(pipe);
+		pipe = nullptr;
+	}
+}
+
+bool FrameCapture::Start(int width, int height, CaptureOutput output, const std::string& target)
+{
+	if (active)
+	{
+		return true;
+	}
+
+	this->width = width;
+	this->height = height;
+	this->output = output;
+	this->target = target;
+
+	if (output == CapturePipe)
+	{
+		pipe = OpenPipe(target.c_str());
+		if (pipe == nullptr)
+		{
+			std::cerr << "Unable to start capture command: " << target << std::endl;
+			return false;
+		}
+	}
+	else
+	{
+		// OpenGL reads the bottom row first, image files start with the top row
+		stbi_flip_vertically_on_write(1);
+	}
+
+	GLsizeiptr frameSize = static_cast<GLsizeiptr>(width) * height * 4;
+	glGenBuffers(CaptureRingSize, pixelBuffers);
+	for (int i = 0; i < CaptureRingSize; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	ringIndex = 0;
+	capturedFrames = 0;
+	droppedFrames = 0;
+	stopping = false;
+	worker = std::thread(&FrameCapture::WorkerLoop, this);
+	active = true;
+
+	std::cout << "Capture started (" << width << "x" << height << ", "
+		<< (output == CapturePipe ? "pipe: " : "PNG files: ") << target << ")" << std::endl;
+	return true;
+}
+
+void FrameCapture::Stop()
+{
+	if (!active)
+	{
+		return;
+	}
+
+	// Everything that was read back is still written
+	CollectFrames(true);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	frameQueued.notify_all();
+	worker.join();
+
+	if (pipe != nullptr)
+	{
+		ClosePipe(pipe);
+		pipe = nullptr;
+	}
+
+	glDeleteBuffers(CaptureRingSize, pixelBuffers);
+	std::fill(pixelBuffers, pixelBuffers + CaptureRingSize, 0u);
+	queue.clear();
+	freeBuffers.clear();
+	active = false;
+
+	std::cout << "Capture stopped: " << capturedFrames << " frames written, " << droppedFrames << " dropped" << std::endl;
+}
+
+void FrameCapture::CaptureFrame(GLuint framebuffer, int width, int height)
+{
+	if (!active)
+	{
+		return;
+	}
+
+	PROFILE_ZONE("Capture frame");
+	CollectFrames(false);
+
+	// A raw stream can't change its frame size, and the pixel buffers are sized for the capture
+	if (width != this->width || height != this->height)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	// The GPU is more than CaptureRingSize frames behind; dropping the frame is better than waiting
+	if (fences[ringIndex] != 0)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	// With a pixel pack buffer bound, glReadPixels only schedules the copy and returns immediately
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[ringIndex]);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	fences[ringIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frameIndices[ringIndex] = nextFrameIndex++;
+	ringIndex = (ringIndex + 1) % CaptureRingSize;
+}
+
+void FrameCapture::CollectFrames(bool wait)
+{
+	size_t frameSize = static_cast<size_t>(width) * height * 4;
+
+	// Oldest readback first, so that frames are queued in order
+	for (int i = 0; i < CaptureRingSize; i++)
+	{
+		int index = (ringIndex + i) % CaptureRingSize;
+		if (fences[index] == 0)
+		{
+			continue;
+		}
+
+		if (wait)
+		{
+			while (true)
+			{
+				GLenum status = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, FenceWaitTimeout);
+				if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED)
+				{
+					break;
+				}
+			}
+		}
+		else if (glClientWaitSync(fences[index], 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			// Later readbacks can't be done either
+			break;
+		}
+		glDeleteSync(fences[index]);
+		fences[index] = 0;
+
+		// Take a buffer from the pool, unless the worker is too far behind
+		CapturedFrame frame;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.size() >= MaxQueuedCaptureFrames)
+			{
+				droppedFrames++;
+				continue;
+			}
+			if (!freeBuffers.empty())
+			{
+				frame.pixels = std::move(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+		}
+		frame.pixels.resize(frameSize);
+		frame.index = frameIndices[index];
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[index]);
+		void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+		if (data != nullptr)
+		{
+			std::memcpy(frame.pixels.data(), data, frameSize);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (data == nullptr)
+		{
+			droppedFrames++;
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(frame));
+		}
+		frameQueued.notify_one();
+		capturedFrames++;
+	}
+}
+
+void FrameCapture::WorkerLoop()
+{
+	Profiler::SetThreadName("Capture worker");
+
+	bool failed = false;
+	while (true)
+	{
+		CapturedFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameQueued.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+			{
+				// Stopping, and every frame has been written
+				break;
+			}
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		// After the first failure (e.g., the pipe was closed), frames are only recycled
+		if (!failed && !WriteFrame(frame))
+		{
+			failed = true;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		freeBuffers.push_back(std::move(frame.pixels));
+	}
+}
+
+bool FrameCapture::WriteFrame(const CapturedFrame& frame)
+{
+	if (output == CapturePipe)
+	{
+		PROFILE_ZONE("Write frame to pipe");
+
+		// OpenGL reads the bottom row first; video encoders expect the top row first, like image files
+		size_t rowSize = static_cast<size_t>(width) * 4;
+		for (int y = height - 1; y >= 0; y--)
+		{
+			if (std::fwrite(frame.pixels.data() + y * rowSize, 1, rowSize, pipe) != rowSize)
+			{
+				std::cerr << "Failed to write frame " << frame.index << " to the capture pipe" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	PROFILE_ZONE("Write PNG");
+	char fileName[1024];
+	std::snprintf(fileName, sizeof(fileName), "%s%06lld.png", target.c_str(), frame.index);
+	if (stbi_write_png(fileName, width, height, 4, frame.pixels.data(), width * 4) == 0)
+	{
+		std::cerr << "Failed to write capture file: " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pixel buffer objects in the readback ring; a frame is mapped this many frames after it was read
+const int CaptureRingSize = 3;
+
+// Frames waiting for the worker at most; beyond that, frames are dropped instead of stalling the renderer
+const int MaxQueuedCaptureFrames = 8;
+
+/// <summary>
+/// Where captured frames go.
+/// </summary>
+enum CaptureOutput
+{
+	CapturePngSequence = 0,	// One PNG file per frame: <target>000000.png, <target>000001.png, ... (numbered on over captures)
+	CapturePipe				// Raw RGBA frames, top row first, written to the standard input of a command (e.g., ffmpeg)
+};
+
+/// <summary>
+/// Captures the frames shown in the window without stalling the renderer.
+///
+/// glReadPixels writes into a pixel buffer object, so the call returns immediately and the copy happens on the GPU.
+/// A fence marks when the copy is done; the buffer is only mapped once its fence has signaled, a few frames later.
+/// The mapped pixels are copied into a pooled buffer and handed to a worker thread that encodes PNG files or writes
+/// the raw frames into a pipe. If the GPU or the worker can't keep up, frames are dropped (and counted) instead.
+///
+/// Frames are written top row first, like image files, although OpenGL reads them bottom row first. For a pipe
+/// into ffmpeg, use for example:
+///   ffmpeg -y -f rawvideo -pix_fmt rgba -s 1920x1080 -r 60 -i - capture.mp4
+/// </summary>
+class FrameCapture
+{
+public:
+	~FrameCapture();
+
+	/// <summary>
+	/// Starts capturing. Creates the pixel buffers and starts the worker thread.
+	/// </summary>
+	/// <param name="width">Width of the captured frames</param>
+	/// <param name="height">Height of the captured frames</param>
+	/// <param name="output">Where the frames go</param>
+	/// <param name="target">File name prefix of the PNG files, or the command to pipe the frames into</param>
+	/// <returns>True if capturing started (false if the pipe could not be opened)</returns>
+	bool Start(int width, int height, CaptureOutput output, const std::string& target);
+
+	/// <summary>
+	/// Stops capturing. The frames already read are still written; waits until the worker is done.
+	/// </summary>
+	void Stop();
+
+	/// <summary>
+	/// Hands the frames whose readback has finished to the worker, then starts reading back the current frame
+	/// from the read framebuffer's color buffer. Call after the frame is complete and before swapping buffers.
+	/// </summary>
+	/// <param name="framebuffer">Framebuffer to read from (0 for the window's back buffer)</param>
+	/// <param name="width">Width of the frame; frames of another size than the capture are skipped</param>
+	/// <param name="height">Height of the frame</param>
+	void CaptureFrame(GLuint framebuffer, int width, int height);
+
+	bool IsActive() const { return active; }
+	long long GetCapturedFrameCount() const { return capturedFrames; }
+	long long GetDroppedFrameCount() const { return droppedFrames; }
+
+private:
+	struct CapturedFrame
+	{
+		std::vector<unsigned char> pixels;
+		long long index;
+	};
+
+	/// <summary>
+	/// Maps the pixel buffers whose fences have signaled and queues their frames.
+	/// </summary>
+	/// <param name="wait">Wait for every pending readback instead of only taking the finished ones</param>
+	void CollectFrames(bool wait);
+
+	/// <summary>
+	/// Writes queued frames until capturing stops and the queue is empty. Runs on the worker thread.
+	/// </summary>
+	void WorkerLoop();
+
+	/// <summary>
+	/// Writes one frame to the output. Runs on the worker thread.
+	/// </summary>
+	/// <returns>False if writing failed</returns>
+	bool WriteFrame(const CapturedFrame& frame);
+
+	bool active = false;
+	CaptureOutput output = CapturePngSequence;
+	std::string target;
+	int width = 0;
+	int height = 0;
+	FILE* pipe = nullptr;
+
+	// Readback ring
+	GLuint pixelBuffers[CaptureRingSize] = {};
+	GLsync fences[CaptureRingSize] = {};
+	long long frameIndices[CaptureRingSize] = {};
+	int ringIndex = 0;
+
+	long long nextFrameIndex = 0;		// Not reset by Start(), so that a new capture doesn't overwrite the last one's files
+	long long capturedFrames = 0;
+	long long droppedFrames = 0;
+
+	// Worker
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable frameQueued;
+	std::deque<CapturedFrame> queue;
+	std::vector<std::vector<unsigned char>> freeBuffers;
+	bool stopping = false;
+};
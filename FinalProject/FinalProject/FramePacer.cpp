@@ -0,0 +1,273 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include "Profiler.h"
+
+// Frames separated by more than this (e.g., while the window was minimized or dragged) are not counted
+static const double MaxCountedFrameTime = 0.25;
+
+// How often the GPU clock offset is measured again, in seconds
+static const double CalibrationInterval = 1.0;
+
+// How long a single glClientWaitSync call may block before we try again (in nanoseconds)
+static const GLuint64 FenceWaitTimeout = 1000000;
+
+void FramePacer::Create(PresentMode mode, double frameRateCap, int maxQueuedFrames)
+{
+	startTime = std::chrono::steady_clock::now();
+	framePeriod = 1.0 / frameRateCap;
+	this->maxQueuedFrames = std::min(std::max(maxQueuedFrames, 1), FramePacerSlotCount - 1);
+
+	glGenQueries(FramePacerSlotCount, queries);
+	CalibrateGpuClock();
+
+	// Force the swap interval to be set
+	this->mode = PresentModeCount;
+	SetMode(mode);
+}
+
+void FramePacer::Destroy()
+{
+	for (int i = 0; i < FramePacerSlotCount; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		queryPending[i] = false;
+	}
+
+	if (queries[0] != 0)
+	{
+		glDeleteQueries(FramePacerSlotCount, queries);
+		std::fill(queries, queries + FramePacerSlotCount, 0u);
+	}
+}
+
+void FramePacer::SetMode(PresentMode mode)
+{
+	if (mode == this->mode)
+	{
+		return;
+	}
+
+	if (this->mode != PresentModeCount && frameCount > 0)
+	{
+		PrintStats();
+	}
+
+	this->mode = mode;
+	glfwSwapInterval(mode == PresentVsync || mode == PresentLowLatency ? 1 : 0);
+	nextFrameStart = Now();
+	lastFrameEnd = -1.0;
+	ResetStats();
+}
+
+void FramePacer::WaitForFrameStart()
+{
+	PROFILE_ZONE("Wait for frame start");
+
+	if (mode == PresentLowLatency)
+	{
+		// Don't start reading input before the GPU has finished all but maxQueuedFrames - 1 frames,
+		// so the frame that uses the input isn't stuck behind a queue of older frames
+		CollectFrames(maxQueuedFrames - 1);
+	}
+	else
+	{
+		CollectFrames(FramePacerSlotCount);
+	}
+
+	if (mode == PresentCapped)
+	{
+		SleepUntil(nextFrameStart);
+
+		// Schedule from the planned start, so that the average rate is exact; after a long frame, start over from now
+		// instead of rushing a burst of frames to catch up
+		double now = Now();
+		nextFrameStart = std::max(nextFrameStart + framePeriod, now);
+	}
+
+	if (Now() - lastCalibration > CalibrationInterval)
+	{
+		CalibrateGpuClock();
+	}
+}
+
+void FramePacer::MarkInputSampled()
+{
+	inputTime = Now();
+}
+
+void FramePacer::EndFrame()
+{
+	// If the slot's query is still in flight, the GPU is more than FramePacerSlotCount frames behind; skip measuring
+	if (!queryPending[slot])
+	{
+		glQueryCounter(queries[slot], GL_TIMESTAMP);
+		queryPending[slot] = true;
+		inputTimes[slot] = inputTime;
+
+		if (mode == PresentLowLatency)
+		{
+			fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		slot = (slot + 1) % FramePacerSlotCount;
+	}
+
+	double now = Now();
+	if (lastFrameEnd >= 0.0 && now - lastFrameEnd < MaxCountedFrameTime)
+	{
+		double frameTime = now - lastFrameEnd;
+		frameCount++;
+		double delta = frameTime - meanFrameTime;
+		meanFrameTime += delta / frameCount;
+		frameTimeM2 += delta * (frameTime - meanFrameTime);
+		minFrameTime = frameCount == 1 ? frameTime : std::min(minFrameTime, frameTime);
+		maxFrameTime = std::max(maxFrameTime, frameTime);
+	}
+	lastFrameEnd = now;
+}
+
+void FramePacer::PrintStats() const
+{
+	double standardDeviation = std::sqrt(GetFrameTimeVariance());
+	std::cout << "Presentation (" << GetModeName(mode) << "): " << frameCount << " frames, frame time "
+		<< GetMeanFrameTime() << " ms (min " << minFrameTime * 1000.0 << ", max " << maxFrameTime * 1000.0
+		<< ", std dev " << standardDeviation << "), input to GPU done " << GetMeanLatency()
+		<< " ms (max " << maxLatency * 1000.0 << ")" << std::endl;
+}
+
+const char* FramePacer::GetModeName(PresentMode mode)
+{
+	switch (mode)
+	{
+	case PresentVsync:
+		return "vsync";
+	case PresentUncapped:
+		return "uncapped";
+	case PresentCapped:
+		return "capped";
+	case PresentLowLatency:
+		return "low latency";
+	default:
+		return "unknown";
+	}
+}
+
+double FramePacer::Now() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void FramePacer::CalibrateGpuClock()
+{
+	// GL_TIMESTAMP returns the GPU time once all previous commands have reached the GPU, without waiting for them
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	double cpuTime = Now();
+	gpuClockOffset = cpuTime - gpuTime / 1000000000.0;
+	lastCalibration = cpuTime;
+}
+
+void FramePacer::CollectFrames(int maxPending)
+{
+	// Oldest slot first
+	for (int i = 0; i < FramePacerSlotCount; i++)
+	{
+		int index = (slot + i) % FramePacerSlotCount;
+		if (!queryPending[index])
+		{
+			continue;
+		}
+
+		int pending = 0;
+		for (int j = 0; j < FramePacerSlotCount; j++)
+		{
+			pending += queryPending[j] ? 1 : 0;
+		}
+
+		if (fences[index] != 0)
+		{
+			if (pending > maxPending)
+			{
+				while (true)
+				{
+					GLenum status = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, FenceWaitTimeout);
+					if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED)
+					{
+						break;
+					}
+				}
+			}
+			else if (glClientWaitSync(fences[index], 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				continue;
+			}
+			glDeleteSync(fences[index]);
+			fences[index] = 0;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			continue;
+		}
+
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &gpuTime);
+		queryPending[index] = false;
+
+		double latency = gpuTime / 1000000000.0 + gpuClockOffset - inputTimes[index];
+		if (latency >= 0.0 && latency < MaxCountedFrameTime * FramePacerSlotCount)
+		{
+			latencyCount++;
+			latencySum += latency;
+			maxLatency = std::max(maxLatency, latency);
+		}
+	}
+}
+
+void FramePacer::SleepUntil(double time)
+{
+	// Sleep in 1 ms steps while more time is left than a sleep is expected to take. The estimate is the mean plus
+	// one standard deviation of the measured sleeps, since the timer resolution of the OS can be much coarser.
+	double remaining = time - Now();
+	while (remaining > sleepEstimate)
+	{
+		double start = Now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double slept = Now() - start;
+		remaining -= slept;
+
+		sleepCount++;
+		double delta = slept - sleepMean;
+		sleepMean += delta / sleepCount;
+		sleepM2 += delta * (slept - sleepMean);
+		sleepEstimate = sleepMean + (sleepCount > 1 ? std::sqrt(sleepM2 / (sleepCount - 1)) : 0.0);
+	}
+
+	// Spin for the rest
+	while (Now() < time)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void FramePacer::ResetStats()
+{
+	frameCount = 0;
+	meanFrameTime = 0.0;
+	frameTimeM2 = 0.0;
+	minFrameTime = 0.0;
+	maxFrameTime = 0.0;
+	latencyCount = 0;
+	latencySum = 0.0;
+	maxLatency = 0.0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+
+/// <summary>
+/// How frames are paced and presented.
+/// </summary>
+enum PresentMode
+{
+	PresentVsync = 0,	// Swap interval 1; the driver may queue several frames ahead of the display
+	PresentUncapped,	// Swap interval 0, no waiting at all (may tear)
+	PresentCapped,		// Swap interval 0, frames are started at a fixed rate with a sleep followed by a spin
+	PresentLowLatency,	// Swap interval 1, at most MaxQueuedFrames frames in flight (waited on with fences)
+	PresentModeCount
+};
+
+// Number of frames whose fences and timestamp queries can be in flight
+const int FramePacerSlotCount = 4;
+
+/// <summary>
+/// Presentation layer of the render loop: sets the swap interval, waits before a frame is started so that the
+/// chosen pacing is met, and measures the frame times and the latency from input sampling to the frame being
+/// finished on the GPU.
+///
+/// The latency is measured with a GL_TIMESTAMP query issued right after the buffer swap. GPU timestamps are
+/// converted to CPU time with an offset that is recalibrated regularly, so the result is the time from the moment
+/// input was read to the moment the GPU finished the frame; scan-out adds up to one refresh on top of that.
+///
+/// Usage per frame: WaitForFrameStart(), poll events, MarkInputSampled(), process input and render, swap buffers,
+/// then EndFrame().
+/// </summary>
+class FramePacer
+{
+public:
+	/// <summary>
+	/// Creates the timestamp queries and applies the initial mode.
+	/// </summary>
+	/// <param name="mode">Initial presentation mode</param>
+	/// <param name="frameRateCap">Frame rate of PresentCapped, in frames per second</param>
+	/// <param name="maxQueuedFrames">Frames that may be in flight in PresentLowLatency (1 to FramePacerSlotCount - 1)</param>
+	void Create(PresentMode mode, double frameRateCap, int maxQueuedFrames = 1);
+
+	/// <summary>
+	/// Deletes the queries and fences.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Changes the presentation mode. The statistics of the previous mode are printed and reset.
+	/// </summary>
+	void SetMode(PresentMode mode);
+
+	/// <summary>
+	/// Blocks until the next frame should start: until the capped frame time has passed, or until the GPU has
+	/// caught up far enough in low-latency mode. Also collects the finished latency measurements.
+	/// </summary>
+	void WaitForFrameStart();
+
+	/// <summary>
+	/// Records the moment the input of the frame is read. Call right after polling events.
+	/// </summary>
+	void MarkInputSampled();
+
+	/// <summary>
+	/// Issues the timestamp query and fence of the frame and updates the frame time statistics.
+	/// Call right after swapping the buffers.
+	/// </summary>
+	void EndFrame();
+
+	/// <summary>
+	/// Prints the frame time and latency statistics of the current mode.
+	/// </summary>
+	void PrintStats() const;
+
+	/// <returns>Human-readable name of a presentation mode</returns>
+	static const char* GetModeName(PresentMode mode);
+
+	PresentMode GetMode() const { return mode; }
+	long long GetFrameCount() const { return frameCount; }
+
+	/// <returns>Average frame time of the current mode in milliseconds</returns>
+	double GetMeanFrameTime() const { return meanFrameTime * 1000.0; }
+
+	/// <returns>Variance of the frame time of the current mode in squared milliseconds</returns>
+	double GetFrameTimeVariance() const { return frameCount > 1 ? frameTimeM2 / (frameCount - 1) * 1000000.0 : 0.0; }
+
+	/// <returns>Average latency from input sampling to GPU completion in milliseconds</returns>
+	double GetMeanLatency() const { return latencyCount > 0 ? latencySum / latencyCount * 1000.0 : 0.0; }
+
+private:
+	/// <returns>Seconds since the pacer was created</returns>
+	double Now() const;
+
+	/// <summary>
+	/// Measures the offset between the GPU timestamp clock and the CPU clock.
+	/// </summary>
+	void CalibrateGpuClock();
+
+	/// <summary>
+	/// Reads the timestamp queries that have finished. Optionally waits for fences until at most maxPending are left.
+	/// </summary>
+	void CollectFrames(int maxPending);
+
+	/// <summary>
+	/// Sleeps until the given time, then spins for the last part that sleeping cannot hit precisely.
+	/// </summary>
+	void SleepUntil(double time);
+
+	/// <summary>
+	/// Forgets all statistics.
+	/// </summary>
+	void ResetStats();
+
+	PresentMode mode = PresentVsync;
+	double framePeriod = 1.0 / 60.0;
+	int maxQueuedFrames = 1;
+
+	std::chrono::steady_clock::time_point startTime;
+
+	// GPU time (in seconds) + offset = CPU time
+	double gpuClockOffset = 0.0;
+	double lastCalibration = 0.0;
+
+	// One slot per frame in flight
+	GLuint queries[FramePacerSlotCount] = {};
+	GLsync fences[FramePacerSlotCount] = {};
+	bool queryPending[FramePacerSlotCount] = {};
+	double inputTimes[FramePacerSlotCount] = {};
+	int slot = 0;
+
+	double inputTime = 0.0;
+	double nextFrameStart = 0.0;
+	double lastFrameEnd = -1.0;
+
+	// Running estimate of how long sleep_for(1 ms) actually takes (mean and sum of squared differences)
+	double sleepEstimate = 0.002;
+	double sleepMean = 0.001;
+	double sleepM2 = 0.0;
+	long long sleepCount = 0;
+
+	// Frame time statistics (Welford's running mean and variance, in seconds)
+	long long frameCount = 0;
+	double meanFrameTime = 0.0;
+	double frameTimeM2 = 0.0;
+	double minFrameTime = 0.0;
+	double maxFrameTime = 0.0;
+
+	// Latency statistics (in seconds)
+	long long latencyCount = 0;
+	double latencySum = 0.0;
+	double maxLatency = 0.0;
+};
@@ -0,0 +1,39 @@
+#include "GBuffer.h"
+
+#include "RenderStats.h"
+
+void GBuffer::Declare(RenderGraph& graph, int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	// Read with nearest filtering, since G-buffer texels must never be blended
+	albedo = graph.CreateTarget("G-buffer albedo", { width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_NEAREST, GL_CLAMP_TO_EDGE });
+	normal = graph.CreateTarget("G-buffer normal", { width, height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, GL_NEAREST, GL_CLAMP_TO_EDGE });
+	depth = graph.CreateTarget("G-buffer depth", { width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_NEAREST, GL_CLAMP_TO_EDGE });
+}
+
+void GBuffer::Write(RenderGraph& graph, int pass) const
+{
+	graph.Write(pass, albedo);
+	graph.Write(pass, normal);
+	graph.Write(pass, depth);
+}
+
+void GBuffer::Read(RenderGraph& graph, int pass) const
+{
+	graph.Read(pass, albedo);
+	graph.Read(pass, normal);
+	graph.Read(pass, depth);
+}
+
+void GBuffer::BindTextures(const RenderGraph& graph, GLuint firstUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + firstUnit);
+	glBindTexture(GL_TEXTURE_2D, graph.GetTexture(albedo));
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+	glBindTexture(GL_TEXTURE_2D, graph.GetTexture(normal));
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+	glBindTexture(GL_TEXTURE_2D, graph.GetTexture(depth));
+	RenderStats::CountStateChange(3);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "RenderGraph.h"
+
+/// <summary>
+/// Render targets of the deferred shading path, declared in the render graph every frame.
+///
+/// The G-buffer is kept small (8 bytes of color data per pixel plus depth):
+///  - albedo (RGBA8): texture color in rgb, material index in a
+///  - normal (RG16): world-space normal, octahedral encoded and mapped to [0, 1] (GL 3.3 requires unsigned
+///    normalized formats to be renderable, but not signed ones)
+///  - depth (DEPTH_COMPONENT24): the world-space position is reconstructed from it in the lighting pass
+/// </summary>
+class GBuffer
+{
+public:
+	/// <summary>
+	/// Declares the albedo, normal and depth targets in the frame's graph.
+	/// </summary>
+	void Declare(RenderGraph& graph, int width, int height);
+
+	/// <summary>
+	/// Declares that the geometry pass renders into the G-buffer.
+	/// </summary>
+	void Write(RenderGraph& graph, int pass) const;
+
+	/// <summary>
+	/// Declares that a pass reads the G-buffer.
+	/// </summary>
+	void Read(RenderGraph& graph, int pass) const;
+
+	/// <summary>
+	/// Binds the albedo, normal and depth textures to three consecutive texture units.
+	/// </summary>
+	/// <param name="firstUnit">Texture unit of the albedo texture</param>
+	void BindTextures(const RenderGraph& graph, GLuint firstUnit) const;
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+private:
+	RenderResource albedo = -1;
+	RenderResource normal = -1;
+	RenderResource depth = -1;
+	int width = 0;
+	int height = 0;
+};
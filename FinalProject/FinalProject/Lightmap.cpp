@@ -0,0 +1,620 @@
+#include "Lightmap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "Bvh.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+
+// Triangles join a chart if their normal is within about 8 degrees of the chart's first triangle
+static const float LightmapChartCosine = 0.99f;
+
+// Rays start this far off the surface (in world units), so that they don't hit the surface they start on
+static const float LightmapRayOffset = 0.01f;
+
+/// <summary>
+/// Mixes a value into an FNV-1a hash.
+/// </summary>
+static void HashValue(unsigned int& hash, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xffu;
+		hash *= 16777619u;
+	}
+}
+
+/// <summary>
+/// Small random number generator for the sample directions. Every texel seeds its own, so the result doesn't
+/// depend on which thread bakes the texel.
+/// </summary>
+struct BakeRandom
+{
+	unsigned int state;
+
+	/// <returns>A number in [0, 1)</returns>
+	float Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+};
+
+void Lightmap::Create(MeshRegistry& meshes, const std::vector<SceneObject*>& objects, const std::vector<const SceneObject*>& scene, int size)
+{
+	PROFILE_ZONE("Lay out lightmap");
+
+	this->size = size;
+	hasLighting = false;
+	pixels.assign(static_cast<size_t>(size) * size * 4, 0);
+
+	// Charts of every object, from its world-space triangles
+	std::vector<std::vector<glm::vec3>> objectPositions(objects.size());
+	std::vector<std::vector<Chart>> objectCharts(objects.size());
+	std::vector<Chart*> charts;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& object = *objects[i];
+		const MeshInfo& mesh = meshes.Get(object.mesh.levels[0]);
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			objectPositions[i].push_back(glm::vec3(object.model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f)));
+		}
+		objectCharts[i] = BuildCharts(objectPositions[i], mesh.indices);
+		for (Chart& chart : objectCharts[i])
+		{
+			charts.push_back(&chart);
+		}
+	}
+
+	// Use the highest density at which everything fits
+	texelsPerUnit = LightmapMaxTexelsPerUnit;
+	while (!PackCharts(charts, texelsPerUnit))
+	{
+		texelsPerUnit *= 0.9f;
+		if (texelsPerUnit < 0.01f)
+		{
+			std::cerr << "Lightmap: " << charts.size() << " charts don't fit into a " << size << "x" << size
+				<< " atlas, the charts overlap" << std::endl;
+			break;
+		}
+	}
+
+	layoutHash = 2166136261u;
+	HashValue(layoutHash, static_cast<unsigned int>(size));
+	HashValue(layoutHash, static_cast<unsigned int>(objects.size()));
+	for (const Chart* chart : charts)
+	{
+		HashValue(layoutHash, static_cast<unsigned int>(chart->x));
+		HashValue(layoutHash, static_cast<unsigned int>(chart->y));
+		HashValue(layoutHash, static_cast<unsigned int>(chart->width));
+		HashValue(layoutHash, static_cast<unsigned int>(chart->height));
+	}
+
+	// Copy every mesh, with its vertices split along the chart borders and mapped into their chart
+	std::vector<MeshHandle> replacedMeshes;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		SceneObject& object = *objects[i];
+		std::vector<Vertex> sourceVertices = meshes.Get(object.mesh.levels[0]).vertices;
+		std::vector<GLuint> sourceIndices = meshes.Get(object.mesh.levels[0]).indices;
+
+		std::vector<int> triangleCharts(sourceIndices.size() / 3);
+		for (size_t c = 0; c < objectCharts[i].size(); c++)
+		{
+			for (int triangle : objectCharts[i][c].triangles)
+			{
+				triangleCharts[triangle / 3] = static_cast<int>(c);
+			}
+		}
+
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		std::map<std::pair<GLuint, int>, GLuint> chartVertices;
+		for (size_t j = 0; j + 2 < sourceIndices.size(); j += 3)
+		{
+			int c = triangleCharts[j / 3];
+			const Chart& chart = objectCharts[i][c];
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint source = sourceIndices[j + k];
+				std::map<std::pair<GLuint, int>, GLuint>::iterator found = chartVertices.find(std::make_pair(source, c));
+				if (found != chartVertices.end())
+				{
+					indices.push_back(found->second);
+					continue;
+				}
+
+				const glm::vec3& position = objectPositions[i][source];
+				Vertex vertex = sourceVertices[source];
+				vertex.lu = (chart.x + LightmapChartPadding + (glm::dot(position, chart.tangent) - chart.min.x) * texelsPerUnit) / size;
+				vertex.lv = (chart.y + LightmapChartPadding + (glm::dot(position, chart.bitangent) - chart.min.y) * texelsPerUnit) / size;
+
+				GLuint index = static_cast<GLuint>(vertices.size());
+				chartVertices[std::make_pair(source, c)] = index;
+				vertices.push_back(vertex);
+				indices.push_back(index);
+			}
+		}
+
+		replacedMeshes.insert(replacedMeshes.end(), object.mesh.levels, object.mesh.levels + object.mesh.levelCount);
+		object.mesh = BuildMeshLods(meshes, meshes.Add(vertices, indices));
+		object.lightmapped = true;
+	}
+
+	// Remove the replaced meshes that no object draws anymore; objects that aren't lightmapped (e.g., the
+	// dynamic crates) may still share them
+	std::sort(replacedMeshes.begin(), replacedMeshes.end());
+	replacedMeshes.erase(std::unique(replacedMeshes.begin(), replacedMeshes.end()), replacedMeshes.end());
+	for (MeshHandle replaced : replacedMeshes)
+	{
+		bool used = std::any_of(scene.begin(), scene.end(), [&](const SceneObject* object)
+		{
+			return std::find(object->mesh.levels, object->mesh.levels + object->mesh.levelCount, replaced) != object->mesh.levels + object->mesh.levelCount;
+		});
+		if (!used)
+		{
+			meshes.Remove(replaced);
+		}
+	}
+
+	std::cout << "Lightmap: " << objects.size() << " objects in " << charts.size() << " charts, "
+		<< texelsPerUnit << " texels per unit" << std::endl;
+}
+
+void Lightmap::Destroy()
+{
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+}
+
+std::vector<Lightmap::Chart> Lightmap::BuildCharts(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// Vertices at the same position are one corner, even if their other attributes differ
+	std::map<std::tuple<float, float, float>, int> positionIds;
+	std::vector<int> corners(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		const glm::vec3& position = positions[indices[i]];
+		std::tuple<float, float, float> key(position.x, position.y, position.z);
+		std::map<std::tuple<float, float, float>, int>::iterator found = positionIds.find(key);
+		if (found == positionIds.end())
+		{
+			found = positionIds.insert(std::make_pair(key, static_cast<int>(positionIds.size()))).first;
+		}
+		corners[i] = found->second;
+	}
+
+	// Triangles around every edge, and the normal of every triangle (zero for degenerate ones)
+	std::map<std::pair<int, int>, std::vector<int>> edgeTriangles;
+	std::vector<glm::vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			int a = corners[t * 3 + k];
+			int b = corners[t * 3 + (k + 1) % 3];
+			edgeTriangles[std::make_pair(std::min(a, b), std::max(a, b))].push_back(static_cast<int>(t));
+		}
+
+		glm::vec3 normal = glm::cross(positions[indices[t * 3 + 1]] - positions[indices[t * 3]],
+			positions[indices[t * 3 + 2]] - positions[indices[t * 3]]);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	std::vector<Chart> charts;
+	std::vector<bool> assigned(triangleCount, false);
+	for (size_t seed = 0; seed < triangleCount; seed++)
+	{
+		if (assigned[seed])
+		{
+			continue;
+		}
+
+		Chart chart;
+		glm::vec3 normal = normals[seed];
+		std::vector<int> open(1, static_cast<int>(seed));
+		assigned[seed] = true;
+		while (!open.empty())
+		{
+			int t = open.back();
+			open.pop_back();
+			chart.triangles.push_back(t * 3);
+
+			for (int k = 0; k < 3; k++)
+			{
+				int a = corners[t * 3 + k];
+				int b = corners[t * 3 + (k + 1) % 3];
+				for (int neighbour : edgeTriangles[std::make_pair(std::min(a, b), std::max(a, b))])
+				{
+					if (!assigned[neighbour] && glm::dot(normals[neighbour], normal) > LightmapChartCosine)
+					{
+						assigned[neighbour] = true;
+						open.push_back(neighbour);
+					}
+				}
+			}
+		}
+		std::sort(chart.triangles.begin(), chart.triangles.end());
+
+		// Project onto the plane of the first triangle
+		if (glm::dot(normal, normal) == 0.0f)
+		{
+			normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		}
+		glm::vec3 helper = std::fabs(normal.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		chart.tangent = glm::normalize(glm::cross(helper, normal));
+		chart.bitangent = glm::cross(normal, chart.tangent);
+
+		chart.min = glm::vec2(1e30f);
+		chart.max = glm::vec2(-1e30f);
+		for (int triangle : chart.triangles)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec3& position = positions[indices[triangle + k]];
+				glm::vec2 projected(glm::dot(position, chart.tangent), glm::dot(position, chart.bitangent));
+				chart.min = glm::min(chart.min, projected);
+				chart.max = glm::max(chart.max, projected);
+			}
+		}
+		chart.width = 0;
+		chart.height = 0;
+		chart.x = 0;
+		chart.y = 0;
+		charts.push_back(chart);
+	}
+	return charts;
+}
+
+bool Lightmap::PackCharts(std::vector<Chart*>& charts, float texelsPerUnit) const
+{
+	for (Chart* chart : charts)
+	{
+		chart->width = static_cast<int>(std::ceil((chart->max.x - chart->min.x) * texelsPerUnit)) + 1 + 2 * LightmapChartPadding;
+		chart->height = static_cast<int>(std::ceil((chart->max.y - chart->min.y) * texelsPerUnit)) + 1 + 2 * LightmapChartPadding;
+	}
+
+	// Tallest charts first, so that the rows waste little space
+	std::vector<Chart*> sorted = charts;
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Chart* a, const Chart* b) { return a->height > b->height; });
+
+	int x = 0;
+	int y = 0;
+	int rowHeight = 0;
+	for (Chart* chart : sorted)
+	{
+		if (x + chart->width > size)
+		{
+			x = 0;
+			y += rowHeight;
+			rowHeight = 0;
+		}
+		if (chart->width > size || y + chart->height > size)
+		{
+			return false;
+		}
+
+		chart->x = x;
+		chart->y = y;
+		x += chart->width;
+		rowHeight = std::max(rowHeight, chart->height);
+	}
+	return true;
+}
+
+void Lightmap::Bake(const MeshRegistry& meshes, const std::vector<SceneObject*>& objects, const LightmapBakeSettings& settings, int threadCount)
+{
+	PROFILE_ZONE("Bake lightmap");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// World-space triangles of the occluders, with a BVH over them
+	std::vector<glm::vec3> occluders;
+	std::vector<Aabb> occluderBounds;
+	for (const SceneObject* object : objects)
+	{
+		if (!object->castsShadow)
+		{
+			continue;
+		}
+
+		const MeshInfo& mesh = meshes.Get(object->mesh.levels[0]);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			Aabb bounds = Aabb::Empty();
+			for (int k = 0; k < 3; k++)
+			{
+				const Vertex& vertex = mesh.vertices[mesh.indices[i + k]];
+				glm::vec3 position = glm::vec3(object->model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+				occluders.push_back(position);
+				bounds.Extend(position);
+			}
+			occluderBounds.push_back(bounds);
+		}
+	}
+
+	Bvh bvh;
+	bvh.Build(occluderBounds);
+
+	// Returns true if the ray hits an occluder closer than maxDistance
+	auto occluded = [&](const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		auto intersectTriangle = [&](int triangle, float& closestDistance)
+		{
+			float distance;
+			if (IntersectRayTriangle(origin, direction, occluders[triangle * 3], occluders[triangle * 3 + 1],
+				occluders[triangle * 3 + 2], distance) && distance < closestDistance)
+			{
+				closestDistance = distance;
+				return true;
+			}
+			return false;
+		};
+
+		int hitTriangle;
+		float hitDistance;
+		return bvh.Raycast(origin, direction, maxDistance, intersectTriangle, hitTriangle, hitDistance);
+	};
+
+	// Rasterize every triangle in lightmap space, to find the surface point and normal at the texel centers
+	size_t texelCount = static_cast<size_t>(size) * size;
+	std::vector<glm::vec3> texelPositions(texelCount);
+	std::vector<glm::vec3> texelNormals(texelCount);
+	std::vector<bool> covered(texelCount, false);
+	for (const SceneObject* object : objects)
+	{
+		const MeshInfo& mesh = meshes.Get(object->mesh.levels[0]);
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(object->model)));
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec2 texel[3];
+			glm::vec3 position[3];
+			glm::vec3 normal[3];
+			for (int k = 0; k < 3; k++)
+			{
+				const Vertex& vertex = mesh.vertices[mesh.indices[i + k]];
+				texel[k] = glm::vec2(vertex.lu, vertex.lv) * static_cast<float>(size);
+				position[k] = glm::vec3(object->model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+				normal[k] = normalMatrix * glm::vec3(vertex.nx, vertex.ny, vertex.nz);
+			}
+
+			float area = (texel[1].x - texel[0].x) * (texel[2].y - texel[0].y) - (texel[2].x - texel[0].x) * (texel[1].y - texel[0].y);
+			if (std::fabs(area) < 1e-12f)
+			{
+				continue;
+			}
+
+			// Meshes without normals (all zeros) are baked with the face normal
+			glm::vec3 faceNormal = glm::cross(position[1] - position[0], position[2] - position[0]);
+			faceNormal = glm::dot(faceNormal, faceNormal) > 0.0f ? glm::normalize(faceNormal) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+			int minX = std::max(static_cast<int>(std::floor(std::min(std::min(texel[0].x, texel[1].x), texel[2].x))), 0);
+			int minY = std::max(static_cast<int>(std::floor(std::min(std::min(texel[0].y, texel[1].y), texel[2].y))), 0);
+			int maxX = std::min(static_cast<int>(std::ceil(std::max(std::max(texel[0].x, texel[1].x), texel[2].x))), size - 1);
+			int maxY = std::min(static_cast<int>(std::ceil(std::max(std::max(texel[0].y, texel[1].y), texel[2].y))), size - 1);
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					glm::vec2 center(x + 0.5f, y + 0.5f);
+					float weights[3];
+					bool inside = true;
+					for (int k = 0; k < 3; k++)
+					{
+						const glm::vec2& a = texel[(k + 1) % 3];
+						const glm::vec2& b = texel[(k + 2) % 3];
+						weights[k] = ((b.x - a.x) * (center.y - a.y) - (center.x - a.x) * (b.y - a.y)) / area;
+						inside = inside && weights[k] >= -1e-5f;
+					}
+					if (!inside)
+					{
+						continue;
+					}
+
+					size_t index = static_cast<size_t>(y) * size + x;
+					texelPositions[index] = position[0] * weights[0] + position[1] * weights[1] + position[2] * weights[2];
+					glm::vec3 texelNormal = normal[0] * weights[0] + normal[1] * weights[1] + normal[2] * weights[2];
+					texelNormals[index] = glm::dot(texelNormal, texelNormal) > 1e-12f ? glm::normalize(texelNormal) : faceNormal;
+					covered[index] = true;
+				}
+			}
+		}
+	}
+
+	// Trace the texels, one row per iteration
+	glm::vec3 ambient = 0.5f * settings.ambientIntensity;
+	glm::vec3 lightDirection = -settings.lightDirection;
+	glm::vec3 shadowRayDirection = glm::normalize(lightDirection);
+	std::vector<glm::vec4> light(texelCount, glm::vec4(0.0f));
+
+	ThreadPool pool;
+	pool.Create(threadCount);
+	pool.ParallelFor(size, [&](int y)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			size_t index = static_cast<size_t>(y) * size + x;
+			if (!covered[index])
+			{
+				continue;
+			}
+
+			const glm::vec3& normal = texelNormals[index];
+			glm::vec3 origin = texelPositions[index] + normal * LightmapRayOffset;
+
+			// Directional light, like main.fsh: the light vector is not normalized
+			float visibility = occluded(origin, shadowRayDirection, 1000.0f) ? 0.0f : 1.0f;
+			float diffuse = std::max(glm::dot(normal, lightDirection), 0.0f);
+
+			// Ambient occlusion: the share of cosine-weighted hemisphere rays that escape
+			glm::vec3 helper = std::fabs(normal.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+			BakeRandom random = { static_cast<unsigned int>(index) * 2654435761u + 1u };
+			int unoccluded = 0;
+			for (int sample = 0; sample < settings.occlusionSamples; sample++)
+			{
+				float angle = 6.28318531f * random.Next();
+				float radius2 = random.Next();
+				float radius = std::sqrt(radius2);
+				glm::vec3 direction = tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle))
+					+ normal * std::sqrt(1.0f - radius2);
+				unoccluded += occluded(origin, direction, settings.occlusionDistance) ? 0 : 1;
+			}
+			float occlusion = settings.occlusionSamples > 0 ? static_cast<float>(unoccluded) / settings.occlusionSamples : 1.0f;
+
+			light[index] = glm::vec4(ambient * occlusion + diffuse * visibility * settings.diffuseIntensity, visibility);
+		}
+	});
+	int threadsUsed = pool.GetThreadCount();
+	pool.Destroy();
+
+	// Grow the charts into their padding, so that bilinear filtering at a chart border reads the border's light
+	std::vector<bool> filled = covered;
+	for (int iteration = 0; iteration < LightmapChartPadding + 1; iteration++)
+	{
+		std::vector<bool> next = filled;
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				size_t index = static_cast<size_t>(y) * size + x;
+				if (filled[index])
+				{
+					continue;
+				}
+
+				glm::vec4 sum(0.0f);
+				int count = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int nx = x + dx;
+						int ny = y + dy;
+						if (nx >= 0 && ny >= 0 && nx < size && ny < size && filled[static_cast<size_t>(ny) * size + nx])
+						{
+							sum += light[static_cast<size_t>(ny) * size + nx];
+							count++;
+						}
+					}
+				}
+				if (count > 0)
+				{
+					light[index] = sum / static_cast<float>(count);
+					next[index] = true;
+				}
+			}
+		}
+		filled = next;
+	}
+
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			float value = channel < 3 ? light[i][channel] / LightmapScale : light[i][channel];
+			pixels[i * 4 + channel] = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+	hasLighting = true;
+
+	size_t coveredCount = static_cast<size_t>(std::count(covered.begin(), covered.end(), true));
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Lightmap: baked " << coveredCount << " texels against " << occluderBounds.size() << " triangles in "
+		<< seconds << " s with " << threadsUsed << " threads" << std::endl;
+}
+
+bool Lightmap::Save(const std::string& path) const
+{
+	// Files start with the top row
+	stbi_flip_vertically_on_write(1);
+	if (stbi_write_png(path.c_str(), size, size, 4, pixels.data(), size * 4) == 0)
+	{
+		std::cerr << "Failed to write the lightmap " << path << std::endl;
+		return false;
+	}
+
+	std::ofstream layout(path + ".txt");
+	layout << size << " " << layoutHash << std::endl;
+	if (!layout)
+	{
+		std::cerr << "Failed to write the lightmap layout " << path << ".txt" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Lightmap::Load(const std::string& path)
+{
+	std::ifstream layout(path + ".txt");
+	int bakedSize = 0;
+	unsigned int bakedHash = 0;
+	if (!(layout >> bakedSize >> bakedHash))
+	{
+		return false;
+	}
+	if (bakedSize != size || bakedHash != layoutHash)
+	{
+		std::cerr << "The lightmap " << path << " was baked for another scene, run with --bake-lightmaps to update it" << std::endl;
+		return false;
+	}
+
+	stbi_set_flip_vertically_on_load(true);
+	int width, height, channels;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	if (data == nullptr || width != size || height != size)
+	{
+		std::cerr << "Failed to load the lightmap " << path << std::endl;
+		stbi_image_free(data);
+		return false;
+	}
+
+	pixels.assign(data, data + static_cast<size_t>(size) * size * 4);
+	stbi_image_free(data);
+	hasLighting = true;
+	return true;
+}
+
+void Lightmap::Upload()
+{
+	if (texture == 0)
+	{
+		glGenTextures(1, &texture);
+	}
+
+	// Plain bilinear filtering: the charts are padded for it, but mip levels would mix neighbouring charts
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Lightmap::Bind(int unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	RenderStats::CountStateChange();
+}
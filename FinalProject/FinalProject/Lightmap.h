@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshRegistry.h"
+#include "Scene.h"
+
+// Most lightmap texels per world unit; the density is lowered until all charts fit into the atlas
+const float LightmapMaxTexelsPerUnit = 32.0f;
+
+// Empty texels around every chart, so that bilinear filtering never reads from a neighbouring chart
+const int LightmapChartPadding = 2;
+
+// The baked light is divided by this before it is stored in 8 bits, since ambient plus diffuse light can exceed 1;
+// main.fsh multiplies it back
+const float LightmapScale = 2.0f;
+
+/// <summary>
+/// Light that is baked into the lightmap: the same values that SetLightingUniforms() gives main.fsh.
+/// </summary>
+struct LightmapBakeSettings
+{
+	glm::vec3 lightDirection;		// directional_light
+	glm::vec3 ambientIntensity;
+	glm::vec3 diffuseIntensity;
+	int occlusionSamples;			// Hemisphere rays per texel for ambient occlusion
+	float occlusionDistance;		// Geometry farther away than this doesn't occlude the ambient light
+};
+
+/// <summary>
+/// Precomputed lighting of the static geometry, stored in one atlas texture.
+///
+/// Create() gives every static object a second UV set (Vertex::lu, lv) that maps it into its own part of the atlas:
+/// the object's triangles are grouped into charts of connected, nearly coplanar triangles, every chart is projected
+/// onto its plane, and the charts are packed into rows. The layout only depends on the scene, so the baker and the
+/// renderer always compute the same one.
+///
+/// Bake() ray-casts the lighting of every texel on the CPU: the directional light with a shadow ray, and the
+/// ambient light weighted by ambient occlusion. The rays are traced through a BVH over the triangles of the static
+/// objects, and the texels are spread over a thread pool. Each texel stores the ambient and diffuse light in RGB
+/// and the visibility of the directional light (which still scales the view-dependent specular light) in alpha.
+/// </summary>
+class Lightmap
+{
+public:
+	/// <summary>
+	/// Lays out the atlas. Each object gets a copy of its mesh with lightmap UVs (and new detail levels) and is
+	/// flagged as lightmapped; the meshes the objects used before are removed from the registry unless another
+	/// object of the scene still uses them.
+	/// </summary>
+	/// <param name="meshes">Registry that holds the objects' meshes and receives the copies</param>
+	/// <param name="objects">Static objects that get baked lighting</param>
+	/// <param name="scene">Every object that refers to meshes of the registry, including the lightmapped ones</param>
+	/// <param name="size">Width and height of the atlas in texels</param>
+	void Create(MeshRegistry& meshes, const std::vector<SceneObject*>& objects, const std::vector<const SceneObject*>& scene, int size);
+
+	/// <summary>
+	/// Deletes the texture.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Bakes the lighting of the objects passed to Create() into the atlas. Every object with castsShadow occludes.
+	/// </summary>
+	/// <param name="threadCount">Number of threads (0 to use every hardware thread)</param>
+	void Bake(const MeshRegistry& meshes, const std::vector<SceneObject*>& objects, const LightmapBakeSettings& settings, int threadCount = 0);
+
+	/// <summary>
+	/// Writes the atlas as a PNG file, and the layout it was baked for next to it (same path with .txt appended).
+	/// </summary>
+	/// <returns>True if both files were written</returns>
+	bool Save(const std::string& path) const;
+
+	/// <summary>
+	/// Reads an atlas written by Save(). Atlases baked for a different layout (the scene changed since) are rejected.
+	/// </summary>
+	/// <returns>True if the atlas was read and matches the layout</returns>
+	bool Load(const std::string& path);
+
+	/// <summary>
+	/// Uploads the atlas into a texture.
+	/// </summary>
+	void Upload();
+
+	/// <summary>
+	/// Binds the atlas to a texture unit.
+	/// </summary>
+	void Bind(int unit) const;
+
+	/// <returns>True if the atlas holds baked or loaded lighting</returns>
+	bool HasLighting() const { return hasLighting; }
+
+	/// <returns>RGBA texels of the atlas, bottom row first</returns>
+	const std::vector<unsigned char>& GetPixels() const { return pixels; }
+
+	int GetSize() const { return size; }
+
+	/// <returns>GPU memory of the texture in bytes</returns>
+	size_t GetMemoryUsage() const { return texture != 0 ? static_cast<size_t>(size) * size * 4 : 0; }
+
+private:
+	/// <summary>
+	/// Triangles of an object that share a plane, and where they are placed in the atlas.
+	/// </summary>
+	struct Chart
+	{
+		std::vector<int> triangles;		// First index of every triangle in the object's index list
+		glm::vec3 tangent;				// Axes of the chart's plane in world space
+		glm::vec3 bitangent;
+		glm::vec2 min;					// Bounds of the triangles along the axes, in world units
+		glm::vec2 max;
+		int width;						// Size in texels, including the padding
+		int height;
+		int x;							// Position in the atlas
+		int y;
+	};
+
+	/// <summary>
+	/// Groups the triangles of a mesh into charts: a chart grows over shared edges to every triangle that faces
+	/// nearly the same way as its first triangle.
+	/// </summary>
+	/// <param name="positions">World-space vertex positions</param>
+	/// <param name="indices">Three indices per triangle</param>
+	static std::vector<Chart> BuildCharts(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices);
+
+	/// <summary>
+	/// Places the charts into rows of the atlas at the given density.
+	/// </summary>
+	/// <returns>False if they don't fit</returns>
+	bool PackCharts(std::vector<Chart*>& charts, float texelsPerUnit) const;
+
+	int size = 0;
+	float texelsPerUnit = 0.0f;
+	unsigned int layoutHash = 0;	// Identifies the layout, to detect atlases baked for another scene
+	bool hasLighting = false;
+	std::vector<unsigned char> pixels;
+	GLuint texture = 0;
+};
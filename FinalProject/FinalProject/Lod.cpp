@@ -0,0 +1,115 @@
+#include "Lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MeshSimplifier.h"
+#include "Profiler.h"
+
+// On-screen diameter (in pixels) below which level i replaces level i - 1
+static const float LodSwitchSizes[MaxLodLevels] = { 0.0f, 240.0f, 100.0f, 40.0f };
+
+// How far (as a fraction of the switch size) an object has to be past a threshold before it switches levels
+static const float LodHysteresis = 0.15f;
+
+// Largest simplification error of each level, as a fraction of the mesh's bounding radius
+static const float LodErrorFractions[MaxLodLevels] = { 0.0f, 0.01f, 0.03f, 0.08f };
+
+// A level is only kept if it removes at least this fraction of the previous level's triangles
+static const float MinTriangleReduction = 0.25f;
+
+MeshLods BuildMeshLods(MeshRegistry& registry, MeshHandle mesh)
+{
+	PROFILE_ZONE("Build mesh LODs");
+
+	MeshLods lods;
+	lods.levels[0] = mesh;
+	lods.levelCount = 1;
+
+	const MeshInfo& info = registry.Get(mesh);
+	lods.center = (info.boundsMin + info.boundsMax) * 0.5f;
+	lods.radius = glm::length(info.boundsMax - info.boundsMin) * 0.5f;
+
+	std::vector<Vertex> vertices = info.vertices;
+	std::vector<GLuint> indices = info.indices;
+
+	for (int level = 1; level < MaxLodLevels; level++)
+	{
+		size_t triangleCount = indices.size() / 3;
+		size_t target = triangleCount / 2;
+
+		// The quadrics are area weighted, so the error budget scales with the square of the mesh's area as well
+		float distance = LodErrorFractions[level] * lods.radius;
+		float maxError = distance * distance * lods.radius * lods.radius;
+
+		std::vector<Vertex> simplifiedVertices;
+		std::vector<GLuint> simplifiedIndices;
+		size_t simplifiedCount = SimplifyMesh(vertices, indices, target, maxError, simplifiedVertices, simplifiedIndices);
+		if (simplifiedCount == 0 || simplifiedCount > triangleCount * (1.0f - MinTriangleReduction))
+		{
+			break;
+		}
+
+		lods.levels[level] = registry.Add(simplifiedVertices, simplifiedIndices);
+		lods.levelCount++;
+
+		vertices.swap(simplifiedVertices);
+		indices.swap(simplifiedIndices);
+	}
+
+	for (int level = lods.levelCount; level < MaxLodLevels; level++)
+	{
+		lods.levels[level] = lods.levels[lods.levelCount - 1];
+	}
+
+	return lods;
+}
+
+float ProjectedSizePerspective(const glm::vec3& center, float radius, const glm::vec3& eyePosition, float fovY, float viewportHeight)
+{
+	float distance = glm::length(center - eyePosition);
+
+	// The camera is inside the bounding sphere
+	if (distance <= radius)
+	{
+		return viewportHeight * 2.0f;
+	}
+
+	return (2.0f * radius) / (2.0f * distance * std::tan(fovY * 0.5f)) * viewportHeight;
+}
+
+float ProjectedSizeOrthographic(float radius, float orthoHeight, float viewportHeight)
+{
+	return (2.0f * radius) / orthoHeight * viewportHeight;
+}
+
+int SelectLod(const MeshLods& lods, float projectedSize, int& currentLevel, int bias)
+{
+	int level = std::min(std::max(currentLevel, 0), lods.levelCount - 1);
+
+	// Move to a coarser level only once the object is clearly smaller than the switch size...
+	while (level + 1 < lods.levelCount && projectedSize < LodSwitchSizes[level + 1] * (1.0f - LodHysteresis))
+	{
+		level++;
+	}
+
+	// ...and back to a finer level only once it is clearly larger
+	while (level > 0 && projectedSize > LodSwitchSizes[level] * (1.0f + LodHysteresis))
+	{
+		level--;
+	}
+
+	currentLevel = level;
+	return std::min(level + bias, lods.levelCount - 1);
+}
+
+void GetWorldBoundingSphere(const MeshLods& lods, const glm::mat4& model, glm::vec3& center, float& radius)
+{
+	center = glm::vec3(model * glm::vec4(lods.center, 1.0f));
+
+	float scaleX = glm::length(glm::vec3(model[0]));
+	float scaleY = glm::length(glm::vec3(model[1]));
+	float scaleZ = glm::length(glm::vec3(model[2]));
+	radius = lods.radius * std::max(scaleX, std::max(scaleY, scaleZ));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "MeshRegistry.h"
+
+// Maximum number of detail levels per mesh (level 0 is the original mesh)
+const int MaxLodLevels = 4;
+
+/// <summary>
+/// Render passes that pick their level of detail independently.
+/// </summary>
+enum LodPass
+{
+	LodPassMain = 0,
+	LodPassShadow,
+	LodPassCount
+};
+
+/// <summary>
+/// A mesh and its simplified versions, from the most detailed to the least detailed.
+/// </summary>
+struct MeshLods
+{
+	MeshHandle levels[MaxLodLevels];
+	int levelCount;
+	glm::vec3 center;	// Object-space bounding sphere of the original mesh
+	float radius;
+};
+
+/// <summary>
+/// Builds the detail levels of a mesh by repeatedly halving its triangle count with quadric error simplification.
+/// The simplified meshes are added to the same registry. Fewer levels are built if the mesh cannot be
+/// simplified any further without visible error (e.g., a box is already as simple as it can be).
+/// </summary>
+/// <param name="registry">Registry that contains the mesh and receives its simplified versions</param>
+/// <param name="mesh">The full-detail mesh</param>
+/// <returns>The mesh and its simplified versions</returns>
+MeshLods BuildMeshLods(MeshRegistry& registry, MeshHandle mesh);
+
+/// <summary>
+/// Computes the on-screen diameter (in pixels) of a bounding sphere seen through a perspective projection.
+/// </summary>
+/// <param name="center">World-space center of the sphere</param>
+/// <param name="radius">World-space radius of the sphere</param>
+/// <param name="eyePosition">World-space camera position</param>
+/// <param name="fovY">Vertical field of view (in radians)</param>
+/// <param name="viewportHeight">Height of the viewport in pixels</param>
+float ProjectedSizePerspective(const glm::vec3& center, float radius, const glm::vec3& eyePosition, float fovY, float viewportHeight);
+
+/// <summary>
+/// Computes the on-screen diameter (in pixels) of a bounding sphere seen through an orthographic projection.
+/// </summary>
+/// <param name="radius">World-space radius of the sphere</param>
+/// <param name="orthoHeight">Height of the orthographic view volume in world units</param>
+/// <param name="viewportHeight">Height of the viewport in pixels</param>
+float ProjectedSizeOrthographic(float radius, float orthoHeight, float viewportHeight);
+
+/// <summary>
+/// Picks a detail level from the projected size of an object. To avoid popping when an object sits right
+/// at a switch distance, the object only moves to another level once it is clearly past the threshold.
+/// </summary>
+/// <param name="lods">Detail levels of the object's mesh</param>
+/// <param name="projectedSize">On-screen diameter of the object in pixels</param>
+/// <param name="currentLevel">Level that the object used in the previous frame (updated with the new level)</param>
+/// <param name="bias">Number of extra levels to drop, e.g., for the shadow pass</param>
+/// <returns>The level to draw this frame</returns>
+int SelectLod(const MeshLods& lods, float projectedSize, int& currentLevel, int bias);
+
+/// <summary>
+/// Transforms the object-space bounding sphere of a mesh into world space.
+/// </summary>
+void GetWorldBoundingSphere(const MeshLods& lods, const glm::mat4& model, glm::vec3& center, float& radius);
@@ -4,17 +4,45 @@
 #include <GLFW/glfw3.h>
 
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <stb_image_write.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <vector>
+
+#include "BatchTransform.h"
+#include "Bvh.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "GBuffer.h"
+#include "Lightmap.h"
+#include "MaterialLibrary.h"
+#include "MeshRegistry.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include "Regression.h"
+#include "RenderGraph.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "SoftwareRenderer.h"
+#include "StaticBatcher.h"
+#include "StreamingBuffer.h"
+#include "TextureResidency.h"
+#include "TransformBenchmark.h"
+#include "Vertex.h"
+
 // ---------------
 // Function declarations
 // ---------------
@@ -51,21 +79,66 @@ GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shade
 /// <param name="height">New height</param>
 void FramebufferSizeChangedCallback(GLFWwindow* window, int width, int height);
 
-void processInput(GLFWwindow* window);
-void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 /// <summary>
-/// Struct containing data about a vertex
+/// Sets the light and shadow uniforms that the forward shader and the deferred lighting shader share.
 /// </summary>
-struct Vertex
-{
-	GLfloat x, y, z;	// Position
-	GLubyte r, g, b;	// Color
-	GLfloat u, v;		// UV coordinates
-	GLfloat nx, ny, nz; // Normal Vectors
-	
-};
+/// <param name="program">Program to set the uniforms of (must be in use)</param>
+/// <param name="projectionMatrixLight">Projection matrix of the shadow-casting light</param>
+/// <param name="viewMatrixLight">View matrix of the shadow-casting light</param>
+void SetLightingUniforms(GLuint program, const glm::mat4& projectionMatrixLight, const glm::mat4& viewMatrixLight);
+
+/// <summary>
+/// Returns the same light values that SetLightingUniforms() gives the shaders, for the software renderer.
+/// </summary>
+/// <param name="lightViewProjection">Projection * view matrix of the shadow-casting light</param>
+/// <param name="lightmap">Baked lighting, used if lightmaps are enabled</param>
+SoftwareLighting GetSoftwareLighting(const glm::mat4& lightViewProjection, const Lightmap& lightmap);
+
+/// <summary>
+/// Compares a frame rendered with OpenGL to the same frame rendered by the software renderer, and writes both
+/// images and a difference image (validation_gl.png, validation_software.png, validation_diff.png).
+/// </summary>
+/// <param name="glPixels">RGBA pixels read back from OpenGL, bottom row first</param>
+/// <param name="softwarePixels">RGBA pixels of the software renderer, bottom row first</param>
+/// <returns>True if the images match closely enough</returns>
+bool CompareSoftwareFrame(const std::vector<unsigned char>& glPixels, const std::vector<unsigned char>& softwarePixels, int width, int height);
+
+void processInput(GLFWwindow* window, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects);
+
+/// <summary>
+/// Checks whether the camera would overlap a collidable object at the given position.
+/// </summary>
+/// <param name="position">Candidate camera position</param>
+/// <param name="sceneBvh">Hierarchy over the bounding boxes of the scene objects</param>
+/// <param name="sceneObjects">Objects of the scene, indexed like the hierarchy's items</param>
+/// <returns>True if the camera would be inside a collidable object</returns>
+bool CameraCollides(const glm::vec3& position, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects);
 
+/// <summary>
+/// Finds the object under the center of the screen by casting a ray from the camera through the scene BVH.
+/// </summary>
+/// <param name="meshes">Registry holding the triangles that are tested exactly</param>
+/// <param name="sceneBvh">Hierarchy over the bounding boxes of the scene objects</param>
+/// <param name="sceneObjects">Objects of the scene, indexed like the hierarchy's items</param>
+/// <returns>Index of the closest object that was hit, or -1</returns>
+int PickObject(const MeshRegistry& meshes, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects);
+
+/// <summary>
+/// Collects the objects to draw in a pass: the visible scene objects that are not part of a static batch,
+/// followed by the visible static batches.
+/// </summary>
+/// <param name="sceneObjects">Objects of the scene</param>
+/// <param name="visibleObjects">Indices of the visible scene objects (sorted by this function)</param>
+/// <param name="staticBatches">Batches built by BuildStaticBatches()</param>
+/// <param name="visibleBatches">Indices of the visible batches (sorted by this function)</param>
+/// <param name="drawList">Receives the objects to draw</param>
+void GatherDrawList(std::vector<SceneObject>& sceneObjects, std::vector<int>& visibleObjects,
+	std::vector<SceneObject>& staticBatches, std::vector<int>& visibleBatches, std::vector<SceneObject*>& drawList);
+
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -81,14 +154,147 @@ float lastY = 600.0f / 2.0;
 float yaw = -90.0f;
 float pitch = 0.0f;
 float fov = 45.0f;
+
+// size of the window's framebuffer in pixels (kept up to date by FramebufferSizeChangedCallback)
+int windowWidth = 1920;
+int windowHeight = 1080;
+
+// radius of the box around the camera that is kept out of collidable objects
+const float cameraRadius = 0.25f;
+
+// set when the left mouse button is clicked; the object in the middle of the screen is picked in the next frame
+bool pickRequested = false;
+
+// render settings (toggled with the function keys)
+bool occlusionCullingEnabled = true;
+bool deferredShadingEnabled = false;
+bool dynamicResolutionEnabled = true;
+PresentMode presentMode = PresentVsync;
+
+// frame capture settings (from the command line); F6 starts and stops a capture
+CaptureOutput captureOutput = CapturePngSequence;
+std::string captureTarget = "capture_";
+bool captureToggleRequested = false;
+
+// rendering backend (from the command line): OpenGL, or the software renderer on the CPU
+bool softwareRenderingEnabled = false;
+bool softwareValidationEnabled = false;
+
+// light of the scene, used by the shaders and by the software renderer
+const glm::vec3 lightAmbientIntensity(0.4f, 0.4f, 0.4f);
+const glm::vec3 lightDiffuseIntensity(0.8f, 0.8f, 0.8f);
+const glm::vec3 lightSpecularIntensity(0.2f, 0.2f, 0.2f);
+const glm::vec3 directionalLight(0.0f, -1.0f, 1.0f);
+
+// width and height of the shadow map in texels
+const int shadowMapSize = 2048;
+
+// GPU memory that render targets, buffers and textures may use together, in megabytes (from the command line);
+// F7 prints the memory report
+size_t gpuMemoryBudgetMegabytes = 512;
+bool memoryReportRequested = false;
+
+// baked lighting of the static objects; F8 switches between the lightmap and the real-time light and shadows
+bool lightmapsEnabled = true;
+bool lightmapBakeRequested = false;
+const std::string lightmapPath = "lightmap.png";
+
+// width and height of the lightmap atlas in texels
+const int lightmapSize = 1024;
+
+// uniform buffer binding point of the DrawMatrices block (the Materials block uses 0)
+const GLuint drawMatricesBinding = 1;
+
+// bytes of one draw's DrawMatrices block: mat and model
+const GLsizeiptr drawMatricesSize = 2 * sizeof(glm::mat4);
+
+// regression mode (from the command line): renders the regression cases, checks or records the golden files and exits
+bool regressionEnabled = false;
+bool goldenUpdateRequested = false;
+const std::string goldenDirectory = "golden";
 /// <summary>
 /// Main function.
 /// </summary>
 /// <returns>An integer indicating whether the program ended successfully or not.
 /// A value of 0 indicates the program ended succesfully, while a non-zero value indicates
 /// something wrong happened during execution.</returns>
-int main()
+int main(int argc, char** argv)
 {
+	// --bench-transforms times the batch transform kernels and exits without opening a window
+	// --trace records a trace from startup, so that loading is included; F5 starts and stops captures at any time
+	// --software renders on the CPU instead of with OpenGL; --validate-software renders the first frame with both,
+	// compares them and exits
+	// --capture-png <prefix> captures every frame into <prefix>000000.png, ...; --capture-pipe <command> writes the
+	// frames as raw RGBA, top row first, to the command's standard input, e.g.,
+	// --capture-pipe "ffmpeg -f rawvideo -pix_fmt rgba -s 1920x1080 -r 60 -i - capture.mp4" with the framebuffer's
+	// size (printed when the capture starts); F6 stops and restarts the capture
+	// --memory-budget <megabytes> sets the GPU memory budget that textures are streamed within
+	// --bake-lightmaps bakes the lighting of the static objects into lightmap.png and exits
+	// --regression renders the regression cases in a hidden window, checks them against the golden images and
+	// budgets and exits with 1 if any failed; --update-golden records the golden files instead
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--bench-transforms")
+		{
+			return RunTransformBenchmarks(100000);
+		}
+		else if (std::string(argv[i]) == "--trace")
+		{
+			Profiler::SetEnabled(true);
+		}
+		else if ((std::string(argv[i]) == "--capture-png" || std::string(argv[i]) == "--capture-pipe") && i + 1 < argc)
+		{
+			// Capture from the first frame, into PNG files with the given prefix or into the given command
+			captureOutput = std::string(argv[i]) == "--capture-pipe" ? CapturePipe : CapturePngSequence;
+			captureTarget = argv[++i];
+			captureToggleRequested = true;
+		}
+		else if (std::string(argv[i]) == "--software")
+		{
+			softwareRenderingEnabled = true;
+		}
+		else if (std::string(argv[i]) == "--memory-budget" && i + 1 < argc)
+		{
+			gpuMemoryBudgetMegabytes = static_cast<size_t>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (std::string(argv[i]) == "--bake-lightmaps")
+		{
+			lightmapBakeRequested = true;
+		}
+		else if (std::string(argv[i]) == "--validate-software")
+		{
+			// Both renderers have to draw the same image: forward shading, at the window's resolution
+			softwareValidationEnabled = true;
+			deferredShadingEnabled = false;
+			dynamicResolutionEnabled = false;
+		}
+		else if (std::string(argv[i]) == "--regression" || std::string(argv[i]) == "--update-golden")
+		{
+			// Same settings in every run: a small fixed resolution, no adaptive resolution or frame pacing, and
+			// real-time lighting (a lightmap baked for the regression scene would have to be checked in too)
+			regressionEnabled = true;
+			goldenUpdateRequested = goldenUpdateRequested || std::string(argv[i]) == "--update-golden";
+			dynamicResolutionEnabled = false;
+			presentMode = PresentUncapped;
+			lightmapsEnabled = false;
+			windowWidth = 640;
+			windowHeight = 360;
+		}
+	}
+	Profiler::SetThreadName("Main thread");
+
+	// The regression frames end in the suite's framebuffer, which only the OpenGL path renders into
+	if (regressionEnabled)
+	{
+		softwareRenderingEnabled = false;
+	}
+
+	// The golden images are rendered by Mesa's software rasterizer, which gives the same pixels on every machine
+	if (regressionEnabled)
+	{
+		UseSoftwareRasterizer();
+	}
+
 	// Initialize GLFW
 	int glfwInitStatus = glfwInit();
 	if (glfwInitStatus == GLFW_FALSE)
@@ -105,9 +311,13 @@ int main()
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	// The regression mode renders into a hidden window
+	if (regressionEnabled)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
 	// Tell GLFW to create a window
-	float windowWidth = 1920;
-	float windowHeight = 1080;
 	GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Final Project", nullptr, nullptr);
 	if (window == nullptr)
 	{
@@ -119,11 +329,16 @@ int main()
 	// Tell GLFW to use the OpenGL context that was assigned to the window that we just created
 	glfwMakeContextCurrent(window);
 
+	// The framebuffer can be larger than the window (e.g., on high-DPI displays)
+	glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+
 	// Register the callback function that handles when the framebuffer size has changed
 	glfwSetFramebufferSizeCallback(window, FramebufferSizeChangedCallback);
 
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetKeyCallback(window, key_callback);
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	// Tell GLAD to load the OpenGL function pointers
@@ -135,352 +350,547 @@ int main()
 
 	// --- Vertex specification ---
 
-	Vertex vertices[240];
+	// Room: walls, ceiling and floor
+	Vertex roomVertices[30];
+
 	// Right Wall
-	vertices[0] = { 1.0f, -1.0f, -1.0f,		255, 255, 255,		0.0f, 0.5f,		-1.0f, 0.0f, 0.0f };
-	vertices[1] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.0f, 1.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[2] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[3] = { 1.0f, -1.0f, -1.0f,		255, 255, 255,		0.0f, 0.5f,		-1.0f, 0.0f, 0.0f };
-	vertices[4] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[5] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[0] = { 1.0f, -1.0f, -1.0f,		255, 255, 255,		0.0f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[1] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.0f, 1.0f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[2] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[3] = { 1.0f, -1.0f, -1.0f,		255, 255, 255,		0.0f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[4] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		-1.0f, 0.0f, 0.0f };
+	roomVertices[5] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 0.5f,		-1.0f, 0.0f, 0.0f };
 
 	// Ceiling
-	vertices[6] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 0.5f,		0.0f, -1.0f, 0.0f };
-	vertices[7] = { -1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 1.0f,		0.0f, -1.0f, 0.0f };
-	vertices[8] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, -1.0f, 0.0f };
-	vertices[9] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 0.5f,		0.0f, -1.0f, 0.0f };
-	vertices[10] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, -1.0f, 0.0f };
-	vertices[11] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 0.5f,		0.0f, -1.0f, 0.0f };
+	roomVertices[6] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 0.5f,		0.0f, -1.0f, 0.0f };
+	roomVertices[7] = { -1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 1.0f,		0.0f, -1.0f, 0.0f };
+	roomVertices[8] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, -1.0f, 0.0f };
+	roomVertices[9] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		1.0f, 0.5f,		0.0f, -1.0f, 0.0f };
+	roomVertices[10] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, -1.0f, 0.0f };
+	roomVertices[11] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 0.5f,		0.0f, -1.0f, 0.0f };
 
 	// Left Wall
-	vertices[12] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		1.0f, 0.0f, 0.0f };
-	vertices[13] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.0f, 1.0f,		1.0f, 0.0f, 0.0f };
-	vertices[14] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		1.0f, 0.0f, 0.0f };
-	vertices[15] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		1.0f, 0.0f, 0.0f };
-	vertices[16] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		1.0f, 0.0f, 0.0f };
-	vertices[17] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		1.0f, 0.0f, 0.0f };
+	roomVertices[12] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		1.0f, 0.0f, 0.0f };
+	roomVertices[13] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.0f, 1.0f,		1.0f, 0.0f, 0.0f };
+	roomVertices[14] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		1.0f, 0.0f, 0.0f };
+	roomVertices[15] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		1.0f, 0.0f, 0.0f };
+	roomVertices[16] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		1.0f, 0.0f, 0.0f };
+	roomVertices[17] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		1.0f, 0.0f, 0.0f };
 
 	// Floor
-	vertices[18] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 1.0f, 0.0f };
-	vertices[19] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 1.0f,		0.0f, 1.0f, 0.0f };
-	vertices[20] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 1.0f, 0.0f };
-	vertices[21] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 1.0f, 0.0f };
-	vertices[22] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 1.0f, 0.0f };
-	vertices[23] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 1.0f, 0.0f };
+	roomVertices[18] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 1.0f, 0.0f };
+	roomVertices[19] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 1.0f,		0.0f, 1.0f, 0.0f };
+	roomVertices[20] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 1.0f, 0.0f };
+	roomVertices[21] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 1.0f, 0.0f };
+	roomVertices[22] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 1.0f, 0.0f };
+	roomVertices[23] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 1.0f, 0.0f };
 
 	// Front Wall
-	vertices[24] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[25] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.0f, 1.0f,		0.0f, 0.0f, -1.0f };
-	vertices[26] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, -1.0f };
-	vertices[27] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[28] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, -1.0f };
-	vertices[29] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 0.0f, -1.0f };
+	roomVertices[24] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
+	roomVertices[25] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.0f, 1.0f,		0.0f, 0.0f, -1.0f };
+	roomVertices[26] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, -1.0f };
+	roomVertices[27] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
+	roomVertices[28] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, -1.0f };
+	roomVertices[29] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 0.0f, -1.0f };
+
+	// Back wall of the room (not drawn)
+	Vertex backWallVertices[6];
 
 	// Back Wall
-	vertices[30] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[31] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.0f, 1.0f,		0.0f, 0.0f, 1.0f };
-	vertices[32] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, 1.0f };
-	vertices[33] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[34] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, 1.0f };
-	vertices[35] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[0] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[1] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.0f, 1.0f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[2] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[3] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[4] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.5f, 1.0f,		0.0f, 0.0f, 1.0f };
+	backWallVertices[5] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.5f, 0.5f,		0.0f, 0.0f, 1.0f };
+
+	// Door, outside of the front wall (not drawn)
+	Vertex doorVertices[6];
 
 	//Door
-	vertices[36] = { 0.25f, -1.0f, 1.01f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
-	vertices[37] = { 0.25f, 0.0f, 1.01f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[38] = { -0.25f, 0.0f, 1.01f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[39] = { 0.25f, -1.0f, 1.01f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
-	vertices[40] = { -0.25f, 0.0f, 1.01f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[41] = { -0.25f, -1.0f, 1.01f,	255, 255, 255,		0.0f, 0.0f,		0.0f, 0.0f, 1.0f };
+	doorVertices[0] = { 0.25f, -1.0f, 1.01f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
+	doorVertices[1] = { 0.25f, 0.0f, 1.01f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	doorVertices[2] = { -0.25f, 0.0f, 1.01f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
+	doorVertices[3] = { 0.25f, -1.0f, 1.01f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
+	doorVertices[4] = { -0.25f, 0.0f, 1.01f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, 1.0f };
+	doorVertices[5] = { -0.25f, -1.0f, 1.01f,	255, 255, 255,		0.0f, 0.0f,		0.0f, 0.0f, 1.0f };
+
+	// Crate, used by every crate of the scene
+	Vertex crateVertices[36];
 
 	// Right Wall Big Crate
-	vertices[42] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[43] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
-	vertices[44] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[45] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[46] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[47] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crateVertices[0] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crateVertices[1] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
+	crateVertices[2] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crateVertices[3] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crateVertices[4] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crateVertices[5] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
 
 	// Ceiling Big Crate
-	vertices[48] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[49] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
-	vertices[50] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[51] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[52] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[53] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crateVertices[6] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crateVertices[7] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
+	crateVertices[8] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crateVertices[9] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crateVertices[10] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crateVertices[11] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
 
 	// Left Wall Big Crate
-	vertices[54] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[55] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
-	vertices[56] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[57] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[58] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[59] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crateVertices[12] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crateVertices[13] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	crateVertices[14] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crateVertices[15] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crateVertices[16] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crateVertices[17] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
 
 	// Floor Big Crate
-	vertices[60] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[61] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
-	vertices[62] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[63] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[64] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[65] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crateVertices[18] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crateVertices[19] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
+	crateVertices[20] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crateVertices[21] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crateVertices[22] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crateVertices[23] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
 
 	// Front Wall Big Crate
-	vertices[66] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[67] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[68] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[69] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[70] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[71] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crateVertices[24] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crateVertices[25] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
+	crateVertices[26] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crateVertices[27] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crateVertices[28] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crateVertices[29] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
 
 	// Back Wall Big Crate
-	vertices[72] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[73] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[74] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[75] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[76] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[77] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crateVertices[30] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crateVertices[31] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
+	crateVertices[32] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crateVertices[33] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crateVertices[34] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crateVertices[35] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+
+	// Second and third crate (not drawn: every crate uses the first crate's mesh)
+	Vertex crate2Vertices[36];
 
 	// Right Wall Big Crate 2
-	vertices[78] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[79] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
-	vertices[80] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[81] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[82] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[83] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate2Vertices[0] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate2Vertices[1] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
+	crate2Vertices[2] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crate2Vertices[3] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate2Vertices[4] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crate2Vertices[5] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
 
 	// Ceiling Big Crate 2
-	vertices[84] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[85] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
-	vertices[86] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[87] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[88] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[89] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate2Vertices[6] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate2Vertices[7] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
+	crate2Vertices[8] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crate2Vertices[9] = { 1.0f, 1.0f, -1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate2Vertices[10] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crate2Vertices[11] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
 
 	// Left Wall Big Crate 2
-	vertices[90] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[91] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
-	vertices[92] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[93] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[94] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[95] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate2Vertices[12] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate2Vertices[13] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	crate2Vertices[14] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crate2Vertices[15] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate2Vertices[16] = { -1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crate2Vertices[17] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
 
 	// Floor Big Crate 2
-	vertices[96] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[97] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
-	vertices[98] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[99] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[100] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[101] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate2Vertices[18] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate2Vertices[19] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
+	crate2Vertices[20] = { 1.0f, -1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crate2Vertices[21] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate2Vertices[22] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crate2Vertices[23] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
 
 	// Front Wall Big Crate 2
-	vertices[102] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[103] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[104] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[105] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[106] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[107] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate2Vertices[24] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate2Vertices[25] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
+	crate2Vertices[26] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crate2Vertices[27] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate2Vertices[28] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crate2Vertices[29] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
 
 	// Back Wall Big Crate 2
-	vertices[108] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[109] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[110] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[111] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[112] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[113] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate2Vertices[30] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate2Vertices[31] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
+	crate2Vertices[32] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crate2Vertices[33] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate2Vertices[34] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crate2Vertices[35] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+
+	Vertex crate3Vertices[36];
 
 	// Right Wall Big Crate 3
-	vertices[114] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[115] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
-	vertices[116] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[117] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[118] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
-	vertices[119] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate3Vertices[0] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate3Vertices[1] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		1.0f, 0.0f, 0.0f };
+	crate3Vertices[2] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crate3Vertices[3] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	crate3Vertices[4] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.5f,	1.0f, 0.0f, 0.0f };
+	crate3Vertices[5] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	1.0f, 0.0f, 0.0f };
 
 	// Ceiling Big Crate 3
-	vertices[120] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[121] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
-	vertices[122] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[123] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[124] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
-	vertices[125] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate3Vertices[6] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate3Vertices[7] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 1.0f, 0.0f };
+	crate3Vertices[8] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crate3Vertices[9] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	crate3Vertices[10] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 1.0f, 0.0f };
+	crate3Vertices[11] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f,	0.0f, 1.0f, 0.0f };
 
 	// Left Wall Big Crate 3
-	vertices[126] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[127] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
-	vertices[128] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[129] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[130] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
-	vertices[131] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate3Vertices[12] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate3Vertices[13] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		-1.0f, 0.0f, 0.0f };
+	crate3Vertices[14] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crate3Vertices[15] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	crate3Vertices[16] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	-1.0f, 0.0f, 0.0f };
+	crate3Vertices[17] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	-1.0f, 0.0f, 0.0f };
 
 	// Floor Big Crate 3
-	vertices[132] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[133] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
-	vertices[134] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[135] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[136] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
-	vertices[137] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate3Vertices[18] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate3Vertices[19] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, -1.0f, 0.0f };
+	crate3Vertices[20] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crate3Vertices[21] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	crate3Vertices[22] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, -1.0f, 0.0f };
+	crate3Vertices[23] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, -1.0f, 0.0f };
 
 	// Front Wall Big Crate 3
-	vertices[138] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[139] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[140] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[141] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[142] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[143] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate3Vertices[24] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate3Vertices[25] = { 1.0f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, -1.0f };
+	crate3Vertices[26] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crate3Vertices[27] = { 1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	crate3Vertices[28] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	crate3Vertices[29] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
 
 	// Back Wall Big Crate 3
-	vertices[144] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[145] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[146] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[147] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[148] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
-	vertices[149] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate3Vertices[30] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate3Vertices[31] = { 1.0f, 1.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
+	crate3Vertices[32] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crate3Vertices[33] = { 1.0f, -1.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	crate3Vertices[34] = { -1.0f, 1.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, 1.0f };
+	crate3Vertices[35] = { -1.0f, -1.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+
+	// Door, inside of the front wall (not drawn)
+	Vertex door2Vertices[6];
 
 	//Door2
-	vertices[150] = { 0.25f, -1.0f, 0.99f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
-	vertices[151] = { 0.25f, 0.0f, 0.99f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
-	vertices[152] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[153] = { 0.25f, -1.0f, 0.99f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
-	vertices[154] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
-	vertices[155] = { -0.25f, -1.0f, 0.99f,	255, 255, 255,		0.0f, 0.0f,		0.0f, 0.0f, -1.0f };
+	door2Vertices[0] = { 0.25f, -1.0f, 0.99f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
+	door2Vertices[1] = { 0.25f, 0.0f, 0.99f,	255, 255, 255,		0.25f, 0.5f,	0.0f, 0.0f, -1.0f };
+	door2Vertices[2] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
+	door2Vertices[3] = { 0.25f, -1.0f, 0.99f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
+	door2Vertices[4] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.0f, 0.5f,		0.0f, 0.0f, -1.0f };
+	door2Vertices[5] = { -0.25f, -1.0f, 0.99f,	255, 255, 255,		0.0f, 0.0f,		0.0f, 0.0f, -1.0f };
+
+	// Window
+	Vertex windowVertices[6];
 
 	// Window
-	vertices[156] = { 0.50f, -1.0f, 0.99f,	255, 255, 255,		1.0f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[157] = { 0.50f, 0.0f, 0.99f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[158] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[159] = { 0.50f, -1.0f, 0.99f,	255, 255, 255,		1.0f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[160] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
-	vertices[161] = { -0.25f, -1.0f, 0.99f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+	windowVertices[0] = { 0.50f, -1.0f, 0.99f,	255, 255, 255,		1.0f, 0.0f,		0.0f, 0.0f, 1.0f };
+	windowVertices[1] = { 0.50f, 0.0f, 0.99f,	255, 255, 255,		1.0f, 0.5f,		0.0f, 0.0f, 1.0f };
+	windowVertices[2] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
+	windowVertices[3] = { 0.50f, -1.0f, 0.99f,	255, 255, 255,		1.0f, 0.0f,		0.0f, 0.0f, 1.0f };
+	windowVertices[4] = { -0.25f, 0.0f, 0.99f,	255, 255, 255,		0.6f, 0.5f,		0.0f, 0.0f, 1.0f };
+	windowVertices[5] = { -0.25f, -1.0f, 0.99f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+
+	// Roof (not drawn; it has no normals)
+	Vertex roofVertices[18];
 
 	// Roof Base
-	vertices[162] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
-	vertices[163] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f };
-	vertices[164] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f };
-	vertices[165] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
-	vertices[166] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f };
-	vertices[167] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
+	roofVertices[0] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
+	roofVertices[1] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.5f };
+	roofVertices[2] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f };
+	roofVertices[3] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
+	roofVertices[4] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.5f };
+	roofVertices[5] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
 
 	// Roof Sides
-	vertices[168] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
-	vertices[169] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
-	vertices[170] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
+	roofVertices[6] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f };
+	roofVertices[7] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
+	roofVertices[8] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
 	
-	vertices[171] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
-	vertices[172] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
-	vertices[173] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f };
+	roofVertices[9] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
+	roofVertices[10] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
+	roofVertices[11] = { 1.0f, 0.0f, 1.0f,		255, 255, 255,		0.25f, 0.15f };
+
+	roofVertices[12] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
+	roofVertices[13] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
+	roofVertices[14] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f };
 
-	vertices[174] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
-	vertices[175] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
-	vertices[176] = { 1.0f, 0.0f, -1.0f,	255, 255, 255,		0.25f, 0.15f };
+	roofVertices[15] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
+	roofVertices[16] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
+	roofVertices[17] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
 
-	vertices[177] = { -1.0f, 0.0f, -1.0f,	255, 255, 255,		0.6f, 0.15f };
-	vertices[178] = { 0.0f, 1.0f, 0.0f,		255, 255, 255,		0.425f, 0.325f };
-	vertices[179] = { -1.0f, 0.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f };
+	// Chair panel, used for the seat and the back
+	Vertex chairPanelVertices[36];
 
 	// Chair back
-	vertices[180] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[181] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[182] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[183] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[184] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[185] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
-
-	vertices[186] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
-	vertices[187] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[188] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[189] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
-	vertices[190] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[191] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		1.0f, 0.0f, 0.0f };
-
-	vertices[192] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
-	vertices[193] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[194] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[195] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
-	vertices[196] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[197] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
-
-	vertices[198] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[199] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[200] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[201] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[202] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[203] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.0f,		-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[0] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+	chairPanelVertices[1] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairPanelVertices[2] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairPanelVertices[3] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+	chairPanelVertices[4] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairPanelVertices[5] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, 1.0f };
+
+	chairPanelVertices[6] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
+	chairPanelVertices[7] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairPanelVertices[8] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairPanelVertices[9] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
+	chairPanelVertices[10] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairPanelVertices[11] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		1.0f, 0.0f, 0.0f };
+
+	chairPanelVertices[12] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
+	chairPanelVertices[13] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairPanelVertices[14] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairPanelVertices[15] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
+	chairPanelVertices[16] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.25f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairPanelVertices[17] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.25f, 0.0f,	0.0f, 0.0f, -1.0f };
+
+	chairPanelVertices[18] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[19] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[20] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[21] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[22] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairPanelVertices[23] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.0f,		-1.0f, 0.0f, 0.0f };
 	
-	vertices[204] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.0f,		0.0f, 1.0f, 0.0f };
-	vertices[205] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[206] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[207] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.0f,		0.0f, 1.0f, 0.0f };
-	vertices[208] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 1.0f, 0.0f };
-	vertices[209] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 1.0f, 0.0f };
-
-	vertices[210] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, -1.0f, 0.0f };
-	vertices[211] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[212] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[213] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, -1.0f, 0.0f };
-	vertices[214] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, -1.0f, 0.0f };
-	vertices[215] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, -1.0f, 0.0f };
+	chairPanelVertices[24] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.0f,		0.0f, 1.0f, 0.0f };
+	chairPanelVertices[25] = { 0.5f, 1.0f, 0.5f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 1.0f, 0.0f };
+	chairPanelVertices[26] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 1.0f, 0.0f };
+	chairPanelVertices[27] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.0f,		0.0f, 1.0f, 0.0f };
+	chairPanelVertices[28] = { -1.0f, 1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 1.0f, 0.0f };
+	chairPanelVertices[29] = { -1.0f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 1.0f, 0.0f };
+
+	chairPanelVertices[30] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, -1.0f, 0.0f };
+	chairPanelVertices[31] = { 0.5f, -1.0f, 0.5f,	255, 255, 255,		0.6f, 0.15f,	0.0f, -1.0f, 0.0f };
+	chairPanelVertices[32] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, -1.0f, 0.0f };
+	chairPanelVertices[33] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, -1.0f, 0.0f };
+	chairPanelVertices[34] = { -1.0f, -1.0f, 0.5f,	255, 255, 255,		0.4f, 0.15f,	0.0f, -1.0f, 0.0f };
+	chairPanelVertices[35] = { -1.0f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, -1.0f, 0.0f };
+
+	// Chair leg
+	Vertex chairLegVertices[24];
 
 	// Chair legs
-	vertices[216] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
-	vertices[217] = { 0.5f, 1.0f, 0.75f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[218] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[219] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
-	vertices[220] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
-	vertices[221] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		1.0f, 0.0f, 0.0f };
-
-	vertices[222] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[223] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[224] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[225] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
-	vertices[226] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, 1.0f };
-	vertices[227] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 0.0f, 1.0f };
-
-	vertices[228] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[229] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[230] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[231] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
-	vertices[232] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
-	vertices[233] = { 0.25f, -1.0f, 0.75f,	255, 255, 255,		0.4f, 0.0f,		-1.0f, 0.0f, 0.0f };
-
-	vertices[234] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
-	vertices[235] = { 0.5f, 1.0f, 0.75f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[236] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[237] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
-	vertices[238] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, -1.0f };
-	vertices[239] = { 0.25f, -1.0f, 0.75f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 0.0f, -1.0f };
-
-	// Create a vertex buffer object (VBO), and upload our vertices data to the VBO
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	
-	// Create a vertex array object that contains data on how to map vertex attributes
-	// (e.g., position, color) to vertex shader properties.
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	chairLegVertices[0] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
+	chairLegVertices[1] = { 0.5f, 1.0f, 0.75f,	255, 255, 255,		0.6f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairLegVertices[2] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairLegVertices[3] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		1.0f, 0.0f, 0.0f };
+	chairLegVertices[4] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.4f, 0.15f,	1.0f, 0.0f, 0.0f };
+	chairLegVertices[5] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		1.0f, 0.0f, 0.0f };
+
+	chairLegVertices[6] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+	chairLegVertices[7] = { 0.5f, 1.0f, 1.0f,		255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairLegVertices[8] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairLegVertices[9] = { 0.5f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, 1.0f };
+	chairLegVertices[10] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, 1.0f };
+	chairLegVertices[11] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 0.0f, 1.0f };
+
+	chairLegVertices[12] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
+	chairLegVertices[13] = { 0.25f, 1.0f, 1.0f,	255, 255, 255,		0.6f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairLegVertices[14] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairLegVertices[15] = { 0.25f, -1.0f, 1.0f,	255, 255, 255,		0.6f, 0.0f,		-1.0f, 0.0f, 0.0f };
+	chairLegVertices[16] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	-1.0f, 0.0f, 0.0f };
+	chairLegVertices[17] = { 0.25f, -1.0f, 0.75f,	255, 255, 255,		0.4f, 0.0f,		-1.0f, 0.0f, 0.0f };
+
+	chairLegVertices[18] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
+	chairLegVertices[19] = { 0.5f, 1.0f, 0.75f,	255, 255, 255,		0.6f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairLegVertices[20] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairLegVertices[21] = { 0.5f, -1.0f, 0.75f,	255, 255, 255,		0.6f, 0.0f,		0.0f, 0.0f, -1.0f };
+	chairLegVertices[22] = { 0.25f, 1.0f, 0.75f,	255, 255, 255,		0.4f, 0.15f,	0.0f, 0.0f, -1.0f };
+	chairLegVertices[23] = { 0.25f, -1.0f, 0.75f,	255, 255, 255,		0.4f, 0.0f,		0.0f, 0.0f, -1.0f };
+
+	// Upload the meshes into the registry, which sub-allocates them from one shared vertex arena
+	// and one shared index arena that are drawn through a single vertex array object.
+	// Each mesh is one of the vertex arrays above.
+	MeshRegistry meshes;
+	meshes.Create(4096, 8192);
+
+	MeshHandle roomMesh = meshes.AddTriangles(roomVertices);
+	MeshHandle crateMesh = meshes.AddTriangles(crateVertices);
+	MeshHandle windowMesh = meshes.AddTriangles(windowVertices);
+	MeshHandle chairPanelMesh = meshes.AddTriangles(chairPanelVertices);
+	MeshHandle chairLegMesh = meshes.AddTriangles(chairLegVertices);
+
+	// Build the simplified versions of every mesh up front
+	MeshLods roomLods = BuildMeshLods(meshes, roomMesh);
+	MeshLods crateLods = BuildMeshLods(meshes, crateMesh);
+	MeshLods windowLods = BuildMeshLods(meshes, windowMesh);
+	MeshLods chairPanelLods = BuildMeshLods(meshes, chairPanelMesh);
+	MeshLods chairLegLods = BuildMeshLods(meshes, chairLegMesh);
+	meshes.PrintStats();
+
+	// --- Scene specification ---
+
+	// Model matrices, as position / rotation / scale of every object; they are composed in one batch below.
+	// The scales are uniform, so scaling before or after the rotation gives the same matrix.
+	glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+	glm::quat noRotation(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::quat chairRotation = glm::angleAxis(glm::radians(-25.0f), yAxis);
+
+	TransformArrays sceneTransforms;
+	size_t roomTransform = sceneTransforms.Add(glm::vec3(0.0f), noRotation, glm::vec3(5.0f));
+	size_t crate1Transform = sceneTransforms.Add(glm::vec3(-4.0f, -4.0f, -4.0f), noRotation, glm::vec3(1.0f));
+	size_t crate2Transform = sceneTransforms.Add(glm::vec3(-4.5f, -2.6f, -3.5f), glm::angleAxis(glm::radians(45.0f), yAxis), glm::vec3(0.3f));
+	size_t crate3Transform = sceneTransforms.Add(glm::vec3(-3.5f, -2.6f, -4.0f), glm::angleAxis(glm::radians(250.0f), yAxis), glm::vec3(0.3f));
+	size_t windowTransform = sceneTransforms.Add(glm::vec3(0.0f, 3.0f, 0.0f), glm::angleAxis(glm::radians(90.0f), yAxis), glm::vec3(5.0f));
+	size_t chairBackTransform = sceneTransforms.Add(glm::vec3(3.75f, -1.0f, -4.8f), chairRotation, glm::vec3(1.2f));
+	size_t chairBaseTransform = sceneTransforms.Add(glm::vec3(3.0f, -1.6f, -3.2f),
+		chairRotation * glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(1.2f));
+	size_t chairLeg1Transform = sceneTransforms.Add(glm::vec3(2.98f, -3.7f, -3.22f), chairRotation, glm::vec3(1.2f));
+	size_t chairLeg2Transform = sceneTransforms.Add(glm::vec3(1.68f, -3.7f, -3.83f), chairRotation, glm::vec3(1.2f));
+	size_t chairLeg3Transform = sceneTransforms.Add(glm::vec3(2.5f, -3.7f, -5.6f), chairRotation, glm::vec3(1.2f));
+	size_t chairLeg4Transform = sceneTransforms.Add(glm::vec3(3.8f, -3.7f, -5.0f), chairRotation, glm::vec3(1.2f));
+
+	std::vector<glm::mat4> modelMatrices(sceneTransforms.Size());
+	ComposeTransforms(sceneTransforms, 0, sceneTransforms.Size(), nullptr, modelMatrices.data(), nullptr);
+	std::cout << "Batch transforms: " << GetSimdLevelName(DetectSimdLevel()) << std::endl;
+
+	// Tracks the GPU memory of every resource and streams the mip levels of the textures within the budget,
+	// uploading at most 16 MB per frame
+	TextureResidency residency;
+	residency.Create(gpuMemoryBudgetMegabytes * 1024 * 1024, 16 * 1024 * 1024);
+
+	// Textures are packed into the layers of one texture array, and every object picks a material from the library.
+	// All surfaces are still cut out of the single atlas texture, so for now every material samples its layer.
+	MaterialLibrary materials;
+	materials.Create(8, residency);
+	int atlasLayer = materials.AddTexture("final project texture.jpg");
+
+	int wallMaterial = materials.AddMaterial(atlasLayer, 1.0f, 1.0f);
+	int woodMaterial = materials.AddMaterial(atlasLayer, 1.0f, 1.0f);
+	int windowMaterial = materials.AddMaterial(atlasLayer, 1.0f, 1.0f);
+	materials.Upload();
+
+	// The room and the big crate are large enough to hide other objects, so they are used as occluders
+	std::vector<SceneObject> sceneObjects;
+	sceneObjects.push_back({ "Room", roomLods, modelMatrices[roomTransform], wallMaterial, true, true, false, true, { 0, 0 } });
+	sceneObjects.push_back({ "Crate 1", crateLods, modelMatrices[crate1Transform], woodMaterial, true, true, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Crate 2", crateLods, modelMatrices[crate2Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Crate 3", crateLods, modelMatrices[crate3Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Window", windowLods, modelMatrices[windowTransform], windowMaterial, true, false, false, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair back", chairPanelLods, modelMatrices[chairBackTransform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair base", chairPanelLods, modelMatrices[chairBaseTransform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair leg 1", chairLegLods, modelMatrices[chairLeg1Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair leg 2", chairLegLods, modelMatrices[chairLeg2Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair leg 3", chairLegLods, modelMatrices[chairLeg3Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+	sceneObjects.push_back({ "Chair leg 4", chairLegLods, modelMatrices[chairLeg4Transform], woodMaterial, true, false, true, true, { 0, 0 } });
+
+	// The regression cases also render generated scenes with many objects, away from the room
+	if (regressionEnabled)
+	{
+		std::vector<SceneObject> chair;
+		for (const SceneObject& object : sceneObjects)
+		{
+			if (object.name.compare(0, 5, "Chair") == 0)
+			{
+				chair.push_back(object);
+			}
+		}
+		SceneObject crate = *std::find_if(sceneObjects.begin(), sceneObjects.end(),
+			[](const SceneObject& object) { return object.name == "Crate 2"; });
+		AddStressScenes(sceneObjects, crate, chair);
+	}
+
+	// Merge the static props into a few world-space meshes per material and grid cell, so that they take
+	// a handful of draw calls. The merged objects stay in the scene for picking and collision.
+	std::vector<SceneObject> staticBatches = BuildStaticBatches(meshes, sceneObjects, 8.0f);
+
+	// Give every static object that is drawn (the batches and the objects that weren't merged) its part of the
+	// lightmap atlas. The layout only depends on the scene, so a lightmap baked by an earlier run still fits.
+	// The meshes they used before are freed unless another object still uses them.
+	std::vector<SceneObject*> lightmapObjects;
+	std::vector<const SceneObject*> meshUsers;
+	for (SceneObject& object : sceneObjects)
+	{
+		if (object.isStatic && !object.isBatched)
+		{
+			lightmapObjects.push_back(&object);
+		}
+		meshUsers.push_back(&object);
+	}
+	for (SceneObject& batch : staticBatches)
+	{
+		lightmapObjects.push_back(&batch);
+		meshUsers.push_back(&batch);
+	}
+
+	Lightmap lightmap;
+	lightmap.Create(meshes, lightmapObjects, meshUsers, lightmapSize);
+	if (lightmapBakeRequested)
+	{
+		LightmapBakeSettings bakeSettings;
+		bakeSettings.lightDirection = directionalLight;
+		bakeSettings.ambientIntensity = lightAmbientIntensity;
+		bakeSettings.diffuseIntensity = lightDiffuseIntensity;
+		bakeSettings.occlusionSamples = 64;
+		bakeSettings.occlusionDistance = 2.0f;
+		lightmap.Bake(meshes, lightmapObjects, bakeSettings);
+		bool saved = lightmap.Save(lightmapPath);
+
+		materials.Destroy();
+		residency.Destroy();
+		meshes.Destroy();
+		glfwTerminate();
+		return saved ? 0 : 1;
+	}
+
+	if (lightmap.Load(lightmapPath))
+	{
+		lightmap.Upload();
+		std::cout << "Lightmap: loaded " << lightmapPath << " (F8 switches between baked and real-time lighting)" << std::endl;
+	}
+	else
+	{
+		std::cout << "Lightmap: no baked lighting, run with --bake-lightmaps to bake " << lightmapPath << std::endl;
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	// Build a bounding volume hierarchy over the world-space boxes of the objects, so that culling,
+	// picking and collision only visit the objects near the query instead of the whole scene.
+	// When an object moves, update its box with sceneBvh.Update() to refit the tree.
+	std::vector<Aabb> objectBounds;
+	for (SceneObject& object : sceneObjects)
+	{
+		const MeshInfo& info = meshes.Get(object.mesh.levels[0]);
+		object.bounds = Aabb::Transform(info.boundsMin, info.boundsMax, object.model);
+		objectBounds.push_back(object.bounds);
+	}
 
-	// Vertex attribute 0 - Position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+	Bvh sceneBvh;
+	sceneBvh.Build(objectBounds);
+
+	// The batches get their own hierarchy, since they are only ever drawn (never picked or collided with)
+	std::vector<Aabb> batchBounds;
+	for (const SceneObject& batch : staticBatches)
+	{
+		batchBounds.push_back(batch.bounds);
+	}
 
-	// Vertex attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, r)));
+	Bvh batchBvh;
+	batchBvh.Build(batchBounds);
 
-	// Vertex attribute 2 - UV coordinate
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, u)));
+	// Objects found by the BVH queries of the current frame, and the objects that a pass draws
+	std::vector<int> visibleObjects;
+	std::vector<int> visibleBatches;
+	std::vector<SceneObject*> drawList;
 
-	//Vertex attribute 3 - Normal Vectors
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, nx)));
+	// Draws of the shadow pass and the main pass, after culling and detail level selection;
+	// the GL passes and the software renderer both consume them
+	std::vector<DrawCommand> shadowDraws;
+	std::vector<DrawCommand> mainDraws;
 
-	glBindVertexArray(0);
+	// Model and projection * view * model matrices of the main pass, multiplied in one batch per frame
+	std::vector<glm::mat4> drawModels;
+	std::vector<glm::mat4> drawMatrices;
+
+	// CPU depth buffer for occlusion culling; a low resolution is enough to reject whole objects
+	OcclusionCuller occlusionCuller;
+	occlusionCuller.Create(256, 144);
+
+	// Ring buffer that systems can sub-allocate per-frame data (dynamic vertices, instance data) from;
+	// the matrices of the main pass's draws are streamed through it
+	StreamingBuffer frameStream;
+	frameStream.Create(4 * 1024 * 1024);
+
+	// Each draw's matrices start at a multiple of the uniform buffer offset alignment
+	GLint uniformBufferAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+	GLsizeiptr drawMatricesStride = (drawMatricesSize + uniformBufferAlignment - 1) / uniformBufferAlignment * uniformBufferAlignment;
 
 	// Create a shader program
 	GLuint program = CreateShaderProgram("main.vsh", "main.fsh");
@@ -488,469 +898,649 @@ int main()
 	// shader program for sadown mapping
 	GLuint program_mapping = CreateShaderProgram("map_shader.vsh", "map_shader.fsh");
 
+	// shader programs for deferred shading: geometry into the G-buffer, then lighting over the whole screen
+	GLuint program_gbuffer = CreateShaderProgram("gbuffer.vsh", "gbuffer.fsh");
+	GLuint program_lighting = CreateShaderProgram("deferred_lighting.vsh", "deferred_lighting.fsh");
+
+	// The scene programs read the per-draw matrices from the streaming buffer
+	for (GLuint sceneProgram : { program, program_gbuffer })
+	{
+		GLuint blockIndex = glGetUniformBlockIndex(sceneProgram, "DrawMatrices");
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(sceneProgram, blockIndex, drawMatricesBinding);
+		}
+	}
+
 	// Tell OpenGL the dimensions of the region where stuff will be drawn.
 	// For now, tell OpenGL to use the whole screen
 	glViewport(0, 0, windowWidth, windowHeight);
 
-	// Create a variable that will contain the ID for our texture,
-	// and use glGenTextures() to generate the texture itself
-	GLuint tex;
-	glGenTextures(1, &tex);
-
-	// --- Load our image using stb_image ---
+	// Passes of the frame and their render targets (the shadow map, the G-buffer and the scene color and depth);
+	// the targets are pooled and shared between passes that don't need them at the same time
+	RenderGraph renderGraph;
 
-	// Im image-space (pixels), (0, 0) is the upper-left corner of the image
-	// However, in u-v coordinates, (0, 0) is the lower-left corner of the image
-	// This means that the image will appear upside-down when we use the image data as is
-	// This function tells stbi to flip the image vertically so that it is not upside-down when we use it
-	stbi_set_flip_vertically_on_load(true);
+	// Layout of the G-buffer of the deferred path, and an empty vertex array object for the full-screen triangle
+	// (core profile needs one bound even though the vertices are generated in the shader)
+	GBuffer gbuffer;
 
-	// 'imageWidth' and imageHeight will contain the width and height of the loaded image respectively
-	int imageWidth, imageHeight, numChannels;
+	GLuint fullscreenVao;
+	glGenVertexArrays(1, &fullscreenVao);
 
-	// Read the image data and store it in an unsigned char array
-	unsigned char* imageData = stbi_load("final project texture.jpg", &imageWidth, &imageHeight, &numChannels, 0);
+	// Resolution of the main pass, which adapts to keep the GPU time near 60 frames per second
+	DynamicResolution resolution;
+	resolution.Create(windowWidth, windowHeight, 16.0);
 
-	// Make sure that we actually loaded the image before uploading the data to the GPU
-	if (imageData != nullptr)
-	{
-		// Our texture is 2D, so we bind our texture to the GL_TEXTURE_2D target
-		glBindTexture(GL_TEXTURE_2D, tex);
+	// Swap interval and frame pacing; the capped mode runs at 60 frames per second
+	FramePacer pacer;
+	pacer.Create(presentMode, 60.0);
 
-		// Set the filtering methods for magnification and minification
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	// Asynchronous readback of the frames shown in the window
+	FrameCapture capture;
 
-		// Set the wrapping method for the s-axis (x-axis) and t-axis (y-axis)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// GPU zones of the trace
+	GpuProfiler gpuProfiler;
+	gpuProfiler.Create();
 
-		// Upload the image data to GPU memory
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+	// Everything else on the GPU counts against the texture budget too
+	int meshMemory = residency.AddFixedResource("Mesh arenas", meshes.GetMemoryUsage());
+	residency.AddFixedResource("Frame stream", static_cast<size_t>(frameStream.GetCapacity()));
+	int renderGraphMemory = residency.AddFixedResource("Render targets", renderGraph.GetMemoryUsage());
+	residency.AddFixedResource("Lightmap", lightmap.GetMemoryUsage());
 
-		// If we set minification to use mipmaps, we can tell OpenGL to generate the mipmaps for us
-		//glGenerateMipmap(GL_TEXTURE_2D);
+	// Make the textures resident before the first frame, as far as the budget allows
+	residency.Flush();
+	residency.PrintStats();
 
-		// Once we have copied the data over to the GPU, we can delete
-		// the data on the CPU side, since we won't be using it anymore
-		stbi_image_free(imageData);
-		imageData = nullptr;
-	}
-	else
+	// CPU rasterizer, for --software and --validate-software
+	SoftwareRenderer software;
+	if (softwareRenderingEnabled || softwareValidationEnabled)
 	{
-		std::cerr << "Failed to load image" << std::endl;
+		software.Create(windowWidth, windowHeight, shadowMapSize);
+		std::cout << "Software renderer: " << software.GetThreadCount() << " threads"
+			<< (softwareRenderingEnabled ? "" : " (validation)") << std::endl;
 	}
 
-	GLuint framebuffer;
-	glGenFramebuffers(1, &framebuffer);
-
-
-	GLuint framebufferTex;
-	glGenTextures(1, &framebufferTex);
-	glBindTexture(GL_TEXTURE_2D, framebufferTex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 2048, 2048, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebufferTex, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	// Golden images and performance budgets, for --regression and --update-golden
+	RegressionSuite regression;
+	int exitCode = 0;
+	if (regressionEnabled && !regression.Create(GetRegressionCases(), goldenDirectory, goldenUpdateRequested, windowWidth, windowHeight))
 	{
-		std::cout << "Error! Framebuffer not complete!" << std::endl;
+		exitCode = 1;
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
 	}
 
-
-
-
 	glEnable(GL_DEPTH_TEST);
 
 	// Render loop
 	while (!glfwWindowShouldClose(window))
 	{
-		processInput(window);
+		PROFILE_ZONE("Frame");
+
+		// Wait for the frame's start time, then read the input as late as possible so that it is as fresh as possible
+		// when the frame is displayed
+		pacer.SetMode(presentMode);
+		pacer.WaitForFrameStart();
+
+		// Tell GLFW to process window events (e.g., input events, window closed events, etc.)
+		glfwPollEvents();
+		pacer.MarkInputSampled();
+		long long frameStart = Profiler::Now();
+
+		// Nothing can be drawn into a minimized window. The time spent minimized doesn't count as a frame, or the
+		// first frame after restoring would move the camera by the whole time.
+		if (windowWidth == 0 || windowHeight == 0)
+		{
+			glfwWaitEvents();
+			lastFrame = glfwGetTime();
+			continue;
+		}
+
+		gpuProfiler.BeginFrame();
+		processInput(window, sceneBvh, sceneObjects);
+
+		// The regression case places the camera and picks the shading path
+		if (regressionEnabled)
+		{
+			const RegressionCase& test = regression.GetCurrentCase();
+			cameraPos = test.cameraPosition;
+			cameraFront = glm::normalize(test.cameraTarget - test.cameraPosition);
+			deferredShadingEnabled = test.deferredShading;
+		}
+
+		if (captureToggleRequested)
+		{
+			captureToggleRequested = false;
+			if (capture.IsActive())
+			{
+				capture.Stop();
+			}
+			else
+			{
+				capture.Start(windowWidth, windowHeight, captureOutput, captureTarget);
+			}
+		}
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		frameStream.BeginFrame();
+
+		// Follow the window size, then pick this frame's render resolution from the measured GPU time
+		resolution.Resize(windowWidth, windowHeight);
+		residency.SetFixedResourceSize(meshMemory, meshes.GetMemoryUsage());
+		residency.SetFixedResourceSize(renderGraphMemory, renderGraph.GetMemoryUsage());
+
+		// Stream texture levels in and out, following the usage reported while drawing the last frame
+		residency.Update();
+		if (memoryReportRequested)
+		{
+			memoryReportRequested = false;
+			residency.PrintStats();
+			renderGraph.PrintStats();
+		}
+		resolution.SetEnabled(dynamicResolutionEnabled && !softwareRenderingEnabled);
+		resolution.BeginFrame();
+		int renderWidth = resolution.GetRenderWidth();
+		int renderHeight = resolution.GetRenderHeight();
+
+		if (pickRequested)
+		{
+			pickRequested = false;
+			int picked = PickObject(meshes, sceneBvh, sceneObjects);
+			if (picked >= 0)
+			{
+				std::cout << "Picked: " << sceneObjects[picked].name << std::endl;
+			}
+			else
+			{
+				std::cout << "Picked: nothing" << std::endl;
+			}
+		}
+
 		// Clear the color and depth buffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Use the shader program that we created
 		glUseProgram(program);
+		RenderStats::CountStateChange();
 
-		// Use the vertex array object that we created
-		glBindVertexArray(vao);
-
-		// Bind our texture to texture unit 0
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, framebufferTex);
-
-		// Make our sampler in the fragment shader use texture unit 0
-		GLint texUniformLocation = glGetUniformLocation(program, "tex");
-		glUniform1i(texUniformLocation, 0);
+		// Use the vertex array object that all meshes of the registry share
+		meshes.Bind();
 
 		float time = glfwGetTime();
-		// model matrices
-		glm::mat4 roomModelMatrix = glm::mat4(1.0f);
-		roomModelMatrix = glm::scale(roomModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-
-		glm::mat4 Crate1ModelMatrix = glm::mat4(1.0f);
-		Crate1ModelMatrix = glm::translate(Crate1ModelMatrix, glm::vec3(-4.0f, -4.0f, -4.0f));
-
 		glm::mat4 projectionMatrixLight = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 10.0f, 20.0f);
 		glm::mat4 viewMatrixLight = glm::lookAt(glm::vec3(0.0f, 10.0f, -10.0f), glm::vec3(0.0f, 0.0f, 0.0f), cameraUp);
-
-		glm::mat4 Crate2ModelMatrix = glm::mat4(1.0f);
-		Crate2ModelMatrix = glm::translate(Crate2ModelMatrix, glm::vec3(-4.5f, -2.6f, -3.5f));
-		Crate2ModelMatrix = glm::scale(Crate2ModelMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-		Crate2ModelMatrix = glm::rotate(Crate2ModelMatrix, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 Crate3ModelMatrix = glm::mat4(1.0f);
-		Crate3ModelMatrix = glm::translate(Crate3ModelMatrix, glm::vec3(-3.5f, -2.6f, -4.0f));
-		Crate3ModelMatrix = glm::scale(Crate3ModelMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-		Crate3ModelMatrix = glm::rotate(Crate3ModelMatrix, glm::radians(250.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 WindowModelMatrix = glm::mat4(1.0f);
-		WindowModelMatrix = glm::translate(WindowModelMatrix, glm::vec3(0.0f, 3.0f, 0.0f));
-		WindowModelMatrix = glm::scale(WindowModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-		WindowModelMatrix = glm::rotate(WindowModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 RoofModelMatrix = glm::mat4(1.0f);
-		RoofModelMatrix = glm::translate(RoofModelMatrix, glm::vec3(0.0f, 5.01f, 0.0f));
-		RoofModelMatrix = glm::scale(RoofModelMatrix, glm::vec3(6.0f, 6.0f, 6.0f));
-
-		glm::mat4 ChairBackModelMatrix = glm::mat4(1.0f);
-		ChairBackModelMatrix = glm::translate(ChairBackModelMatrix, glm::vec3(3.75f, -1.0f, -4.8f));
-		ChairBackModelMatrix = glm::scale(ChairBackModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairBackModelMatrix = glm::rotate(ChairBackModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 ChairBaseModelMatrix = glm::mat4(1.0f);
-		ChairBaseModelMatrix = glm::translate(ChairBaseModelMatrix, glm::vec3(3.0f, -1.6f, -3.2f));
-		ChairBaseModelMatrix = glm::scale(ChairBaseModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairBaseModelMatrix = glm::rotate(ChairBaseModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		ChairBaseModelMatrix = glm::rotate(ChairBaseModelMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-		glm::mat4 ChairLeg1ModelMatrix = glm::mat4(1.0f);
-		ChairLeg1ModelMatrix = glm::translate(ChairLeg1ModelMatrix, glm::vec3(2.98f, -3.7f, -3.22f));
-		ChairLeg1ModelMatrix = glm::scale(ChairLeg1ModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairLeg1ModelMatrix = glm::rotate(ChairLeg1ModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 ChairLeg2ModelMatrix = glm::mat4(1.0f);
-		ChairLeg2ModelMatrix = glm::translate(ChairLeg2ModelMatrix, glm::vec3(1.68f, -3.7f, -3.83f));
-		ChairLeg2ModelMatrix = glm::scale(ChairLeg2ModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairLeg2ModelMatrix = glm::rotate(ChairLeg2ModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 ChairLeg3ModelMatrix = glm::mat4(1.0f);
-		ChairLeg3ModelMatrix = glm::translate(ChairLeg3ModelMatrix, glm::vec3(2.5f, -3.7f, -5.6f));
-		ChairLeg3ModelMatrix = glm::scale(ChairLeg3ModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairLeg3ModelMatrix = glm::rotate(ChairLeg3ModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 ChairLeg4ModelMatrix = glm::mat4(1.0f);
-		ChairLeg4ModelMatrix = glm::translate(ChairLeg4ModelMatrix, glm::vec3(3.8f, -3.7f, -5.0f));
-		ChairLeg4ModelMatrix = glm::scale(ChairLeg4ModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
-		ChairLeg4ModelMatrix = glm::rotate(ChairLeg4ModelMatrix, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		//first pass
-		
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, 2048, 2048);
-		glUseProgram(program_mapping);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex);
-
-		GLint projectionlUniformLocationMapping = glGetUniformLocation(program_mapping, "projection");
-		glUniformMatrix4fv(projectionlUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(projectionMatrixLight));
-		GLint viewUniformLocationMapping = glGetUniformLocation(program_mapping, "view");
-		glUniformMatrix4fv(viewUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(viewMatrixLight));
-
-		GLint modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(roomModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 0, 30);
-		//glDrawArrays(GL_TRIANGLES, 36, 6);
-		//glDrawArrays(GL_TRIANGLES, 150, 6);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(Crate1ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(Crate2ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(Crate3ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(WindowModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 156, 6);
-
-		/*modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(RoofModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 162, 18);*/
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairBackModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 180, 36);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairBaseModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 180, 36);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairLeg1ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairLeg2ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairLeg3ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
-		glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(ChairLeg4ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		//second pass
-		glUseProgram(program);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, windowWidth, windowHeight);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, tex);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, framebufferTex);
+		glm::mat4 lightViewProjection = projectionMatrixLight * viewMatrixLight;
+
+		// Only the objects inside the light's view volume can cast shadows into the shadow map
+		Frustum lightFrustum = Frustum::FromMatrix(lightViewProjection);
+		sceneBvh.QueryFrustum(lightFrustum, visibleObjects);
+		batchBvh.QueryFrustum(lightFrustum, visibleBatches);
+		GatherDrawList(sceneObjects, visibleObjects, staticBatches, visibleBatches, drawList);
+
+		shadowDraws.clear();
+		for (SceneObject* drawObject : drawList)
+		{
+			SceneObject& object = *drawObject;
+			if (!object.castsShadow)
+			{
+				continue;
+			}
+
+			// Shadow casters are sized by their footprint in the shadow map, and drop one extra level
+			// since the shadow map is filtered and the lost detail is hardly visible
+			glm::vec3 boundsCenter;
+			float boundsRadius;
+			GetWorldBoundingSphere(object.mesh, object.model, boundsCenter, boundsRadius);
+			float shadowSize = ProjectedSizeOrthographic(boundsRadius, 20.0f, static_cast<float>(shadowMapSize));
+			int level = SelectLod(object.mesh, shadowSize, object.lod[LodPassShadow], 1);
+			shadowDraws.push_back({ object.mesh.levels[level], object.model, object.material, object.lightmapped });
+		}
 
 		glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-		glm::mat4 projectionMatrix = glm::perspective(glm::radians(fov), windowWidth / windowHeight, 0.1f, 100.0f);
-		glm::mat4 finalMatrix = projectionMatrix * viewMatrix * roomModelMatrix;
-
-		GLint projectionlUniformLocationMappingSecond = glGetUniformLocation(program, "projectionLight");
-		glUniformMatrix4fv(projectionlUniformLocationMappingSecond, 1, GL_FALSE, glm::value_ptr(projectionMatrixLight));
-		GLint viewUniformLocationMappingSecond = glGetUniformLocation(program, "viewLight");
-		glUniformMatrix4fv(viewUniformLocationMappingSecond, 1, GL_FALSE, glm::value_ptr(viewMatrixLight));
-		
-		GLint fboUniformLocation = glGetUniformLocation(program, "shadowMap");
-		glUniform1i(fboUniformLocation, 1);
-
-		GLint eyePositionUniformLocation = glGetUniformLocation(program, "eyePosition");
-		glUniform3f(eyePositionUniformLocation, cameraPos.x, cameraPos.y, cameraPos.z);
-
-		GLint lightAmbientUniformLocation = glGetUniformLocation(program, "point_ambient_intensity");
-		glUniform3f(lightAmbientUniformLocation, 0.4f, 0.4f, 0.4f);
-
-		GLint lightDiffuseUniformLocation = glGetUniformLocation(program, "point_diffuse_intensity");
-		glUniform3f(lightDiffuseUniformLocation, 0.8f, 0.8f, 0.8f);
-
-		GLint lightSpecularUniformLocation = glGetUniformLocation(program, "point_specular_intensity");
-		glUniform3f(lightSpecularUniformLocation, 0.2f, 0.2f, 0.2f);
-
-		GLint directionalLightUniformLocation = glGetUniformLocation(program, "directional_light");
-		glUniform3f(directionalLightUniformLocation, 0.0f, -1.0f, 1.0f);
-
-		GLint shininessUniformLocation = glGetUniformLocation(program, "u_shininess");
-		glUniform1f(shininessUniformLocation, 1.0f);
-
-
-		GLint matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		GLint modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(roomModelMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 0, 30);
-		//glDrawArrays(GL_TRIANGLES, 36, 6);
-		//glDrawArrays(GL_TRIANGLES, 150, 6);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * Crate1ModelMatrix;
-		
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(Crate1ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * Crate2ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(Crate2ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * Crate3ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(Crate3ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 42, 36);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * WindowModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(WindowModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 156, 6);
-
-		/*glm::mat4 Window2ModelMatrix = glm::mat4(1.0f);
-		Window2ModelMatrix = glm::translate(Window2ModelMatrix, glm::vec3(0.1f, 3.0f, 0.0f));
-		Window2ModelMatrix = glm::scale(Window2ModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-		Window2ModelMatrix = glm::rotate(Window2ModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		finalMatrix = projectionMatrix * viewMatrix * Window2ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		glDrawArrays(GL_TRIANGLES, 156, 6);
-
-		glm::mat4 Window3ModelMatrix = glm::mat4(1.0f);
-		Window3ModelMatrix = glm::translate(Window3ModelMatrix, glm::vec3(-9.9f, 3.0f, 0.0f));
-		Window3ModelMatrix = glm::scale(Window3ModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-		Window3ModelMatrix = glm::rotate(Window3ModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		finalMatrix = projectionMatrix * viewMatrix * Window3ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		glDrawArrays(GL_TRIANGLES, 156, 6);
-
-		glm::mat4 Window4ModelMatrix = glm::mat4(1.0f);
-		Window4ModelMatrix = glm::translate(Window4ModelMatrix, glm::vec3(-10.0f, 3.0f, 0.0f));
-		Window4ModelMatrix = glm::scale(Window4ModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-		Window4ModelMatrix = glm::rotate(Window4ModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		finalMatrix = projectionMatrix * viewMatrix * Window4ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		glDrawArrays(GL_TRIANGLES, 156, 6);*/
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * RoofModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-
-		/*glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(RoofModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 162, 18);*/
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairBackModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairBackModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 180, 36);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairBaseModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairBaseModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 180, 36);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairLeg1ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairLeg1ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairLeg2ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairLeg2ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairLeg3ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairLeg3ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		
-		finalMatrix = projectionMatrix * viewMatrix * ChairLeg4ModelMatrix;
-
-		matUniformLocation = glGetUniformLocation(program, "mat");
-		glUniformMatrix4fv(matUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-		modelUniformLocation = glGetUniformLocation(program, "model");
-		glUniformMatrix4fv(modelUniformLocation, 1, GL_FALSE, glm::value_ptr(ChairLeg4ModelMatrix));
-		glDrawArrays(GL_TRIANGLES, 216, 24);
-
-		
-
-		// "Unuse" the vertex array object
-		glBindVertexArray(0);
+		glm::mat4 projectionMatrix = glm::perspective(glm::radians(fov), static_cast<float>(renderWidth) / renderHeight, 0.1f, 100.0f);
+		glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+
+		// Frustum culling: only objects whose box is inside the camera's view volume are considered further
+		Frustum cameraFrustum = Frustum::FromMatrix(viewProjectionMatrix);
+		sceneBvh.QueryFrustum(cameraFrustum, visibleObjects);
+		batchBvh.QueryFrustum(cameraFrustum, visibleBatches);
+		GatherDrawList(sceneObjects, visibleObjects, staticBatches, visibleBatches, drawList);
+
+		// Rasterize the occluders into the Hi-Z pyramid so that objects hidden behind them can be skipped
+		if (occlusionCullingEnabled)
+		{
+			occlusionCuller.BeginFrame(viewProjectionMatrix);
+			for (int index : visibleObjects)
+			{
+				const SceneObject& object = sceneObjects[index];
+				if (object.isOccluder)
+				{
+					occlusionCuller.RasterizeOccluder(meshes.Get(object.mesh.levels[0]), object.model);
+				}
+			}
+			occlusionCuller.BuildHierarchy();
+		}
+
+		mainDraws.clear();
+		for (SceneObject* drawObject : drawList)
+		{
+			SceneObject& object = *drawObject;
+			if (occlusionCullingEnabled && !object.isOccluder)
+			{
+				const MeshInfo& bounds = meshes.Get(object.mesh.levels[0]);
+				if (!occlusionCuller.IsVisible(bounds.boundsMin, bounds.boundsMax, object.model))
+				{
+					continue;
+				}
+			}
+
+			glm::vec3 boundsCenter;
+			float boundsRadius;
+			GetWorldBoundingSphere(object.mesh, object.model, boundsCenter, boundsRadius);
+			float screenSize = ProjectedSizePerspective(boundsCenter, boundsRadius, cameraPos, glm::radians(fov), static_cast<float>(renderHeight));
+			int level = SelectLod(object.mesh, screenSize, object.lod[LodPassMain], 0);
+			materials.ReportUsage(meshes.Get(object.mesh.levels[level]).uvExtent, screenSize);
+			mainDraws.push_back({ object.mesh.levels[level], object.model, object.material, object.lightmapped });
+		}
+
+		// Lightmapped objects don't read the shadow map, so it isn't rendered if they are all that is drawn
+		// (the deferred path always lights in real time)
+		bool useLightmaps = lightmapsEnabled && lightmap.HasLighting();
+		bool shadowsNeeded = !useLightmaps || deferredShadingEnabled
+			|| !std::all_of(mainDraws.begin(), mainDraws.end(), [](const DrawCommand& draw) { return draw.lightmapped; });
+		if (!shadowsNeeded)
+		{
+			shadowDraws.clear();
+		}
+
+		if (softwareRenderingEnabled)
+		{
+			// The whole frame is rendered on the CPU and only copied into the window with OpenGL
+			software.Resize(renderWidth, renderHeight);
+			software.RenderShadowMap(meshes, shadowDraws, lightViewProjection);
+			software.RenderScene(meshes, materials, mainDraws, viewProjectionMatrix, GetSoftwareLighting(lightViewProjection, lightmap));
+			software.Present(windowWidth, windowHeight);
+		}
+		else
+		{
+			// Declare the frame's passes with the targets they read and write. The graph skips the passes whose
+			// results aren't needed (the shadow pass when only lightmapped objects are drawn), runs the rest in
+			// order and gives the targets textures from its pool. The scene targets have the window's size, and only
+			// the scaled part is rendered into.
+			renderGraph.BeginFrame();
+			RenderResource shadowMap = renderGraph.CreateTarget("Shadow map",
+				{ shadowMapSize, shadowMapSize, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_LINEAR, GL_REPEAT });
+			RenderResource sceneColor = renderGraph.CreateTarget("Scene color",
+				{ windowWidth, windowHeight, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR, GL_CLAMP_TO_EDGE });
+			RenderResource sceneDepth = renderGraph.CreateTarget("Scene depth",
+				{ windowWidth, windowHeight, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_NEAREST, GL_CLAMP_TO_EDGE });
+			RenderResource backbuffer = renderGraph.ImportBackbuffer(windowWidth, windowHeight, regressionEnabled ? regression.GetFramebuffer() : 0);
+			gbuffer.Declare(renderGraph, windowWidth, windowHeight);
+
+			int shadowPass = renderGraph.AddPass("Shadow pass", [&](const RenderGraph&)
+			{
+				glClear(GL_DEPTH_BUFFER_BIT);
+				glUseProgram(program_mapping);
+				RenderStats::CountStateChange();
+
+				GLint projectionlUniformLocationMapping = glGetUniformLocation(program_mapping, "projection");
+				glUniformMatrix4fv(projectionlUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(projectionMatrixLight));
+				GLint viewUniformLocationMapping = glGetUniformLocation(program_mapping, "view");
+				glUniformMatrix4fv(viewUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(viewMatrixLight));
+
+				GLint modelUniformLocationMapping = glGetUniformLocation(program_mapping, "model");
+				for (const DrawCommand& draw : shadowDraws)
+				{
+					glUniformMatrix4fv(modelUniformLocationMapping, 1, GL_FALSE, glm::value_ptr(draw.model));
+					RenderStats::CountStateChange();
+					meshes.Draw(draw.mesh);
+				}
+			});
+			renderGraph.Write(shadowPass, shadowMap);
+
+			// In deferred mode, the scene is only written into the G-buffer here and lit afterwards in one full-screen pass,
+			// so the lighting cost depends on the number of pixels instead of how many fragments overlap
+			GLuint sceneProgram = deferredShadingEnabled ? program_gbuffer : program;
+			int scenePass = renderGraph.AddPass(deferredShadingEnabled ? "G-buffer pass" : "Main pass", [&](const RenderGraph& graph)
+			{
+				glViewport(0, 0, renderWidth, renderHeight);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glUseProgram(sceneProgram);
+				RenderStats::CountStateChange();
+
+				// Bind the texture array of all materials to texture unit 0, and the material parameters
+				materials.Bind(sceneProgram, 0);
+
+				if (!deferredShadingEnabled)
+				{
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_2D, graph.GetTexture(shadowMap));
+					RenderStats::CountStateChange();
+					SetLightingUniforms(program, projectionMatrixLight, viewMatrixLight);
+
+					// Baked lighting of the lightmapped objects on texture unit 5
+					lightmap.Bind(5);
+					glUniform1i(glGetUniformLocation(program, "lightmap"), 5);
+				}
+
+				drawModels.resize(mainDraws.size());
+				drawMatrices.resize(mainDraws.size());
+				for (size_t i = 0; i < mainDraws.size(); i++)
+				{
+					drawModels[i] = mainDraws[i].model;
+				}
+				MultiplyMatrices(viewProjectionMatrix, drawModels.data(), drawMatrices.data(), mainDraws.size());
+
+				// Stream the matrices of all draws into one allocation of the ring, one aligned block per draw
+				if (mainDraws.empty())
+				{
+					return;
+				}
+				StreamAllocation matrices = frameStream.Allocate(drawMatricesStride * static_cast<GLsizeiptr>(mainDraws.size()), uniformBufferAlignment);
+				if (matrices.data == nullptr)
+				{
+					std::cerr << "The matrices of " << mainDraws.size() << " draws don't fit into the streaming buffer" << std::endl;
+					return;
+				}
+				unsigned char* matrixData = static_cast<unsigned char*>(matrices.data);
+				for (size_t i = 0; i < mainDraws.size(); i++)
+				{
+					std::memcpy(matrixData + i * drawMatricesStride, glm::value_ptr(drawMatrices[i]), sizeof(glm::mat4));
+					std::memcpy(matrixData + i * drawMatricesStride + sizeof(glm::mat4), glm::value_ptr(mainDraws[i].model), sizeof(glm::mat4));
+				}
+				frameStream.Commit();
+
+				GLint materialUniformLocation = glGetUniformLocation(sceneProgram, "materialIndex");
+				GLint useLightmapUniformLocation = glGetUniformLocation(sceneProgram, "useLightmap");
+				for (size_t i = 0; i < mainDraws.size(); i++)
+				{
+					glBindBufferRange(GL_UNIFORM_BUFFER, drawMatricesBinding, frameStream.GetBuffer(),
+						matrices.offset + static_cast<GLintptr>(i) * drawMatricesStride, drawMatricesSize);
+					glUniform1i(materialUniformLocation, mainDraws[i].material);
+					glUniform1i(useLightmapUniformLocation, useLightmaps && mainDraws[i].lightmapped ? 1 : 0);
+					RenderStats::CountStateChange();
+					meshes.Draw(mainDraws[i].mesh);
+				}
+			});
+			if (deferredShadingEnabled)
+			{
+				gbuffer.Write(renderGraph, scenePass);
+
+				// Deferred lighting pass: light every pixel of the G-buffer once
+				int lightingPass = renderGraph.AddPass("Lighting pass", [&](const RenderGraph& graph)
+				{
+					glViewport(0, 0, renderWidth, renderHeight);
+					glClear(GL_COLOR_BUFFER_BIT);
+
+					glUseProgram(program_lighting);
+					RenderStats::CountStateChange();
+					materials.Bind(program_lighting, 0);
+					SetLightingUniforms(program_lighting, projectionMatrixLight, viewMatrixLight);
+
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_2D, graph.GetTexture(shadowMap));
+					gbuffer.BindTextures(graph, 2);
+					RenderStats::CountStateChange();
+					glUniform1i(glGetUniformLocation(program_lighting, "gAlbedo"), 2);
+					glUniform1i(glGetUniformLocation(program_lighting, "gNormal"), 3);
+					glUniform1i(glGetUniformLocation(program_lighting, "gDepth"), 4);
+
+					// Only the scaled part of the G-buffer was drawn into
+					GLint uvScaleUniformLocation = glGetUniformLocation(program_lighting, "uvScale");
+					glUniform2f(uvScaleUniformLocation, static_cast<float>(renderWidth) / gbuffer.GetWidth(),
+						static_cast<float>(renderHeight) / gbuffer.GetHeight());
+
+					glm::mat4 inverseViewProjection = glm::inverse(viewProjectionMatrix);
+					GLint inverseViewProjectionUniformLocation = glGetUniformLocation(program_lighting, "inverseViewProjection");
+					glUniformMatrix4fv(inverseViewProjectionUniformLocation, 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
+
+					glDisable(GL_DEPTH_TEST);
+					glBindVertexArray(fullscreenVao);
+					glDrawArrays(GL_TRIANGLES, 0, 3);
+					RenderStats::CountStateChange();
+					RenderStats::CountDrawCall();
+					glEnable(GL_DEPTH_TEST);
+				});
+				gbuffer.Read(renderGraph, lightingPass);
+				renderGraph.Read(lightingPass, shadowMap);
+				renderGraph.Write(lightingPass, sceneColor);
+			}
+			else
+			{
+				if (shadowsNeeded)
+				{
+					renderGraph.Read(scenePass, shadowMap);
+				}
+				renderGraph.Write(scenePass, sceneColor);
+				renderGraph.Write(scenePass, sceneDepth);
+			}
+
+			// Stretch the scaled image over the window
+			int upscalePass = renderGraph.AddPass("Upscale", [&](const RenderGraph& graph)
+			{
+				resolution.Present(graph.GetReadFramebuffer(sceneColor), graph.GetReadFramebuffer(backbuffer));
+			});
+			renderGraph.Read(upscalePass, sceneColor);
+			renderGraph.Write(upscalePass, backbuffer);
+
+			if (renderGraph.Compile())
+			{
+				renderGraph.Execute(gpuProfiler);
+			}
+
+			// "Unuse" the vertex array object
+			glBindVertexArray(0);
+		}
+		resolution.EndFrame();
+
+		// Render the first frame again in software, with the same draws, and compare it to the GL frame
+		if (softwareValidationEnabled)
+		{
+			PROFILE_ZONE("Validate software renderer");
+			std::vector<unsigned char> glPixels(static_cast<size_t>(windowWidth) * windowHeight * 4);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			glReadBuffer(GL_BACK);
+			glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, glPixels.data());
+
+			software.Resize(windowWidth, windowHeight);
+			software.RenderShadowMap(meshes, shadowDraws, lightViewProjection);
+			software.RenderScene(meshes, materials, mainDraws, viewProjectionMatrix, GetSoftwareLighting(lightViewProjection, lightmap));
+
+			exitCode = CompareSoftwareFrame(glPixels, software.GetColorBuffer(), windowWidth, windowHeight) ? 0 : 1;
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+		}
+
+		// Draw calls and state changes of this frame; the regression suite checks them with the CPU time and the
+		// image, which ended in its framebuffer
+		FrameStats frameStats = RenderStats::EndFrame();
+		if (regressionEnabled)
+		{
+			PROFILE_ZONE("Regression");
+			double cpuMilliseconds = (Profiler::Now() - frameStart) / 1000000.0;
+			regression.EndFrame(frameStats, cpuMilliseconds);
+			if (regression.IsFinished())
+			{
+				exitCode = regression.Finish() ? 0 : 1;
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			}
+		}
+		// Read the finished image back for the capture, if one is running
+		if (capture.IsActive())
+		{
+			PROFILE_GPU_ZONE(gpuProfiler, "Capture readback");
+			capture.CaptureFrame(0, windowWidth, windowHeight);
+		}
+		gpuProfiler.EndFrame();
+
+		// Fence this frame's streamed data so that its part of the ring can be reused once the GPU is done
+		frameStream.EndFrame();
 
 		// Tell GLFW to swap the screen buffer with the offscreen buffer
-		glfwSwapBuffers(window);
-
-		// Tell GLFW to process window events (e.g., input events, window closed events, etc.)
-		glfwPollEvents();
+		{
+			PROFILE_ZONE("Swap buffers");
+			glfwSwapBuffers(window);
+		}
+		pacer.EndFrame();
 	}
 
 	// --- Cleanup ---
 
+	pacer.PrintStats();
+	pacer.Destroy();
+
+	// Write the frames that are still being read back
+	capture.Stop();
+
+	// Write the capture that is still running
+	if (Profiler::IsEnabled())
+	{
+		Profiler::SetEnabled(false);
+		Profiler::WriteChromeTrace("trace.json");
+	}
+	gpuProfiler.Destroy();
+
+	software.Destroy();
+
 	// Make sure to delete the shader program
 	glDeleteProgram(program);
+	glDeleteProgram(program_mapping);
+	glDeleteProgram(program_gbuffer);
+	glDeleteProgram(program_lighting);
+
+	// Delete the pooled render targets and their framebuffers
+	renderGraph.Destroy();
+
+	// Delete the framebuffer of the regression frames
+	regression.Destroy();
+
+	// Delete the lightmap texture
+	lightmap.Destroy();
+
+	// Delete the vertex array object of the full-screen triangle
+	glDeleteVertexArrays(1, &fullscreenVao);
 
-	// Delete the VBO that contains our vertices
-	glDeleteBuffers(1, &vbo);
+	std::cout << "Dynamic resolution: average scale " << resolution.GetAverageScale()
+		<< ", last GPU frame time " << resolution.GetGpuFrameTime() << " ms" << std::endl;
+	resolution.Destroy();
 
-	// Delete the vertex array object
-	glDeleteVertexArrays(1, &vao);
+	residency.PrintStats();
+	residency.Destroy();
+
+	// Delete the texture array and the material buffer
+	materials.Destroy();
+
+	// Delete the vertex/index arenas and the vertex array object
+	meshes.Destroy();
+
+	std::cout << "Streaming buffer (" << (frameStream.IsPersistent() ? "persistent" : "orphaning") << "): "
+		<< frameStream.GetTotalStallTime() * 1000.0 << " ms stalled in "
+		<< frameStream.GetStalledFrameCount() << " frames" << std::endl;
+	frameStream.Destroy();
 
 	// Remember to tell GLFW to clean itself up before exiting the application
 	glfwTerminate();
 
-	return 0;
+	return exitCode;
 }
 
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects)
 {
 	float cameraSpeed = 3.5 * deltaTime;
+	glm::vec3 movement(0.0f, 0.0f, 0.0f);
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 	{
-		cameraPos += cameraSpeed * cameraFront;
+		movement += cameraSpeed * cameraFront;
 	}
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
 	{
-		cameraPos -= cameraSpeed * cameraFront;
+		movement -= cameraSpeed * cameraFront;
 	}
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
 	{
-		cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+		movement -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 	}
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 	{
-		cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+		movement += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+	}
+
+	// Move one axis at a time, so that the camera slides along an object instead of stopping at it
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (movement[axis] == 0.0f)
+		{
+			continue;
+		}
+
+		glm::vec3 candidate = cameraPos;
+		candidate[axis] += movement[axis];
+		if (!CameraCollides(candidate, sceneBvh, sceneObjects))
+		{
+			cameraPos = candidate;
+		}
+	}
+}
+
+bool CameraCollides(const glm::vec3& position, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects)
+{
+	Aabb cameraBounds;
+	cameraBounds.min = position - glm::vec3(cameraRadius, cameraRadius, cameraRadius);
+	cameraBounds.max = position + glm::vec3(cameraRadius, cameraRadius, cameraRadius);
+
+	static std::vector<int> nearbyObjects;
+	sceneBvh.QueryAabb(cameraBounds, nearbyObjects);
+	for (int index : nearbyObjects)
+	{
+		if (sceneObjects[index].collidable)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int PickObject(const MeshRegistry& meshes, const Bvh& sceneBvh, const std::vector<SceneObject>& sceneObjects)
+{
+	// The cursor is captured by the camera, so the picking ray goes through the middle of the screen
+	auto intersectObject = [&](int index, float& closestDistance)
+	{
+		const SceneObject& object = sceneObjects[index];
+		const MeshInfo& mesh = meshes.Get(object.mesh.levels[0]);
+
+		// Test the triangles in object space; the distance along the ray doesn't change
+		// since the direction is transformed without being normalized
+		glm::mat4 inverseModel = glm::inverse(object.model);
+		glm::vec3 origin = glm::vec3(inverseModel * glm::vec4(cameraPos, 1.0f));
+		glm::vec3 direction = glm::vec3(inverseModel * glm::vec4(cameraFront, 0.0f));
+
+		bool hit = false;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const Vertex& a = mesh.vertices[mesh.indices[i]];
+			const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+			const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+
+			float distance;
+			if (IntersectRayTriangle(origin, direction, glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z),
+				glm::vec3(c.x, c.y, c.z), distance) && distance < closestDistance)
+			{
+				closestDistance = distance;
+				hit = true;
+			}
+		}
+		return hit;
+	};
+
+	int hitObject;
+	float hitDistance;
+	if (!sceneBvh.Raycast(cameraPos, cameraFront, 100.0f, intersectObject, hitObject, hitDistance))
+	{
+		return -1;
 	}
+	return hitObject;
 }
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
@@ -984,6 +1574,33 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
 	cameraFront = glm::normalize(front);
 }
+void GatherDrawList(std::vector<SceneObject>& sceneObjects, std::vector<int>& visibleObjects,
+	std::vector<SceneObject>& staticBatches, std::vector<int>& visibleBatches, std::vector<SceneObject*>& drawList)
+{
+	// Keep the scene order, so that the big objects added first (the room) are drawn first
+	std::sort(visibleObjects.begin(), visibleObjects.end());
+	std::sort(visibleBatches.begin(), visibleBatches.end());
+
+	drawList.clear();
+	for (int index : visibleObjects)
+	{
+		if (!sceneObjects[index].isBatched)
+		{
+			drawList.push_back(&sceneObjects[index]);
+		}
+	}
+	for (int index : visibleBatches)
+	{
+		drawList.push_back(&staticBatches[index]);
+	}
+}
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+	{
+		pickRequested = true;
+	}
+}
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	if (fov >= 1.0f && fov <= 45.0f)
@@ -993,6 +1610,60 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	if (fov >= 45.0f)
 		fov = 45.0f;
 }
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS)
+	{
+		return;
+	}
+
+	if (key == GLFW_KEY_F1)
+	{
+		occlusionCullingEnabled = !occlusionCullingEnabled;
+		std::cout << "Occlusion culling " << (occlusionCullingEnabled ? "enabled" : "disabled") << std::endl;
+	}
+	else if (key == GLFW_KEY_F2)
+	{
+		deferredShadingEnabled = !deferredShadingEnabled;
+		std::cout << "Shading path: " << (deferredShadingEnabled ? "deferred" : "forward") << std::endl;
+	}
+	else if (key == GLFW_KEY_F3)
+	{
+		dynamicResolutionEnabled = !dynamicResolutionEnabled;
+		std::cout << "Dynamic resolution " << (dynamicResolutionEnabled ? "enabled" : "disabled") << std::endl;
+	}
+	else if (key == GLFW_KEY_F4)
+	{
+		presentMode = static_cast<PresentMode>((presentMode + 1) % PresentModeCount);
+		std::cout << "Presentation mode: " << FramePacer::GetModeName(presentMode) << std::endl;
+	}
+	else if (key == GLFW_KEY_F5)
+	{
+		if (Profiler::IsEnabled())
+		{
+			Profiler::SetEnabled(false);
+			Profiler::WriteChromeTrace("trace.json");
+		}
+		else
+		{
+			Profiler::SetEnabled(true);
+			std::cout << "Trace capture started" << std::endl;
+		}
+	}
+	else if (key == GLFW_KEY_F6)
+	{
+		captureToggleRequested = true;
+	}
+	else if (key == GLFW_KEY_F7)
+	{
+		memoryReportRequested = true;
+	}
+	else if (key == GLFW_KEY_F8)
+	{
+		lightmapsEnabled = !lightmapsEnabled;
+		std::cout << "Lighting of static objects: " << (lightmapsEnabled ? "baked" : "real-time") << std::endl;
+	}
+}
 /// <summary>
 /// Creates a shader program based on the provided file paths for the vertex and fragment shaders.
 /// </summary>
@@ -1001,6 +1672,8 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 /// <returns>OpenGL handle to the created shader program</returns>
 GLuint CreateShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath)
 {
+	PROFILE_ZONE("Compile shader program");
+
 	GLuint vertexShader = CreateShaderFromFile(GL_VERTEX_SHADER, vertexShaderFilePath);
 	GLuint fragmentShader = CreateShaderFromFile(GL_FRAGMENT_SHADER, fragmentShaderFilePath);
 
@@ -1083,6 +1756,117 @@ GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shade
 	return shader;
 }
 
+/// <summary>
+/// Sets the light and shadow uniforms that the forward shader and the deferred lighting shader share.
+/// </summary>
+/// <param name="program">Program to set the uniforms of (must be in use)</param>
+/// <param name="projectionMatrixLight">Projection matrix of the shadow-casting light</param>
+/// <param name="viewMatrixLight">View matrix of the shadow-casting light</param>
+void SetLightingUniforms(GLuint program, const glm::mat4& projectionMatrixLight, const glm::mat4& viewMatrixLight)
+{
+	GLint projectionlUniformLocationMappingSecond = glGetUniformLocation(program, "projectionLight");
+	glUniformMatrix4fv(projectionlUniformLocationMappingSecond, 1, GL_FALSE, glm::value_ptr(projectionMatrixLight));
+	GLint viewUniformLocationMappingSecond = glGetUniformLocation(program, "viewLight");
+	glUniformMatrix4fv(viewUniformLocationMappingSecond, 1, GL_FALSE, glm::value_ptr(viewMatrixLight));
+
+	GLint fboUniformLocation = glGetUniformLocation(program, "shadowMap");
+	glUniform1i(fboUniformLocation, 1);
+
+	GLint eyePositionUniformLocation = glGetUniformLocation(program, "eyePosition");
+	glUniform3f(eyePositionUniformLocation, cameraPos.x, cameraPos.y, cameraPos.z);
+
+	GLint lightAmbientUniformLocation = glGetUniformLocation(program, "point_ambient_intensity");
+	glUniform3fv(lightAmbientUniformLocation, 1, glm::value_ptr(lightAmbientIntensity));
+
+	GLint lightDiffuseUniformLocation = glGetUniformLocation(program, "point_diffuse_intensity");
+	glUniform3fv(lightDiffuseUniformLocation, 1, glm::value_ptr(lightDiffuseIntensity));
+
+	GLint lightSpecularUniformLocation = glGetUniformLocation(program, "point_specular_intensity");
+	glUniform3fv(lightSpecularUniformLocation, 1, glm::value_ptr(lightSpecularIntensity));
+
+	GLint directionalLightUniformLocation = glGetUniformLocation(program, "directional_light");
+	glUniform3fv(directionalLightUniformLocation, 1, glm::value_ptr(directionalLight));
+}
+
+/// <summary>
+/// Returns the same light values that SetLightingUniforms() gives the shaders, for the software renderer.
+/// </summary>
+/// <param name="lightViewProjection">Projection * view matrix of the shadow-casting light</param>
+/// <param name="lightmap">Baked lighting, used if lightmaps are enabled</param>
+SoftwareLighting GetSoftwareLighting(const glm::mat4& lightViewProjection, const Lightmap& lightmap)
+{
+	SoftwareLighting lighting;
+	lighting.eyePosition = cameraPos;
+	lighting.lightDirection = directionalLight;
+	lighting.ambientIntensity = lightAmbientIntensity;
+	lighting.diffuseIntensity = lightDiffuseIntensity;
+	lighting.specularIntensity = lightSpecularIntensity;
+	lighting.lightViewProjection = lightViewProjection;
+	lighting.lightmap = lightmapsEnabled && lightmap.HasLighting() ? lightmap.GetPixels().data() : nullptr;
+	lighting.lightmapSize = lightmap.GetSize();
+	return lighting;
+}
+
+/// <summary>
+/// Compares a frame rendered with OpenGL to the same frame rendered by the software renderer, and writes both
+/// images and a difference image (validation_gl.png, validation_software.png, validation_diff.png).
+/// </summary>
+/// <param name="glPixels">RGBA pixels read back from OpenGL, bottom row first</param>
+/// <param name="softwarePixels">RGBA pixels of the software renderer, bottom row first</param>
+/// <returns>True if the images match closely enough</returns>
+bool CompareSoftwareFrame(const std::vector<unsigned char>& glPixels, const std::vector<unsigned char>& softwarePixels, int width, int height)
+{
+	// A pixel differs if any color channel is off by more than this; smaller differences come from the filtering
+	// precision of the GPU's texture units and are not visible
+	const int channelTolerance = 16;
+
+	// The renderers may disagree on a few pixels along edges and shadow borders, but not on more than this share
+	const double maxDifferentPixels = 0.01;
+
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	std::vector<unsigned char> difference(pixelCount * 4);
+	size_t differentPixels = 0;
+	double differenceSum = 0.0;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		int maxChannelDifference = 0;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int channelDifference = std::abs(glPixels[i * 4 + channel] - softwarePixels[i * 4 + channel]);
+			maxChannelDifference = std::max(maxChannelDifference, channelDifference);
+			differenceSum += channelDifference;
+		}
+		bool different = maxChannelDifference > channelTolerance;
+		differentPixels += different ? 1 : 0;
+
+		// Differences above the tolerance in red, the rest amplified in gray
+		unsigned char gray = static_cast<unsigned char>(std::min(maxChannelDifference * 8, 255));
+		difference[i * 4 + 0] = different ? 255 : gray;
+		difference[i * 4 + 1] = different ? 0 : gray;
+		difference[i * 4 + 2] = different ? 0 : gray;
+		difference[i * 4 + 3] = 255;
+	}
+
+	std::vector<unsigned char> opaqueGlPixels = glPixels;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		opaqueGlPixels[i * 4 + 3] = 255;
+	}
+
+	// Both buffers start with the bottom row, image files with the top row
+	stbi_flip_vertically_on_write(1);
+	stbi_write_png("validation_gl.png", width, height, 4, opaqueGlPixels.data(), width * 4);
+	stbi_write_png("validation_software.png", width, height, 4, softwarePixels.data(), width * 4);
+	stbi_write_png("validation_diff.png", width, height, 4, difference.data(), width * 4);
+
+	double differentShare = static_cast<double>(differentPixels) / pixelCount;
+	bool passed = differentShare <= maxDifferentPixels;
+	std::cout << "Software renderer validation " << (passed ? "passed" : "FAILED") << ": mean channel difference "
+		<< differenceSum / (pixelCount * 3) << ", " << differentShare * 100.0 << "% of the pixels differ by more than "
+		<< channelTolerance << " (allowed: " << maxDifferentPixels * 100.0 << "%)" << std::endl;
+	return passed;
+}
+
 /// <summary>
 /// Function for handling the event when the size of the framebuffer changed.
 /// </summary>
@@ -1092,6 +1876,9 @@ GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shade
 void FramebufferSizeChangedCallback(GLFWwindow* window, int width, int height)
 {
 	// Whenever the size of the framebuffer changed (due to window resizing, etc.),
-	// update the dimensions of the region to the new size
+	// update the dimensions of the region to the new size.
+	// The render targets and the projection follow the new size at the start of the next frame.
 	glViewport(0, 0, width, height);
+	windowWidth = width;
+	windowHeight = height;
 }
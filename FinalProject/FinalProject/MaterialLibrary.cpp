@@ -0,0 +1,223 @@
+#include "MaterialLibrary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <stb_image.h>
+
+#include "Profiler.h"
+#include "RenderStats.h"
+
+// Uniform buffer binding point of the Materials block
+static const GLuint MaterialBlockBinding = 0;
+
+// Textures are atlases of regions down to this share of their size (the crate's faces use half of the texture
+// along each axis); mip levels where such a region is narrower than MinRegionTexels are not sampled, because
+// filtering there mixes the neighbouring regions into each other
+static const float MinRegionExtent = 0.5f;
+static const float MinRegionTexels = 4.0f;
+
+/// <summary>
+/// Computes the next mip level of an RGBA8 image with a 2x2 box filter.
+/// </summary>
+static std::vector<unsigned char> Downsample(const std::vector<unsigned char>& source, int width, int height)
+{
+	int levelWidth = std::max(width / 2, 1);
+	int levelHeight = std::max(height / 2, 1);
+	std::vector<unsigned char> level(static_cast<size_t>(levelWidth) * levelHeight * 4);
+	for (int y = 0; y < levelHeight; y++)
+	{
+		int y0 = std::min(y * 2, height - 1);
+		int y1 = std::min(y * 2 + 1, height - 1);
+		for (int x = 0; x < levelWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1);
+			int x1 = std::min(x * 2 + 1, width - 1);
+			for (int channel = 0; channel < 4; channel++)
+			{
+				int sum = source[(static_cast<size_t>(y0) * width + x0) * 4 + channel] + source[(static_cast<size_t>(y0) * width + x1) * 4 + channel]
+					+ source[(static_cast<size_t>(y1) * width + x0) * 4 + channel] + source[(static_cast<size_t>(y1) * width + x1) * 4 + channel];
+				level[(static_cast<size_t>(y) * levelWidth + x) * 4 + channel] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+	return level;
+}
+
+void MaterialLibrary::Create(int maxLayers, TextureResidency& residency)
+{
+	this->maxLayers = maxLayers;
+	this->residency = &residency;
+	layerCount = 0;
+	materials.clear();
+
+	glGenBuffers(1, &materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialParams) * MaxMaterials, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MaterialLibrary::Destroy()
+{
+	glDeleteTextures(1, &textureArray);
+	glDeleteBuffers(1, &materialBuffer);
+	textureArray = 0;
+	materialBuffer = 0;
+	layerCount = 0;
+	levelCount = 0;
+	maxLevel = 0;
+	residencyId = -1;
+	materials.clear();
+	layerLevels.clear();
+}
+
+int MaterialLibrary::AddTexture(const std::string& filePath)
+{
+	PROFILE_ZONE("Load texture");
+
+	if (layerCount >= maxLayers)
+	{
+		std::cerr << "No free texture array layer for " << filePath << std::endl;
+		return -1;
+	}
+
+	// Im image-space (pixels), (0, 0) is the upper-left corner of the image
+	// However, in u-v coordinates, (0, 0) is the lower-left corner of the image
+	// This function tells stbi to flip the image vertically so that it is not upside-down when we use it
+	stbi_set_flip_vertically_on_load(true);
+
+	// Always load 4 channels so that every layer has the same format, whatever the source file has
+	int imageWidth, imageHeight, numChannels;
+	unsigned char* imageData = stbi_load(filePath.c_str(), &imageWidth, &imageHeight, &numChannels, 4);
+	if (imageData == nullptr)
+	{
+		std::cerr << "Failed to load image: " << filePath << std::endl;
+		return -1;
+	}
+
+	bool first = textureArray == 0;
+	if (first)
+	{
+		// The first texture decides the size of every layer
+		layerWidth = imageWidth;
+		layerHeight = imageHeight;
+		levelCount = static_cast<int>(std::floor(std::log2(static_cast<float>(std::max(layerWidth, layerHeight))))) + 1;
+
+		glGenTextures(1, &textureArray);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+
+		// Set the filtering methods for magnification and minification
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+		// Set the wrapping method for the s-axis (x-axis) and t-axis (y-axis)
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	else if (imageWidth != layerWidth || imageHeight != layerHeight)
+	{
+		std::cerr << "Texture " << filePath << " is " << imageWidth << "x" << imageHeight
+			<< ", but the texture array layers are " << layerWidth << "x" << layerHeight << std::endl;
+		stbi_image_free(imageData);
+		return -1;
+	}
+
+	// Build the mip chain in system memory, then delete the data that was loaded
+	std::vector<std::vector<unsigned char>> levels;
+	levels.push_back(std::vector<unsigned char>(imageData, imageData + static_cast<size_t>(layerWidth) * layerHeight * 4));
+	stbi_image_free(imageData);
+	for (int level = 1; level < levelCount; level++)
+	{
+		levels.push_back(Downsample(levels.back(), std::max(layerWidth >> (level - 1), 1), std::max(layerHeight >> (level - 1), 1)));
+	}
+	layerLevels.push_back(std::move(levels));
+
+	if (first)
+	{
+		// The residency manager defines the levels of the array and uploads the resident ones from the mip chains
+		residencyId = residency->AddTexture("Material textures", textureArray, layerWidth, layerHeight, maxLayers,
+			[this](int layer, int level) -> const unsigned char*
+			{
+				return layer < static_cast<int>(layerLevels.size()) ? layerLevels[layer][level].data() : nullptr;
+			});
+
+		// Clamp the mip chain after the residency manager defined it. GL_TEXTURE_MAX_LEVEL is absolute, unlike
+		// GL_TEXTURE_MAX_LOD, which is relative to the base level that the residency manager moves. It stays far below
+		// the resident tail, so the levels between the base level and it are always resident.
+		maxLevel = static_cast<int>(std::floor(std::log2(std::max(MinRegionExtent * std::min(layerWidth, layerHeight) / MinRegionTexels, 1.0f))));
+		maxLevel = std::max(std::min(maxLevel, levelCount - 1), GetBaseLevel());
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	else
+	{
+		// Fill the new layer into the levels that are already resident
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = GetBaseLevel(); level < levelCount; level++)
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layerCount, std::max(layerWidth >> level, 1), std::max(layerHeight >> level, 1), 1,
+				GL_RGBA, GL_UNSIGNED_BYTE, layerLevels[layerCount][level].data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	return layerCount++;
+}
+
+int MaterialLibrary::AddMaterial(int layer, float shininess, float specular)
+{
+	if (static_cast<int>(materials.size()) >= MaxMaterials)
+	{
+		std::cerr << "Too many materials (at most " << MaxMaterials << ")" << std::endl;
+		return 0;
+	}
+
+	MaterialParams params;
+	params.layer = static_cast<GLfloat>(layer < 0 ? 0 : layer);
+	params.shininess = shininess;
+	params.specular = specular;
+	params.padding = 0.0f;
+	materials.push_back(params);
+
+	return static_cast<int>(materials.size()) - 1;
+}
+
+void MaterialLibrary::Upload()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialParams) * materials.size(), materials.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MaterialLibrary::Bind(GLuint program, GLuint textureUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+	glUniform1i(glGetUniformLocation(program, "tex"), textureUnit);
+
+	GLuint blockIndex = glGetUniformBlockIndex(program, "Materials");
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, blockIndex, MaterialBlockBinding);
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, MaterialBlockBinding, materialBuffer);
+	RenderStats::CountStateChange(2);
+}
+
+void MaterialLibrary::ReportUsage(float uvExtent, float pixelsAcross)
+{
+	if (residencyId < 0)
+	{
+		return;
+	}
+
+	// Every material samples the same texture array, whose levels are resident for all layers together.
+	// Its level at which one texel covers about one pixel:
+	float texelsAcross = uvExtent * std::max(layerWidth, layerHeight);
+	residency->RequestLevel(residencyId, std::log2(std::max(texelsAcross, 1.0f) / std::max(pixelsAcross, 1.0f)));
+}
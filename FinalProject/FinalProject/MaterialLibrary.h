@@ -0,0 +1,134 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "TextureResidency.h"
+
+// Maximum number of materials; must match the size of the Materials block in main.fsh
+const int MaxMaterials = 64;
+
+/// <summary>
+/// Surface parameters of a material, laid out like one element of the std140 Materials block in main.fsh.
+/// </summary>
+struct MaterialParams
+{
+	GLfloat layer;			// Layer of the texture array to sample
+	GLfloat shininess;		// Specular exponent
+	GLfloat specular;		// Scale of the specular highlight
+	GLfloat padding;
+};
+
+/// <summary>
+/// Owns all surface textures and materials of the scene.
+///
+/// Textures of the same size are packed into the layers of a single GL_TEXTURE_2D_ARRAY, and the parameters
+/// of every material (texture layer, shininess, specular strength) are stored in one uniform buffer.
+/// A draw only has to select its material by index, so objects with different materials share
+/// the same texture bind and can be merged into the same draw call.
+///
+/// The texture array is mipmapped and streamed by the texture residency manager: the full mip chain of every
+/// layer stays in system memory, and the levels on the GPU follow the usage reported with ReportUsage().
+/// Textures may be atlases of several regions, so the coarsest levels, where the regions would bleed into each
+/// other, are never sampled.
+/// </summary>
+class MaterialLibrary
+{
+public:
+	/// <summary>
+	/// Creates the uniform buffer for the material parameters.
+	/// The texture array is allocated when the first texture is added, using that texture's size.
+	/// </summary>
+	/// <param name="maxLayers">Number of texture layers to reserve</param>
+	/// <param name="residency">Residency manager that streams the mip levels of the texture array</param>
+	void Create(int maxLayers, TextureResidency& residency);
+
+	/// <summary>
+	/// Deletes the texture array and the uniform buffer.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Loads an image file into the next free layer of the texture array.
+	/// </summary>
+	/// <param name="filePath">Path to the image file</param>
+	/// <returns>Index of the layer, or -1 if the image could not be loaded or has the wrong size</returns>
+	int AddTexture(const std::string& filePath);
+
+	/// <summary>
+	/// Adds a material. Call Upload() after the last material was added.
+	/// </summary>
+	/// <param name="layer">Texture layer returned by AddTexture()</param>
+	/// <param name="shininess">Specular exponent</param>
+	/// <param name="specular">Scale of the specular highlight</param>
+	/// <returns>Index of the material, used to select it when drawing</returns>
+	int AddMaterial(int layer, float shininess, float specular);
+
+	/// <summary>
+	/// Copies the material parameters into the uniform buffer.
+	/// </summary>
+	void Upload();
+
+	/// <summary>
+	/// Binds the texture array and the material buffer for the given shader program.
+	/// </summary>
+	/// <param name="program">Program that declares the 'tex' sampler and the 'Materials' block</param>
+	/// <param name="textureUnit">Texture unit to bind the array to</param>
+	void Bind(GLuint program, GLuint textureUnit) const;
+
+	/// <summary>
+	/// Reports that an object was drawn, so that the texture array is streamed in enough detail. The levels are
+	/// resident for all layers together, so the object's material doesn't matter.
+	/// </summary>
+	/// <param name="uvExtent">Extent of the object's UV coordinates (the share of the texture it covers)</param>
+	/// <param name="pixelsAcross">Size of the object on screen, in pixels</param>
+	void ReportUsage(float uvExtent, float pixelsAcross);
+
+	/// <returns>OpenGL handle to the texture array</returns>
+	GLuint GetTextureArray() const { return textureArray; }
+
+	/// <returns>Number of texture layers in use</returns>
+	int GetLayerCount() const { return layerCount; }
+
+	/// <returns>Number of materials</returns>
+	int GetMaterialCount() const { return static_cast<int>(materials.size()); }
+
+	/// <returns>Parameters of a material</returns>
+	const MaterialParams& GetMaterial(int material) const { return materials[material]; }
+
+	int GetLayerWidth() const { return layerWidth; }
+	int GetLayerHeight() const { return layerHeight; }
+
+	/// <returns>Number of mip levels of the texture array</returns>
+	int GetLevelCount() const { return levelCount; }
+
+	/// <returns>Coarsest mip level that is sampled; the regions of an atlas don't bleed into each other down to it</returns>
+	int GetMaxLevel() const { return maxLevel; }
+
+	/// <returns>Finest mip level that is resident on the GPU (the level sampled when magnifying)</returns>
+	int GetBaseLevel() const { return residency->GetResidentLevel(residencyId); }
+
+	/// <returns>RGBA pixels of a mip level of a texture layer, bottom row first (like the texture array)</returns>
+	const unsigned char* GetLayerPixels(int layer, int level = 0) const { return layerLevels[layer][level].data(); }
+
+private:
+	GLuint textureArray = 0;
+	GLuint materialBuffer = 0;
+
+	int layerWidth = 0;
+	int layerHeight = 0;
+	int layerCount = 0;
+	int maxLayers = 0;
+	int levelCount = 0;
+	int maxLevel = 0;
+
+	TextureResidency* residency = nullptr;
+	int residencyId = -1;
+
+	std::vector<MaterialParams> materials;
+
+	// Mip chain of every layer in system memory: the source of the streamed levels, also sampled on the CPU
+	std::vector<std::vector<std::vector<unsigned char>>> layerLevels;
+};
@@ -0,0 +1,425 @@
+#include "MeshRegistry.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+#include "RenderStats.h"
+
+// ---------------
+// FreeListAllocator
+// ---------------
+
+void FreeListAllocator::Reset(GLuint capacity)
+{
+	this->capacity = capacity;
+	freeCount = capacity;
+	freeBlocks.clear();
+	if (capacity > 0)
+	{
+		freeBlocks[0] = capacity;
+	}
+}
+
+bool FreeListAllocator::Allocate(GLuint count, GLuint& offset)
+{
+	for (std::map<GLuint, GLuint>::iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+	{
+		if (it->second < count)
+		{
+			continue;
+		}
+
+		offset = it->first;
+		GLuint remaining = it->second - count;
+		freeBlocks.erase(it);
+		if (remaining > 0)
+		{
+			freeBlocks[offset + count] = remaining;
+		}
+		freeCount -= count;
+		return true;
+	}
+
+	return false;
+}
+
+void FreeListAllocator::Free(GLuint offset, GLuint count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::map<GLuint, GLuint>::iterator block = freeBlocks.insert(std::make_pair(offset, count)).first;
+	freeCount += count;
+
+	// Merge with the following block
+	std::map<GLuint, GLuint>::iterator next = std::next(block);
+	if (next != freeBlocks.end() && block->first + block->second == next->first)
+	{
+		block->second += next->second;
+		freeBlocks.erase(next);
+	}
+
+	// Merge with the preceding block
+	if (block != freeBlocks.begin())
+	{
+		std::map<GLuint, GLuint>::iterator previous = std::prev(block);
+		if (previous->first + previous->second == block->first)
+		{
+			previous->second += block->second;
+			freeBlocks.erase(block);
+		}
+	}
+}
+
+void FreeListAllocator::Grow(GLuint newCapacity)
+{
+	if (newCapacity <= capacity)
+	{
+		return;
+	}
+
+	GLuint oldCapacity = capacity;
+	capacity = newCapacity;
+	Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+GLuint FreeListAllocator::GetLargestFreeBlock() const
+{
+	GLuint largest = 0;
+	for (std::map<GLuint, GLuint>::const_iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+	{
+		largest = std::max(largest, it->second);
+	}
+	return largest;
+}
+
+// ---------------
+// MeshRegistry
+// ---------------
+
+/// <summary>
+/// Hash function used to find identical vertices when generating index buffers.
+/// </summary>
+struct VertexHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		const GLfloat values[] = { vertex.x, vertex.y, vertex.z, vertex.u, vertex.v, vertex.nx, vertex.ny, vertex.nz, vertex.lu, vertex.lv };
+		size_t hash = (vertex.r << 16) | (vertex.g << 8) | vertex.b;
+		for (GLfloat value : values)
+		{
+			hash = hash * 31 + std::hash<GLfloat>()(value);
+		}
+		return hash;
+	}
+};
+
+void MeshRegistry::Create(GLuint vertexCapacity, GLuint indexCapacity)
+{
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	vertexArena.Reset(vertexCapacity);
+	indexArena.Reset(indexCapacity);
+
+	glGenVertexArrays(1, &vao);
+	SetupVertexArray();
+}
+
+void MeshRegistry::Destroy()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	vao = 0;
+	vertexBuffer = 0;
+	indexBuffer = 0;
+
+	meshes.clear();
+	freeHandles.clear();
+	liveMeshCount = 0;
+}
+
+MeshHandle MeshRegistry::Add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	if (vertices.empty() || indices.empty())
+	{
+		return 0;
+	}
+
+	GLuint vertexCount = static_cast<GLuint>(vertices.size());
+	GLuint indexCount = static_cast<GLuint>(indices.size());
+	Reserve(vertexCount, indexCount);
+
+	GLuint baseVertex = 0;
+	GLuint firstIndex = 0;
+	vertexArena.Allocate(vertexCount, baseVertex);
+	indexArena.Allocate(indexCount, firstIndex);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * sizeof(Vertex), vertexCount * sizeof(Vertex), vertices.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint), indices.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	MeshInfo info;
+	info.baseVertex = static_cast<GLint>(baseVertex);
+	info.vertexCount = vertexCount;
+	info.firstIndex = firstIndex;
+	info.indexCount = static_cast<GLsizei>(indexCount);
+	info.boundsMin = glm::vec3(vertices[0].x, vertices[0].y, vertices[0].z);
+	info.boundsMax = info.boundsMin;
+	glm::vec2 uvMin(vertices[0].u, vertices[0].v);
+	glm::vec2 uvMax = uvMin;
+	for (const Vertex& vertex : vertices)
+	{
+		glm::vec3 position(vertex.x, vertex.y, vertex.z);
+		info.boundsMin = glm::min(info.boundsMin, position);
+		info.boundsMax = glm::max(info.boundsMax, position);
+		uvMin = glm::min(uvMin, glm::vec2(vertex.u, vertex.v));
+		uvMax = glm::max(uvMax, glm::vec2(vertex.u, vertex.v));
+	}
+	info.uvExtent = std::max(uvMax.x - uvMin.x, uvMax.y - uvMin.y);
+	info.live = true;
+	info.vertices = vertices;
+	info.indices = indices;
+
+	MeshHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		meshes[handle - 1] = info;
+	}
+	else
+	{
+		meshes.push_back(info);
+		handle = static_cast<MeshHandle>(meshes.size());
+	}
+
+	liveMeshCount++;
+	return handle;
+}
+
+MeshHandle MeshRegistry::AddTriangles(const Vertex* triangles, GLuint count)
+{
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	std::unordered_map<Vertex, GLuint, VertexHash> lookup;
+
+	indices.reserve(count);
+	for (GLuint i = 0; i < count; i++)
+	{
+		std::unordered_map<Vertex, GLuint, VertexHash>::iterator found = lookup.find(triangles[i]);
+		if (found != lookup.end())
+		{
+			indices.push_back(found->second);
+			continue;
+		}
+
+		GLuint index = static_cast<GLuint>(vertices.size());
+		vertices.push_back(triangles[i]);
+		lookup[triangles[i]] = index;
+		indices.push_back(index);
+	}
+
+	return Add(vertices, indices);
+}
+
+void MeshRegistry::Remove(MeshHandle mesh)
+{
+	if (!IsValid(mesh))
+	{
+		return;
+	}
+
+	MeshInfo& info = meshes[mesh - 1];
+	vertexArena.Free(static_cast<GLuint>(info.baseVertex), info.vertexCount);
+	indexArena.Free(info.firstIndex, static_cast<GLuint>(info.indexCount));
+
+	info.live = false;
+	info.vertices.clear();
+	info.vertices.shrink_to_fit();
+	info.indices.clear();
+	info.indices.shrink_to_fit();
+
+	freeHandles.push_back(mesh);
+	liveMeshCount--;
+}
+
+void MeshRegistry::Defragment()
+{
+	vertexBuffer = Reallocate(vertexBuffer, sizeof(Vertex), vertexArena.GetCapacity(), false, true);
+	indexBuffer = Reallocate(indexBuffer, sizeof(GLuint), indexArena.GetCapacity(), true, true);
+	SetupVertexArray();
+}
+
+void MeshRegistry::Bind() const
+{
+	glBindVertexArray(vao);
+	RenderStats::CountStateChange();
+}
+
+void MeshRegistry::Draw(MeshHandle mesh) const
+{
+	const MeshInfo& info = meshes[mesh - 1];
+	RenderStats::CountDrawCall();
+	glDrawElementsBaseVertex(GL_TRIANGLES, info.indexCount, GL_UNSIGNED_INT,
+		(void*)(info.firstIndex * sizeof(GLuint)), info.baseVertex);
+}
+
+void MeshRegistry::PrintStats() const
+{
+	std::cout << "Mesh registry: " << liveMeshCount << " meshes, "
+		<< (vertexArena.GetCapacity() - vertexArena.GetFreeCount()) << "/" << vertexArena.GetCapacity() << " vertices ("
+		<< vertexArena.GetFreeBlockCount() << " free blocks), "
+		<< (indexArena.GetCapacity() - indexArena.GetFreeCount()) << "/" << indexArena.GetCapacity() << " indices ("
+		<< indexArena.GetFreeBlockCount() << " free blocks)" << std::endl;
+}
+
+void MeshRegistry::SetupVertexArray()
+{
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	// Vertex attribute 0 - Position
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+
+	// Vertex attribute 1 - Color
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, r)));
+
+	// Vertex attribute 2 - UV coordinate
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, u)));
+
+	//Vertex attribute 3 - Normal Vectors
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, nx)));
+
+	// Vertex attribute 4 - Lightmap UV coordinate
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, lu)));
+
+	// The element buffer binding is part of the vertex array object's state
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshRegistry::Reserve(GLuint vertexCount, GLuint indexCount)
+{
+	bool changed = false;
+
+	if (vertexArena.GetLargestFreeBlock() < vertexCount)
+	{
+		GLuint capacity = vertexArena.GetCapacity();
+		bool compact = vertexArena.GetFreeCount() >= vertexCount;
+		if (!compact)
+		{
+			capacity = std::max(capacity * 2, capacity + vertexCount);
+		}
+		vertexBuffer = Reallocate(vertexBuffer, sizeof(Vertex), capacity, false, compact);
+		changed = true;
+	}
+
+	if (indexArena.GetLargestFreeBlock() < indexCount)
+	{
+		GLuint capacity = indexArena.GetCapacity();
+		bool compact = indexArena.GetFreeCount() >= indexCount;
+		if (!compact)
+		{
+			capacity = std::max(capacity * 2, capacity + indexCount);
+		}
+		indexBuffer = Reallocate(indexBuffer, sizeof(GLuint), capacity, true, compact);
+		changed = true;
+	}
+
+	if (changed)
+	{
+		SetupVertexArray();
+	}
+}
+
+GLuint MeshRegistry::Reallocate(GLuint oldBuffer, GLuint elementSize, GLuint newCapacity, bool isIndexArena, bool compact)
+{
+	FreeListAllocator& arena = isIndexArena ? indexArena : vertexArena;
+
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newCapacity) * elementSize, nullptr, GL_STATIC_DRAW);
+
+	if (compact)
+	{
+		// Visit the live meshes in arena order so that each one moves towards the start of the buffer
+		std::vector<MeshInfo*> order;
+		for (MeshInfo& info : meshes)
+		{
+			if (info.live)
+			{
+				order.push_back(&info);
+			}
+		}
+		std::sort(order.begin(), order.end(), [isIndexArena](const MeshInfo* a, const MeshInfo* b)
+		{
+			return isIndexArena ? a->firstIndex < b->firstIndex : a->baseVertex < b->baseVertex;
+		});
+
+		GLuint packed = 0;
+		for (MeshInfo* info : order)
+		{
+			GLuint offset = isIndexArena ? info->firstIndex : static_cast<GLuint>(info->baseVertex);
+			GLuint count = isIndexArena ? static_cast<GLuint>(info->indexCount) : info->vertexCount;
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				static_cast<GLintptr>(offset) * elementSize, static_cast<GLintptr>(packed) * elementSize,
+				static_cast<GLsizeiptr>(count) * elementSize);
+
+			if (isIndexArena)
+			{
+				info->firstIndex = packed;
+			}
+			else
+			{
+				info->baseVertex = static_cast<GLint>(packed);
+			}
+			packed += count;
+		}
+
+		// Everything before 'packed' is in use, everything after it is one free block
+		GLuint used;
+		arena.Reset(newCapacity);
+		if (packed > 0)
+		{
+			arena.Allocate(packed, used);
+		}
+	}
+	else
+	{
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+			static_cast<GLsizeiptr>(arena.GetCapacity()) * elementSize);
+		arena.Grow(newCapacity);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &oldBuffer);
+
+	return newBuffer;
+}
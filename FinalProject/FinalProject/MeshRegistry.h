@@ -0,0 +1,190 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+/// <summary>
+/// Handle to a mesh stored in the MeshRegistry. A value of 0 means "no mesh".
+/// </summary>
+typedef unsigned int MeshHandle;
+
+/// <summary>
+/// First-fit free-list allocator over a range of elements [0, capacity).
+/// Freed ranges are merged with their neighbours so the free list does not fragment over time.
+/// </summary>
+class FreeListAllocator
+{
+public:
+	/// <summary>
+	/// Resets the allocator to a single free block covering the whole capacity.
+	/// </summary>
+	/// <param name="capacity">Number of elements that can be allocated</param>
+	void Reset(GLuint capacity);
+
+	/// <summary>
+	/// Allocates a contiguous range of elements.
+	/// </summary>
+	/// <param name="count">Number of elements</param>
+	/// <param name="offset">Receives the first element of the range</param>
+	/// <returns>True if a free range that is large enough was found</returns>
+	bool Allocate(GLuint count, GLuint& offset);
+
+	/// <summary>
+	/// Returns a range of elements to the free list.
+	/// </summary>
+	void Free(GLuint offset, GLuint count);
+
+	/// <summary>
+	/// Adds elements at the end of the range, e.g., after the backing buffer has grown.
+	/// </summary>
+	void Grow(GLuint newCapacity);
+
+	GLuint GetCapacity() const { return capacity; }
+	GLuint GetFreeCount() const { return freeCount; }
+	GLuint GetLargestFreeBlock() const;
+	size_t GetFreeBlockCount() const { return freeBlocks.size(); }
+
+private:
+	// Free blocks, keyed by their first element, valued by their size
+	std::map<GLuint, GLuint> freeBlocks;
+	GLuint capacity = 0;
+	GLuint freeCount = 0;
+};
+
+/// <summary>
+/// Data about a mesh that lives inside the registry's arenas.
+/// </summary>
+struct MeshInfo
+{
+	GLint baseVertex;		// First vertex of the mesh inside the vertex arena
+	GLuint vertexCount;
+	GLuint firstIndex;		// First index of the mesh inside the index arena
+	GLsizei indexCount;
+	glm::vec3 boundsMin;	// Object-space bounding box
+	glm::vec3 boundsMax;
+	float uvExtent;			// Largest extent of the UV coordinates along u or v (how much of the texture the mesh covers)
+	bool live;
+
+	// CPU copy of the geometry, kept for systems that process meshes on the CPU
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+};
+
+/// <summary>
+/// Stores any number of meshes inside one large vertex buffer and one large index buffer,
+/// sharing a single vertex array object. Meshes are drawn with glDrawElementsBaseVertex,
+/// so loading or unloading meshes never creates or deletes buffer objects.
+/// The arenas grow (by doubling) when they run out of space, and can be compacted with Defragment().
+/// </summary>
+class MeshRegistry
+{
+public:
+	/// <summary>
+	/// Creates the arenas and the vertex array object.
+	/// </summary>
+	/// <param name="vertexCapacity">Initial number of vertices the vertex arena can hold</param>
+	/// <param name="indexCapacity">Initial number of indices the index arena can hold</param>
+	void Create(GLuint vertexCapacity, GLuint indexCapacity);
+
+	/// <summary>
+	/// Deletes the arenas and the vertex array object.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Uploads an indexed mesh into the arenas.
+	/// </summary>
+	/// <returns>Handle to the mesh, or 0 if the mesh is empty</returns>
+	MeshHandle Add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	/// <summary>
+	/// Uploads a non-indexed triangle list (like the vertex arrays of the scene) into the arenas.
+	/// Identical vertices are merged and an index buffer is generated for them. The whole array is one mesh,
+	/// so its vertex count can't get out of step with the data.
+	/// </summary>
+	/// <param name="triangles">Vertices of the triangle list, three per triangle</param>
+	/// <returns>Handle to the mesh, or 0 if the mesh is empty</returns>
+	template <size_t Count>
+	MeshHandle AddTriangles(const Vertex (&triangles)[Count])
+	{
+		return AddTriangles(triangles, static_cast<GLuint>(Count));
+	}
+
+	/// <summary>
+	/// Releases the arena space of a mesh. The handle becomes invalid.
+	/// </summary>
+	void Remove(MeshHandle mesh);
+
+	/// <summary>
+	/// Moves all live meshes to the start of the arenas so that the free space becomes one contiguous block.
+	/// </summary>
+	void Defragment();
+
+	/// <summary>
+	/// Binds the vertex array object that all meshes of the registry are drawn with.
+	/// </summary>
+	void Bind() const;
+
+	/// <summary>
+	/// Draws a mesh. The registry's vertex array object must be bound.
+	/// </summary>
+	void Draw(MeshHandle mesh) const;
+
+	/// <returns>Data about the mesh</returns>
+	const MeshInfo& Get(MeshHandle mesh) const { return meshes[mesh - 1]; }
+
+	/// <returns>True if the handle refers to a mesh that has not been removed</returns>
+	bool IsValid(MeshHandle mesh) const { return mesh != 0 && mesh <= meshes.size() && meshes[mesh - 1].live; }
+
+	GLuint GetVertexArray() const { return vao; }
+	GLuint GetVertexBuffer() const { return vertexBuffer; }
+	GLuint GetIndexBuffer() const { return indexBuffer; }
+
+	/// <returns>GPU memory of both arenas in bytes</returns>
+	size_t GetMemoryUsage() const { return static_cast<size_t>(vertexArena.GetCapacity()) * sizeof(Vertex) + static_cast<size_t>(indexArena.GetCapacity()) * sizeof(GLuint); }
+
+	/// <summary>
+	/// Prints the number of meshes and the arena usage to the console.
+	/// </summary>
+	void PrintStats() const;
+
+private:
+	/// <summary>
+	/// Uploads a non-indexed triangle list of the given number of vertices (see the public overload).
+	/// </summary>
+	MeshHandle AddTriangles(const Vertex* triangles, GLuint count);
+
+	/// <summary>
+	/// Points the vertex array object's attributes and element buffer at the current arenas.
+	/// </summary>
+	void SetupVertexArray();
+
+	/// <summary>
+	/// Makes sure both arenas have room for the mesh, defragmenting or growing them if needed.
+	/// </summary>
+	void Reserve(GLuint vertexCount, GLuint indexCount);
+
+	/// <summary>
+	/// Moves the contents of an arena into a new buffer of the given size.
+	/// If compact is true, the live meshes are packed together at the start of the new buffer.
+	/// </summary>
+	GLuint Reallocate(GLuint oldBuffer, GLuint elementSize, GLuint newCapacity, bool isIndexArena, bool compact);
+
+	GLuint vao = 0;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+
+	FreeListAllocator vertexArena;
+	FreeListAllocator indexArena;
+
+	std::vector<MeshInfo> meshes;
+	std::vector<MeshHandle> freeHandles;
+	int liveMeshCount = 0;
+};
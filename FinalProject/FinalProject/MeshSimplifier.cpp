@@ -0,0 +1,401 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Symmetric 4x4 matrix that measures the sum of squared distances of a point to a set of planes.
+/// </summary>
+struct Quadric
+{
+	// a2, ab, ac, ad, b2, bc, bd, c2, cd, d2
+	double m[10] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	void AddPlane(const glm::vec3& normal, float d, double weight)
+	{
+		double a = normal.x, b = normal.y, c = normal.z, dd = d;
+		m[0] += weight * a * a; m[1] += weight * a * b; m[2] += weight * a * c; m[3] += weight * a * dd;
+		m[4] += weight * b * b; m[5] += weight * b * c; m[6] += weight * b * dd;
+		m[7] += weight * c * c; m[8] += weight * c * dd;
+		m[9] += weight * dd * dd;
+	}
+
+	void Add(const Quadric& other)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			m[i] += other.m[i];
+		}
+	}
+
+	double Evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+			+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+			+ m[7] * z * z + 2.0 * m[8] * z
+			+ m[9];
+	}
+};
+
+/// <summary>
+/// Candidate edge collapse waiting in the priority queue.
+/// The versions are used to detect entries that went stale because one of the endpoints absorbed another position.
+/// </summary>
+struct EdgeCollapse
+{
+	double cost;
+	int keep, remove;
+	int keepVersion, removeVersion;
+	glm::vec3 target;
+
+	bool operator>(const EdgeCollapse& other) const { return cost > other.cost; }
+};
+
+/// <summary>
+/// Triangle of the mesh being simplified, referencing both the original vertices (for attributes)
+/// and the welded positions (for topology).
+/// </summary>
+struct SimplifyTriangle
+{
+	GLuint vertex[3];
+	int position[3];
+	bool alive;
+};
+
+// Weight of the planes that keep open boundaries (e.g., the edges of the window quad) in place
+static const double BoundaryWeight = 100.0;
+
+// Triangles whose normal turns by more than this (cosine) are considered flipped
+static const float MinNormalCosine = 0.2f;
+
+static uint64_t EdgeKey(int a, int b)
+{
+	if (a > b)
+	{
+		std::swap(a, b);
+	}
+	return (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b);
+}
+
+static glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+size_t SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+	size_t targetTriangleCount, float maxError,
+	std::vector<Vertex>& outVertices, std::vector<GLuint>& outIndices)
+{
+	outVertices.clear();
+	outIndices.clear();
+
+	// --- Weld vertices that share a position ---
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			std::hash<float> hasher;
+			return hasher(p.x) * 73856093u ^ hasher(p.y) * 19349663u ^ hasher(p.z) * 83492791u;
+		}
+	};
+	struct PositionEqual
+	{
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+	};
+
+	std::unordered_map<glm::vec3, int, PositionHash, PositionEqual> positionLookup;
+	std::vector<int> vertexPosition(vertices.size());
+	std::vector<glm::vec3> positions;
+	std::vector<std::vector<GLuint>> positionVertices;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		glm::vec3 p(vertices[i].x, vertices[i].y, vertices[i].z);
+		std::unordered_map<glm::vec3, int, PositionHash, PositionEqual>::iterator found = positionLookup.find(p);
+		if (found == positionLookup.end())
+		{
+			found = positionLookup.insert(std::make_pair(p, static_cast<int>(positions.size()))).first;
+			positions.push_back(p);
+			positionVertices.push_back(std::vector<GLuint>());
+		}
+		vertexPosition[i] = found->second;
+		positionVertices[found->second].push_back(static_cast<GLuint>(i));
+	}
+
+	size_t positionCount = positions.size();
+	std::vector<Quadric> quadrics(positionCount);
+	std::vector<bool> positionAlive(positionCount, true);
+	std::vector<int> positionVersion(positionCount, 0);
+	std::vector<std::vector<int>> adjacency(positionCount);
+
+	// --- Build triangles and their plane quadrics ---
+
+	std::vector<SimplifyTriangle> triangles;
+	std::unordered_map<uint64_t, int> edgeUseCount;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		SimplifyTriangle triangle;
+		for (int k = 0; k < 3; k++)
+		{
+			triangle.vertex[k] = indices[i + k];
+			triangle.position[k] = vertexPosition[indices[i + k]];
+		}
+		triangle.alive = triangle.position[0] != triangle.position[1]
+			&& triangle.position[1] != triangle.position[2]
+			&& triangle.position[0] != triangle.position[2];
+		if (!triangle.alive)
+		{
+			continue;
+		}
+
+		glm::vec3 normal = TriangleNormal(positions[triangle.position[0]], positions[triangle.position[1]], positions[triangle.position[2]]);
+		float doubleArea = glm::length(normal);
+		if (doubleArea > 0.0f)
+		{
+			normal /= doubleArea;
+			float d = -glm::dot(normal, positions[triangle.position[0]]);
+			for (int k = 0; k < 3; k++)
+			{
+				quadrics[triangle.position[k]].AddPlane(normal, d, 0.5 * doubleArea);
+			}
+		}
+
+		int index = static_cast<int>(triangles.size());
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[triangle.position[k]].push_back(index);
+			edgeUseCount[EdgeKey(triangle.position[k], triangle.position[(k + 1) % 3])]++;
+		}
+		triangles.push_back(triangle);
+	}
+
+	size_t aliveTriangles = triangles.size();
+
+	// Open edges get an extra plane perpendicular to their triangle, so that the outline is preserved
+	for (const SimplifyTriangle& triangle : triangles)
+	{
+		glm::vec3 faceNormal = TriangleNormal(positions[triangle.position[0]], positions[triangle.position[1]], positions[triangle.position[2]]);
+		for (int k = 0; k < 3; k++)
+		{
+			int a = triangle.position[k];
+			int b = triangle.position[(k + 1) % 3];
+			if (edgeUseCount[EdgeKey(a, b)] != 1)
+			{
+				continue;
+			}
+
+			glm::vec3 edge = positions[b] - positions[a];
+			glm::vec3 normal = glm::cross(edge, faceNormal);
+			float length = glm::length(normal);
+			if (length <= 0.0f)
+			{
+				continue;
+			}
+			normal /= length;
+			float d = -glm::dot(normal, positions[a]);
+			double weight = BoundaryWeight * glm::dot(edge, edge);
+			quadrics[a].AddPlane(normal, d, weight);
+			quadrics[b].AddPlane(normal, d, weight);
+		}
+	}
+
+	// --- Greedy half-edge collapses, cheapest first ---
+
+	// Collapsing onto one of the two endpoints (instead of an optimal new position) means the surviving
+	// vertices keep their exact original UVs and normals, so no attribute interpolation is needed.
+	std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, std::greater<EdgeCollapse>> queue;
+
+	std::function<void(int, int)> pushEdge = [&](int a, int b)
+	{
+		Quadric combined = quadrics[a];
+		combined.Add(quadrics[b]);
+
+		double costA = combined.Evaluate(positions[a]);
+		double costB = combined.Evaluate(positions[b]);
+
+		EdgeCollapse collapse;
+		collapse.keep = costA <= costB ? a : b;
+		collapse.remove = costA <= costB ? b : a;
+		collapse.cost = std::min(costA, costB);
+		collapse.target = positions[collapse.keep];
+		collapse.keepVersion = positionVersion[collapse.keep];
+		collapse.removeVersion = positionVersion[collapse.remove];
+		queue.push(collapse);
+	};
+
+	// Picks the vertex at the kept position whose normal is closest to the given vertex,
+	// so that corners on either side of a hard edge stay on their own side. Among equally close normals,
+	// the closest lightmap UV wins, so that corners stay inside their lightmap chart.
+	std::function<GLuint(GLuint, int)> matchVertex = [&](GLuint vertex, int position)
+	{
+		const Vertex& source = vertices[vertex];
+		GLuint best = positionVertices[position][0];
+		float bestDot = -2.0f;
+		float bestLightmapDistance = 0.0f;
+		for (GLuint candidate : positionVertices[position])
+		{
+			const Vertex& other = vertices[candidate];
+			float d = source.nx * other.nx + source.ny * other.ny + source.nz * other.nz;
+			float lightmapDistance = (source.lu - other.lu) * (source.lu - other.lu) + (source.lv - other.lv) * (source.lv - other.lv);
+			if (d > bestDot + 1e-4f || (d > bestDot - 1e-4f && lightmapDistance < bestLightmapDistance))
+			{
+				bestDot = d;
+				bestLightmapDistance = lightmapDistance;
+				best = candidate;
+			}
+		}
+		return best;
+	};
+
+	for (std::unordered_map<uint64_t, int>::const_iterator it = edgeUseCount.begin(); it != edgeUseCount.end(); ++it)
+	{
+		pushEdge(static_cast<int>(it->first >> 32), static_cast<int>(it->first & 0xffffffffu));
+	}
+
+	while (aliveTriangles > targetTriangleCount && !queue.empty())
+	{
+		EdgeCollapse collapse = queue.top();
+		queue.pop();
+
+		int a = collapse.keep;
+		int b = collapse.remove;
+		if (!positionAlive[a] || !positionAlive[b]
+			|| positionVersion[a] != collapse.keepVersion || positionVersion[b] != collapse.removeVersion)
+		{
+			continue;
+		}
+
+		if (collapse.cost > maxError)
+		{
+			break;
+		}
+
+		// Reject the collapse if any surviving triangle around the removed position would flip over
+		bool flips = false;
+		for (int t : adjacency[b])
+		{
+			const SimplifyTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			bool hasA = false;
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				int p = triangle.position[k];
+				hasA = hasA || p == a;
+				before[k] = positions[p];
+				after[k] = p == b ? collapse.target : positions[p];
+			}
+			if (hasA)
+			{
+				continue;
+			}
+
+			glm::vec3 oldNormal = TriangleNormal(before[0], before[1], before[2]);
+			glm::vec3 newNormal = TriangleNormal(after[0], after[1], after[2]);
+			float oldLength = glm::length(oldNormal);
+			float newLength = glm::length(newNormal);
+			if (newLength <= 1e-12f || glm::dot(oldNormal, newNormal) < MinNormalCosine * oldLength * newLength)
+			{
+				flips = true;
+				break;
+			}
+		}
+		if (flips)
+		{
+			continue;
+		}
+
+		// Collapse b into a
+		quadrics[a].Add(quadrics[b]);
+		positionAlive[b] = false;
+		positionVersion[a]++;
+
+		for (int t : adjacency[b])
+		{
+			SimplifyTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			bool hasA = triangle.position[0] == a || triangle.position[1] == a || triangle.position[2] == a;
+			if (hasA)
+			{
+				triangle.alive = false;
+				aliveTriangles--;
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				if (triangle.position[k] == b)
+				{
+					triangle.position[k] = a;
+					triangle.vertex[k] = matchVertex(triangle.vertex[k], a);
+				}
+			}
+			adjacency[a].push_back(t);
+		}
+		adjacency[b].clear();
+
+		// Drop dead triangles from a's list and queue the edges around a again with their new costs
+		std::vector<int> aliveAround;
+		std::vector<int> neighbours;
+		for (int t : adjacency[a])
+		{
+			if (!triangles[t].alive)
+			{
+				continue;
+			}
+			aliveAround.push_back(t);
+			for (int k = 0; k < 3; k++)
+			{
+				int p = triangles[t].position[k];
+				if (p != a && std::find(neighbours.begin(), neighbours.end(), p) == neighbours.end())
+				{
+					neighbours.push_back(p);
+				}
+			}
+		}
+		adjacency[a].swap(aliveAround);
+
+		for (int neighbour : neighbours)
+		{
+			pushEdge(a, neighbour);
+		}
+	}
+
+	// --- Emit the surviving triangles ---
+
+	std::unordered_map<GLuint, GLuint> outputLookup;
+	for (const SimplifyTriangle& triangle : triangles)
+	{
+		if (!triangle.alive)
+		{
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			std::unordered_map<GLuint, GLuint>::iterator found = outputLookup.find(triangle.vertex[k]);
+			if (found == outputLookup.end())
+			{
+				found = outputLookup.insert(std::make_pair(triangle.vertex[k], static_cast<GLuint>(outVertices.size()))).first;
+				outVertices.push_back(vertices[triangle.vertex[k]]);
+			}
+			outIndices.push_back(found->second);
+		}
+	}
+
+	return outIndices.size() / 3;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "Vertex.h"
+
+/// <summary>
+/// Simplifies an indexed triangle mesh with quadric error metric edge collapses (Garland and Heckbert).
+/// Edges are collapsed onto one of their endpoints, so the remaining vertices keep their original attributes.
+/// Vertices that share a position (but differ in UV or normal) are collapsed together, so hard edges and
+/// UV seams stay closed. Collapses that would flip a triangle, or whose error is above maxError, are rejected.
+/// </summary>
+/// <param name="vertices">Vertices of the source mesh</param>
+/// <param name="indices">Indices of the source mesh (three per triangle)</param>
+/// <param name="targetTriangleCount">Number of triangles to stop at</param>
+/// <param name="maxError">Largest quadric error (area-weighted squared distance in object space) a collapse may introduce</param>
+/// <param name="outVertices">Receives the vertices of the simplified mesh</param>
+/// <param name="outIndices">Receives the indices of the simplified mesh</param>
+/// <returns>Number of triangles in the simplified mesh</returns>
+size_t SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+	size_t targetTriangleCount, float maxError,
+	std::vector<Vertex>& outVertices, std::vector<GLuint>& outIndices);
@@ -0,0 +1,246 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Pyramid level whose texels an object rectangle may cover at most (per axis) when it is tested
+static const int MaxTestTexels = 4;
+
+void OcclusionCuller::Create(int width, int height)
+{
+	levels.clear();
+
+	while (true)
+	{
+		DepthLevel level;
+		level.width = width;
+		level.height = height;
+		level.depth.assign(static_cast<size_t>(width) * height, 1.0f);
+		levels.push_back(level);
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+		width = std::max(1, (width + 1) / 2);
+		height = std::max(1, (height + 1) / 2);
+	}
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(levels[0].depth.begin(), levels[0].depth.end(), 1.0f);
+	testedCount = 0;
+	culledCount = 0;
+}
+
+void OcclusionCuller::RasterizeOccluder(const MeshInfo& mesh, const glm::mat4& model)
+{
+	glm::mat4 modelViewProjection = viewProjection * model;
+
+	std::vector<glm::vec4> clip(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		clip[i] = modelViewProjection * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f);
+	}
+
+	float width = static_cast<float>(levels[0].width);
+	float height = static_cast<float>(levels[0].height);
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		// Clip the triangle against the near plane (z > -w), which can turn it into a quad
+		glm::vec4 polygon[4];
+		int count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const glm::vec4& current = clip[mesh.indices[i + k]];
+			const glm::vec4& next = clip[mesh.indices[i + (k + 1) % 3]];
+			float currentDistance = current.z + current.w;
+			float nextDistance = next.z + next.w;
+
+			if (currentDistance >= 0.0f)
+			{
+				polygon[count++] = current;
+			}
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				float t = currentDistance / (currentDistance - nextDistance);
+				polygon[count++] = current + (next - current) * t;
+			}
+		}
+
+		if (count < 3)
+		{
+			continue;
+		}
+
+		glm::vec3 screen[4];
+		for (int k = 0; k < count; k++)
+		{
+			glm::vec3 ndc = glm::vec3(polygon[k]) / polygon[k].w;
+			screen[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+		}
+
+		RasterizeTriangle(screen[0], screen[1], screen[2]);
+		if (count == 4)
+		{
+			RasterizeTriangle(screen[0], screen[2], screen[3]);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	DepthLevel& target = levels[0];
+
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (std::fabs(area) < 1e-8f)
+	{
+		return;
+	}
+
+	int minX = std::max(0, static_cast<int>(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+	int maxX = std::min(target.width - 1, static_cast<int>(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+	int minY = std::max(0, static_cast<int>(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+	int maxY = std::min(target.height - 1, static_cast<int>(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+
+	float inverseArea = 1.0f / area;
+
+	// The barycentric weights and the depth are linear over the screen, so their smallest and largest values over
+	// a texel are at its corners: the value at the center minus or plus half of the change along x and y
+	float w0StepX = -(c.y - b.y) * inverseArea;
+	float w0StepY = (c.x - b.x) * inverseArea;
+	float w1StepX = -(a.y - c.y) * inverseArea;
+	float w1StepY = (a.x - c.x) * inverseArea;
+	float w2StepX = -w0StepX - w1StepX;
+	float w2StepY = -w0StepY - w1StepY;
+	float w0Margin = 0.5f * (std::fabs(w0StepX) + std::fabs(w0StepY));
+	float w1Margin = 0.5f * (std::fabs(w1StepX) + std::fabs(w1StepY));
+	float w2Margin = 0.5f * (std::fabs(w2StepX) + std::fabs(w2StepY));
+	float zMargin = 0.5f * (std::fabs(w0StepX * a.z + w1StepX * b.z + w2StepX * c.z) + std::fabs(w0StepY * a.z + w1StepY * b.z + w2StepY * c.z));
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = minX; x <= maxX; x++)
+		{
+			float px = x + 0.5f;
+
+			// Barycentric weights from the edge functions; they all have the sign of the area inside the triangle.
+			// A texel that the triangle only partly covers must not occlude anything, so every corner has to be inside.
+			float w0 = ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x)) * inverseArea;
+			float w1 = ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x)) * inverseArea;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < w0Margin || w1 < w1Margin || w2 < w2Margin)
+			{
+				continue;
+			}
+
+			// Farthest depth of the triangle over the texel
+			float z = w0 * a.z + w1 * b.z + w2 * c.z + zMargin;
+			float& depth = target.depth[static_cast<size_t>(y) * target.width + x];
+			depth = std::min(depth, z);
+		}
+	}
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		const DepthLevel& source = levels[i - 1];
+		DepthLevel& target = levels[i];
+
+		for (int y = 0; y < target.height; y++)
+		{
+			int y0 = std::min(y * 2, source.height - 1);
+			int y1 = std::min(y * 2 + 1, source.height - 1);
+			for (int x = 0; x < target.width; x++)
+			{
+				int x0 = std::min(x * 2, source.width - 1);
+				int x1 = std::min(x * 2 + 1, source.width - 1);
+
+				// Keep the farthest depth, so that a texel only occludes what all of its children occlude
+				float farthest = std::max(
+					std::max(source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1]),
+					std::max(source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1]));
+				target.depth[y * target.width + x] = farthest;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model)
+{
+	testedCount++;
+
+	glm::mat4 modelViewProjection = viewProjection * model;
+	float width = static_cast<float>(levels[0].width);
+	float height = static_cast<float>(levels[0].height);
+
+	float minX = width, minY = height, maxX = 0.0f, maxY = 0.0f;
+	float nearestDepth = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+
+		// The box reaches behind the near plane, so it can't be tested reliably
+		if (clip.w <= 1e-5f || clip.z < -clip.w)
+		{
+			return true;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * width;
+		float y = (ndc.y * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Entirely outside of the screen
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+	{
+		culledCount++;
+		return false;
+	}
+
+	int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+	int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+	int x1 = std::min(levels[0].width - 1, static_cast<int>(std::floor(maxX)));
+	int y1 = std::min(levels[0].height - 1, static_cast<int>(std::floor(maxY)));
+
+	// Go up the pyramid until the rectangle only covers a handful of texels
+	size_t levelIndex = 0;
+	while ((x1 - x0 >= MaxTestTexels || y1 - y0 >= MaxTestTexels) && levelIndex + 1 < levels.size())
+	{
+		x0 /= 2;
+		y0 /= 2;
+		x1 /= 2;
+		y1 /= 2;
+		levelIndex++;
+	}
+
+	const DepthLevel& level = levels[levelIndex];
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (nearestDepth <= level.depth[y * level.width + x])
+			{
+				return true;
+			}
+		}
+	}
+
+	culledCount++;
+	return false;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshRegistry.h"
+
+/// <summary>
+/// Culls objects that are hidden behind large occluders (e.g., the walls of the room) before they are drawn.
+///
+/// Every frame, the occluders are rasterized on the CPU into a small depth buffer, which is then reduced
+/// into a hierarchical Z pyramid where every texel holds the farthest depth of the texels below it.
+/// An object is hidden if the nearest point of its bounding box is behind the farthest occluder depth
+/// of every pyramid texel that its screen-space rectangle touches. Hidden objects are never submitted,
+/// so they cost neither vertex nor fragment work.
+/// </summary>
+class OcclusionCuller
+{
+public:
+	/// <summary>
+	/// Allocates the depth buffer and its pyramid.
+	/// </summary>
+	/// <param name="width">Width of the occlusion depth buffer in pixels</param>
+	/// <param name="height">Height of the occlusion depth buffer in pixels</param>
+	void Create(int width, int height);
+
+	/// <summary>
+	/// Clears the depth buffer for a new camera.
+	/// </summary>
+	/// <param name="viewProjection">Projection matrix * view matrix of the camera</param>
+	void BeginFrame(const glm::mat4& viewProjection);
+
+	/// <summary>
+	/// Rasterizes the triangles of a mesh into the occlusion depth buffer.
+	/// </summary>
+	void RasterizeOccluder(const MeshInfo& mesh, const glm::mat4& model);
+
+	/// <summary>
+	/// Builds the hierarchical Z pyramid from the rasterized occluders. Call after the last occluder.
+	/// </summary>
+	void BuildHierarchy();
+
+	/// <summary>
+	/// Tests an object-space bounding box against the occluders.
+	/// </summary>
+	/// <returns>False if the box is completely hidden behind the occluders</returns>
+	bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model);
+
+	/// <returns>Number of objects tested since BeginFrame()</returns>
+	int GetTestedCount() const { return testedCount; }
+
+	/// <returns>Number of objects found hidden since BeginFrame()</returns>
+	int GetCulledCount() const { return culledCount; }
+
+private:
+	/// <summary>
+	/// Rasterizes one screen-space triangle (x and y in pixels, z as depth in [0, 1]) conservatively: only texels
+	/// that lie entirely inside the triangle are written, with the farthest depth of the triangle over the texel.
+	/// </summary>
+	void RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	/// <summary>
+	/// Size and depth values of one level of the pyramid.
+	/// </summary>
+	struct DepthLevel
+	{
+		int width;
+		int height;
+		std::vector<float> depth;
+	};
+
+	// Level 0 is the rasterized depth buffer, every following level is half the size of the previous one
+	std::vector<DepthLevel> levels;
+	glm::mat4 viewProjection;
+
+	int testedCount = 0;
+	int culledCount = 0;
+};
@@ -0,0 +1,320 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// How often the GPU clock offset is measured again, in nanoseconds
+static const long long GpuCalibrationInterval = 1000000000;
+
+/// <summary>
+/// Ring buffer of the events of one thread. Only the owning thread writes; the write count is published with
+/// release semantics so that the exporter sees complete events.
+/// </summary>
+struct ThreadTraceBuffer
+{
+	TraceEvent events[TraceEventsPerThread];
+	std::atomic<unsigned long long> writeCount;
+	int threadId;
+	const char* threadName;
+};
+
+/// <summary>
+/// All thread buffers ever created. Buffers are never freed before the program ends, so events of threads that
+/// have already exited can still be exported.
+/// </summary>
+struct TraceRegistry
+{
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+	ThreadTraceBuffer* gpuBuffer = nullptr;
+	long long captureStart = 0;
+};
+
+std::atomic<bool> Profiler::enabled(false);
+
+static thread_local ThreadTraceBuffer* threadBuffer = nullptr;
+
+static TraceRegistry& GetRegistry()
+{
+	static TraceRegistry registry;
+	return registry;
+}
+
+static ThreadTraceBuffer* CreateBuffer(const char* threadName)
+{
+	TraceRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	std::unique_ptr<ThreadTraceBuffer> buffer(new ThreadTraceBuffer());
+	buffer->writeCount.store(0, std::memory_order_relaxed);
+	buffer->threadId = static_cast<int>(registry.buffers.size()) + 1;
+	buffer->threadName = threadName;
+	registry.buffers.push_back(std::move(buffer));
+	return registry.buffers.back().get();
+}
+
+static ThreadTraceBuffer* GetThreadBuffer()
+{
+	if (threadBuffer == nullptr)
+	{
+		threadBuffer = CreateBuffer("Thread");
+	}
+	return threadBuffer;
+}
+
+static void WriteEvent(ThreadTraceBuffer* buffer, const char* name, long long start, long long end)
+{
+	unsigned long long index = buffer->writeCount.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[index % TraceEventsPerThread];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	buffer->writeCount.store(index + 1, std::memory_order_release);
+}
+
+/// <summary>
+/// Writes a string as a JSON string literal.
+/// </summary>
+static void WriteJsonString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			out << '\\' << *c;
+		}
+		else if (static_cast<unsigned char>(*c) < 0x20)
+		{
+			out << ' ';
+		}
+		else
+		{
+			out << *c;
+		}
+	}
+	out << '"';
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+	if (enabled && !IsEnabled())
+	{
+		// Events older than the capture are skipped when exporting, so no thread's buffer has to be touched
+		TraceRegistry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.captureStart = Now();
+	}
+	Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+long long Profiler::Now()
+{
+	static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer()->threadName = name;
+}
+
+void Profiler::RecordEvent(const char* name, long long start, long long end)
+{
+	WriteEvent(GetThreadBuffer(), name, start, end);
+}
+
+void Profiler::RecordGpuEvent(const char* name, long long start, long long end)
+{
+	TraceRegistry& registry = GetRegistry();
+	if (registry.gpuBuffer == nullptr)
+	{
+		registry.gpuBuffer = CreateBuffer("GPU");
+	}
+	WriteEvent(registry.gpuBuffer, name, start, end);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filePath)
+{
+	std::ofstream file(filePath);
+	if (file.fail())
+	{
+		std::cerr << "Unable to write trace file: " << filePath << std::endl;
+		return false;
+	}
+
+	TraceRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	// Chrome traces are in microseconds
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	size_t eventCount = 0;
+	for (const std::unique_ptr<ThreadTraceBuffer>& buffer : registry.buffers)
+	{
+		file << (first ? "\n" : ",\n");
+		first = false;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+		WriteJsonString(file, buffer->threadName);
+		file << "}}";
+
+		// Only the newest TraceEventsPerThread events are still in the ring
+		unsigned long long count = buffer->writeCount.load(std::memory_order_acquire);
+		unsigned long long begin = count > TraceEventsPerThread ? count - TraceEventsPerThread : 0;
+		for (unsigned long long i = begin; i < count; i++)
+		{
+			const TraceEvent& event = buffer->events[i % TraceEventsPerThread];
+			if (event.start < registry.captureStart)
+			{
+				continue;
+			}
+
+			file << ",\n{\"name\":";
+			WriteJsonString(file, event.name);
+			file << ",\"cat\":\"" << (buffer.get() == registry.gpuBuffer ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+				<< buffer->threadId << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+			eventCount++;
+		}
+	}
+	file << "\n]}\n";
+
+	std::cout << "Wrote " << eventCount << " trace events to " << filePath << std::endl;
+	return true;
+}
+
+// ---------------
+// GpuProfiler
+// ---------------
+
+void GpuProfiler::Create()
+{
+	for (Frame& frame : frames)
+	{
+		glGenQueries(MaxGpuZonesPerFrame * 2, frame.queries);
+		frame.zoneCount = 0;
+		frame.pending = false;
+	}
+	Calibrate();
+}
+
+void GpuProfiler::Destroy()
+{
+	for (Frame& frame : frames)
+	{
+		if (frame.queries[0] != 0)
+		{
+			glDeleteQueries(MaxGpuZonesPerFrame * 2, frame.queries);
+			std::fill(frame.queries, frame.queries + MaxGpuZonesPerFrame * 2, 0u);
+		}
+		frame.pending = false;
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	// Read back the frames that the GPU has finished, oldest first
+	for (int i = 0; i < GpuProfilerFrameCount; i++)
+	{
+		Frame& frame = frames[(frameIndex + i) % GpuProfilerFrameCount];
+		if (!frame.pending)
+		{
+			continue;
+		}
+
+		// Zones can be nested, so the last query issued isn't necessarily the last one in the array
+		bool available = true;
+		for (int zone = 0; zone < frame.zoneCount && available; zone++)
+		{
+			GLint endAvailable = GL_FALSE;
+			glGetQueryObjectiv(frame.queries[zone * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+			available = endAvailable == GL_TRUE;
+		}
+		if (!available)
+		{
+			continue;
+		}
+
+		for (int zone = 0; zone < frame.zoneCount; zone++)
+		{
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(frame.queries[zone * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(frame.queries[zone * 2 + 1], GL_QUERY_RESULT, &end);
+			Profiler::RecordGpuEvent(frame.names[zone], static_cast<long long>(start) + clockOffset,
+				static_cast<long long>(end) + clockOffset);
+		}
+		frame.pending = false;
+	}
+
+	if (Profiler::Now() - lastCalibration > GpuCalibrationInterval)
+	{
+		Calibrate();
+	}
+
+	// If the slot is still in flight, the GPU is more than GpuProfilerFrameCount frames behind; skip this frame
+	Frame& frame = frames[frameIndex];
+	recording = Profiler::IsEnabled() && !frame.pending && frame.queries[0] != 0;
+	frame.zoneCount = 0;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (recording && frames[frameIndex].zoneCount > 0)
+	{
+		// A zone that is still open would never become available; end it here
+		Frame& frame = frames[frameIndex];
+		for (int zone = 0; zone < frame.zoneCount; zone++)
+		{
+			if (!frame.ended[zone])
+			{
+				EndZone(zone);
+			}
+		}
+
+		frames[frameIndex].pending = true;
+		frameIndex = (frameIndex + 1) % GpuProfilerFrameCount;
+	}
+	recording = false;
+}
+
+int GpuProfiler::BeginZone(const char* name)
+{
+	Frame& frame = frames[frameIndex];
+	if (!recording || frame.zoneCount >= MaxGpuZonesPerFrame)
+	{
+		return -1;
+	}
+
+	int zone = frame.zoneCount++;
+	frame.names[zone] = name;
+	frame.ended[zone] = false;
+	glQueryCounter(frame.queries[zone * 2], GL_TIMESTAMP);
+	return zone;
+}
+
+void GpuProfiler::EndZone(int zone)
+{
+	if (zone < 0 || !recording || frames[frameIndex].ended[zone])
+	{
+		return;
+	}
+	glQueryCounter(frames[frameIndex].queries[zone * 2 + 1], GL_TIMESTAMP);
+	frames[frameIndex].ended[zone] = true;
+}
+
+void GpuProfiler::Calibrate()
+{
+	// GL_TIMESTAMP returns the GPU time once all previous commands have reached the GPU, without waiting for them
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	long long now = Profiler::Now();
+	clockOffset = now - static_cast<long long>(gpuTime);
+	lastCalibration = now;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <string>
+
+// Events kept per thread; older events are overwritten once a thread has recorded more
+const int TraceEventsPerThread = 65536;
+
+// Frames of GPU zones in flight; GPU timestamps are read back this many frames late so that reading never stalls
+const int GpuProfilerFrameCount = 4;
+
+// GPU zones recorded per frame at most
+const int MaxGpuZonesPerFrame = 32;
+
+/// <summary>
+/// A timed zone, in nanoseconds since the profiler was first used.
+/// </summary>
+struct TraceEvent
+{
+	const char* name;	// Must be a string that lives until the trace is written (e.g., a string literal)
+	long long start;
+	long long end;
+};
+
+/// <summary>
+/// Records timed zones of all threads and writes them as a Chrome trace (JSON), which can be opened in
+/// chrome://tracing or ui.perfetto.dev.
+///
+/// Every thread writes into its own ring buffer, which is only registered (under a mutex) the first time the
+/// thread records something; recording itself takes no lock. When profiling is disabled, a zone costs one
+/// relaxed atomic load.
+/// </summary>
+class Profiler
+{
+public:
+	/// <summary>
+	/// Starts or stops recording. Starting a new capture forgets the events of the previous one.
+	/// </summary>
+	static void SetEnabled(bool enabled);
+
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	/// <returns>Nanoseconds since the profiler was first used</returns>
+	static long long Now();
+
+	/// <summary>
+	/// Names the calling thread in the trace.
+	/// </summary>
+	/// <param name="name">Name of the thread (a string literal)</param>
+	static void SetThreadName(const char* name);
+
+	/// <summary>
+	/// Records a finished zone on the calling thread.
+	/// </summary>
+	static void RecordEvent(const char* name, long long start, long long end);
+
+	/// <summary>
+	/// Records a finished GPU zone on the GPU track. Only called from the thread that owns the GL context.
+	/// </summary>
+	static void RecordGpuEvent(const char* name, long long start, long long end);
+
+	/// <summary>
+	/// Writes all recorded events as a Chrome trace. Best called while recording is stopped.
+	/// </summary>
+	/// <param name="filePath">Path of the JSON file</param>
+	/// <returns>True if the file was written</returns>
+	static bool WriteChromeTrace(const std::string& filePath);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+/// <summary>
+/// Times the enclosing scope on the CPU.
+/// </summary>
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: name(name), start(Profiler::IsEnabled() ? Profiler::Now() : -1)
+	{
+	}
+
+	~ProfileScope()
+	{
+		if (start >= 0)
+		{
+			Profiler::RecordEvent(name, start, Profiler::Now());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope on the CPU
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+/// <summary>
+/// Times GPU work with GL_TIMESTAMP queries. The timestamps of a frame are read back GpuProfilerFrameCount - 1
+/// frames later and converted to the CPU clock, so that GPU zones line up with the CPU zones in the trace.
+/// </summary>
+class GpuProfiler
+{
+public:
+	/// <summary>
+	/// Creates the timestamp queries. Needs a current GL context.
+	/// </summary>
+	void Create();
+
+	/// <summary>
+	/// Deletes the timestamp queries.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Reads back the zones of finished frames and starts recording a new frame.
+	/// </summary>
+	void BeginFrame();
+
+	/// <summary>
+	/// Finishes the frame. Must be called once per BeginFrame().
+	/// </summary>
+	void EndFrame();
+
+	/// <summary>
+	/// Starts a zone in the current frame.
+	/// </summary>
+	/// <param name="name">Name of the zone (a string literal)</param>
+	/// <returns>Handle of the zone, or -1 if it isn't recorded</returns>
+	int BeginZone(const char* name);
+
+	/// <summary>
+	/// Ends a zone started with BeginZone().
+	/// </summary>
+	void EndZone(int zone);
+
+private:
+	/// <summary>
+	/// Measures the offset between the GPU timestamp clock and the profiler's clock.
+	/// </summary>
+	void Calibrate();
+
+	struct Frame
+	{
+		GLuint queries[MaxGpuZonesPerFrame * 2];
+		const char* names[MaxGpuZonesPerFrame];
+		bool ended[MaxGpuZonesPerFrame];
+		int zoneCount;
+		bool pending;
+	};
+
+	Frame frames[GpuProfilerFrameCount] = {};
+	int frameIndex = 0;
+	bool recording = false;
+
+	// GPU time + offset = profiler time, in nanoseconds
+	long long clockOffset = 0;
+	long long lastCalibration = 0;
+};
+
+/// <summary>
+/// Times the enclosing scope on the GPU, and on the CPU under the same name. End() finishes the zone early, which
+/// allows timing consecutive passes of one function without adding a scope around each.
+/// </summary>
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, const char* name)
+		: profiler(profiler), name(name), start(Profiler::IsEnabled() ? Profiler::Now() : -1), zone(profiler.BeginZone(name))
+	{
+	}
+
+	~GpuProfileScope()
+	{
+		End();
+	}
+
+	void End()
+	{
+		profiler.EndZone(zone);
+		zone = -1;
+		if (start >= 0)
+		{
+			Profiler::RecordEvent(name, start, Profiler::Now());
+			start = -1;
+		}
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& profiler;
+	const char* name;
+	long long start;
+	int zone;
+};
+
+// Times the rest of the enclosing scope on the GPU and on the CPU
+#define PROFILE_GPU_ZONE(profiler, name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, name)
@@ -0,0 +1,470 @@
+#include "Regression.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define MakeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MakeDirectory(path) mkdir(path, 0755)
+#endif
+
+// Centers of the stress scenes; far enough from the room and from each other that no case sees another scene
+static const glm::vec3 CrateFieldCenter(100.0f, 0.0f, 0.0f);
+static const glm::vec3 ChairRowsCenter(200.0f, 0.0f, 0.0f);
+static const glm::vec3 DynamicCratesCenter(300.0f, 0.0f, 0.0f);
+
+// Largest YIQ distance between two colors with 8-bit channels
+static const float MaxColorDistance = 35215.0f;
+
+/// <summary>
+/// Small deterministic random number generator (xorshift), so that the stress scenes are the same in every run.
+/// </summary>
+struct StressRandom
+{
+	unsigned int state;
+
+	/// <returns>A number between min and max</returns>
+	float Next(float min, float max)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return min + (max - min) * static_cast<float>(state & 0xFFFFFF) / static_cast<float>(0xFFFFFF);
+	}
+};
+
+/// <summary>
+/// Squared perceptual distance of two colors in YIQ space, weighted like the pixelmatch library.
+/// </summary>
+static float ColorDistance(const unsigned char* a, const unsigned char* b)
+{
+	float r = static_cast<float>(a[0] - b[0]);
+	float g = static_cast<float>(a[1] - b[1]);
+	float blue = static_cast<float>(a[2] - b[2]);
+	float y = r * 0.29889531f + g * 0.58662247f + blue * 0.11448223f;
+	float i = r * 0.59597799f - g * 0.27417610f - blue * 0.32180189f;
+	float q = r * 0.21147017f - g * 0.52261711f + blue * 0.31114694f;
+	return 0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q;
+}
+
+/// <returns>The median of the values (0 if there are none)</returns>
+static double Median(std::vector<double> values)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+bool RegressionSuite::Create(const std::vector<RegressionCase>& cases, const std::string& goldenDirectory, bool updateGolden, int width, int height)
+{
+	this->cases = cases;
+	this->goldenDirectory = goldenDirectory;
+	this->updateGolden = updateGolden;
+	this->width = width;
+	this->height = height;
+	current = 0;
+	frame = 0;
+	frameTimes.clear();
+	caseStats = {};
+	budgets.clear();
+	failedCases = 0;
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Regression: the framebuffer is not complete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + ", OpenGL "
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	std::cout << "Regression: rendering " << cases.size() << " cases with " << renderer << std::endl;
+	if (renderer.find("llvmpipe") == std::string::npos)
+	{
+		std::cerr << "Regression: not running on llvmpipe, the images may differ slightly from golden images recorded with it" << std::endl;
+	}
+
+	if (updateGolden)
+	{
+		return true;
+	}
+
+	// Lines of "name drawCalls stateChanges cpuMilliseconds"; the renderer and the driver are noted in comments.
+	// Without them there is nothing to check against, so the run fails as a whole instead of case by case.
+	std::ifstream file(goldenDirectory + "/budgets.txt");
+	if (!file)
+	{
+		std::cerr << "Regression: no golden files in " << goldenDirectory << "/. Record them with --update-golden on the "
+			<< "reference configuration (Mesa's llvmpipe) and check them in." << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const std::string rendererComment = "# renderer: ";
+		if (line.compare(0, rendererComment.size(), rendererComment) == 0)
+		{
+			goldenRenderer = line.substr(rendererComment.size());
+			continue;
+		}
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream stream(line);
+		std::string name;
+		RegressionBudget budget;
+		if (stream >> name >> budget.drawCalls >> budget.stateChanges >> budget.cpuMilliseconds)
+		{
+			budgets[name] = budget;
+		}
+	}
+
+	if (!goldenRenderer.empty() && goldenRenderer != renderer)
+	{
+		std::cerr << "Regression: the golden files were recorded with " << goldenRenderer << ", the CPU times may not compare" << std::endl;
+	}
+	return true;
+}
+
+void RegressionSuite::Destroy()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	framebuffer = 0;
+	colorBuffer = 0;
+}
+
+void RegressionSuite::EndFrame(const FrameStats& stats, double cpuMilliseconds)
+{
+	if (IsFinished())
+	{
+		return;
+	}
+
+	frame++;
+	if (frame <= RegressionWarmupFrames)
+	{
+		return;
+	}
+
+	frameTimes.push_back(cpuMilliseconds);
+	caseStats.drawCalls = std::max(caseStats.drawCalls, stats.drawCalls);
+	caseStats.stateChanges = std::max(caseStats.stateChanges, stats.stateChanges);
+	if (frame < RegressionWarmupFrames + RegressionMeasuredFrames)
+	{
+		return;
+	}
+
+	FinishCase();
+	current++;
+	frame = 0;
+	frameTimes.clear();
+	caseStats = {};
+}
+
+void RegressionSuite::FinishCase()
+{
+	const RegressionCase& test = cases[current];
+	double cpuMilliseconds = Median(frameTimes);
+
+	// The frame ended in the suite's framebuffer
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	std::vector<unsigned char> pixels(pixelCount * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		pixels[i * 4 + 3] = 255;
+	}
+
+	// Buffers start with the bottom row, image files with the top row
+	stbi_flip_vertically_on_write(1);
+	std::string goldenPath = goldenDirectory + "/" + test.name + ".png";
+
+	if (updateGolden)
+	{
+		MakeDirectory(goldenDirectory.c_str());
+		if (stbi_write_png(goldenPath.c_str(), width, height, 4, pixels.data(), width * 4) == 0)
+		{
+			std::cerr << "Regression: failed to write " << goldenPath << std::endl;
+			failedCases++;
+		}
+		budgets[test.name] = { caseStats.drawCalls, caseStats.stateChanges, cpuMilliseconds };
+		std::cout << "Regression: recorded " << test.name << ": " << caseStats.drawCalls << " draw calls, "
+			<< caseStats.stateChanges << " state changes, " << cpuMilliseconds << " ms" << std::endl;
+		return;
+	}
+
+	std::vector<std::string> failures;
+
+	stbi_set_flip_vertically_on_load(true);
+	int goldenWidth, goldenHeight, channels;
+	unsigned char* data = stbi_load(goldenPath.c_str(), &goldenWidth, &goldenHeight, &channels, 4);
+	double differentShare = 1.0;
+	if (data == nullptr)
+	{
+		failures.push_back("no golden image " + goldenPath);
+	}
+	else if (goldenWidth != width || goldenHeight != height)
+	{
+		failures.push_back("the golden image is " + std::to_string(goldenWidth) + "x" + std::to_string(goldenHeight)
+			+ ", the frame " + std::to_string(width) + "x" + std::to_string(height));
+	}
+	else
+	{
+		std::vector<unsigned char> golden(data, data + pixelCount * 4);
+		std::vector<unsigned char> difference;
+		differentShare = CompareImages(pixels, golden, width, height, difference);
+		if (differentShare > RegressionMaxDifferentPixels)
+		{
+			std::ostringstream message;
+			message << differentShare * 100.0 << "% of the pixels differ (allowed: " << RegressionMaxDifferentPixels * 100.0 << "%)";
+			failures.push_back(message.str());
+			stbi_write_png(("regression_" + test.name + "_diff.png").c_str(), width, height, 4, difference.data(), width * 4);
+		}
+	}
+	stbi_image_free(data);
+
+	auto budget = budgets.find(test.name);
+	if (budget == budgets.end())
+	{
+		failures.push_back("no budget recorded");
+	}
+	else
+	{
+		std::ostringstream message;
+		if (caseStats.drawCalls > budget->second.drawCalls * (1.0 + RegressionCountTolerance))
+		{
+			message << caseStats.drawCalls << " draw calls (budget: " << budget->second.drawCalls << ")";
+			failures.push_back(message.str());
+			message.str("");
+		}
+		if (caseStats.stateChanges > budget->second.stateChanges * (1.0 + RegressionCountTolerance))
+		{
+			message << caseStats.stateChanges << " state changes (budget: " << budget->second.stateChanges << ")";
+			failures.push_back(message.str());
+			message.str("");
+		}
+		if (cpuMilliseconds > budget->second.cpuMilliseconds * (1.0 + RegressionTimeTolerance) + RegressionTimeSlack)
+		{
+			message << cpuMilliseconds << " ms of CPU time (budget: " << budget->second.cpuMilliseconds << " ms)";
+			failures.push_back(message.str());
+		}
+	}
+
+	if (failures.empty())
+	{
+		std::cout << "Regression: passed " << test.name << ": " << differentShare * 100.0 << "% of the pixels differ, "
+			<< caseStats.drawCalls << " draw calls, " << caseStats.stateChanges << " state changes, " << cpuMilliseconds << " ms" << std::endl;
+		return;
+	}
+
+	failedCases++;
+	std::cout << "Regression: FAILED " << test.name << ":";
+	for (size_t i = 0; i < failures.size(); i++)
+	{
+		std::cout << (i == 0 ? " " : ", ") << failures[i];
+	}
+	std::cout << std::endl;
+	stbi_write_png(("regression_" + test.name + ".png").c_str(), width, height, 4, pixels.data(), width * 4);
+}
+
+bool RegressionSuite::Finish()
+{
+	if (updateGolden)
+	{
+		std::string path = goldenDirectory + "/budgets.txt";
+		std::ofstream file(path);
+		file << "# name drawCalls stateChanges cpuMilliseconds" << std::endl;
+		file << "# renderer: " << renderer << std::endl;
+		file << "# driver: " << driver << std::endl;
+		for (const RegressionCase& test : cases)
+		{
+			auto budget = budgets.find(test.name);
+			if (budget != budgets.end())
+			{
+				file << test.name << " " << budget->second.drawCalls << " " << budget->second.stateChanges << " "
+					<< budget->second.cpuMilliseconds << std::endl;
+			}
+		}
+		if (!file)
+		{
+			std::cerr << "Regression: failed to write " << path << std::endl;
+			return false;
+		}
+		std::cout << "Regression: recorded " << cases.size() << " golden images and budgets in " << goldenDirectory << std::endl;
+		return failedCases == 0;
+	}
+
+	std::cout << "Regression: " << cases.size() - failedCases << " of " << cases.size() << " cases passed" << std::endl;
+	return failedCases == 0;
+}
+
+double RegressionSuite::CompareImages(const std::vector<unsigned char>& pixels, const std::vector<unsigned char>& golden,
+	int width, int height, std::vector<unsigned char>& difference)
+{
+	float threshold = MaxColorDistance * RegressionPixelThreshold * RegressionPixelThreshold;
+	difference.assign(static_cast<size_t>(width) * height * 4, 255);
+
+	size_t differentPixels = 0;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			size_t i = static_cast<size_t>(y) * width + x;
+			const unsigned char* pixel = &pixels[i * 4];
+
+			// A pixel matches if the golden image has a close enough color at its position or right next to it
+			float closest = ColorDistance(pixel, &golden[i * 4]);
+			for (int dy = -1; dy <= 1 && closest > threshold; dy++)
+			{
+				for (int dx = -1; dx <= 1 && closest > threshold; dx++)
+				{
+					int nx = x + dx;
+					int ny = y + dy;
+					if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+					{
+						size_t neighbour = static_cast<size_t>(ny) * width + nx;
+						closest = std::min(closest, ColorDistance(pixel, &golden[neighbour * 4]));
+					}
+				}
+			}
+
+			bool different = closest > threshold;
+			differentPixels += different ? 1 : 0;
+
+			// Differing pixels in red, the rest as a faded gray image of the frame
+			unsigned char gray = static_cast<unsigned char>(128 + (pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) / 512);
+			difference[i * 4 + 0] = different ? 255 : gray;
+			difference[i * 4 + 1] = different ? 0 : gray;
+			difference[i * 4 + 2] = different ? 0 : gray;
+		}
+	}
+	return static_cast<double>(differentPixels) / (static_cast<size_t>(width) * height);
+}
+
+void UseSoftwareRasterizer()
+{
+	const char* variables[][2] = { { "LIBGL_ALWAYS_SOFTWARE", "1" }, { "GALLIUM_DRIVER", "llvmpipe" } };
+	for (const auto& variable : variables)
+	{
+		if (std::getenv(variable[0]) != nullptr)
+		{
+			continue;
+		}
+#if defined(_WIN32)
+		_putenv_s(variable[0], variable[1]);
+#else
+		setenv(variable[0], variable[1], 0);
+#endif
+	}
+}
+
+void AddStressScenes(std::vector<SceneObject>& objects, const SceneObject& crate, const std::vector<SceneObject>& chair)
+{
+	StressRandom random = { 0x2545F491u };
+
+	// Static crates in a 16x16 field: many small objects that static batching merges
+	for (int z = 0; z < 16; z++)
+	{
+		for (int x = 0; x < 16; x++)
+		{
+			SceneObject object = crate;
+			object.name = "Stress crate " + std::to_string(z * 16 + x);
+			float scale = random.Next(0.3f, 0.6f);
+			glm::vec3 position = CrateFieldCenter + glm::vec3((x - 7.5f) * 1.5f, scale, (z - 7.5f) * 1.5f);
+			object.model = glm::translate(glm::mat4(1.0f), position);
+			object.model = glm::rotate(object.model, glm::radians(random.Next(0.0f, 90.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
+			object.model = glm::scale(object.model, glm::vec3(scale));
+			object.isStatic = true;
+			object.isOccluder = false;
+			object.collidable = false;
+			objects.push_back(object);
+		}
+	}
+
+	// Rows of static chairs: objects made of several meshes
+	glm::vec3 chairOrigin(0.0f);
+	for (const SceneObject& part : chair)
+	{
+		chairOrigin += glm::vec3(part.model[3]) / static_cast<float>(chair.size());
+	}
+	for (int row = 0; row < 8; row++)
+	{
+		for (int seat = 0; seat < 8; seat++)
+		{
+			glm::vec3 position = ChairRowsCenter + glm::vec3((seat - 3.5f) * 2.0f, 0.0f, (row - 3.5f) * 2.5f);
+			glm::mat4 placement = glm::translate(glm::mat4(1.0f), position - chairOrigin);
+			for (const SceneObject& part : chair)
+			{
+				SceneObject object = part;
+				object.name = "Stress chair " + std::to_string(row * 8 + seat) + " " + part.name;
+				object.model = placement * part.model;
+				object.isStatic = true;
+				object.isOccluder = false;
+				object.collidable = false;
+				objects.push_back(object);
+			}
+		}
+	}
+
+	// Crates that are not static in a 20x20 grid: every one is culled and drawn on its own
+	for (int z = 0; z < 20; z++)
+	{
+		for (int x = 0; x < 20; x++)
+		{
+			SceneObject object = crate;
+			object.name = "Stress dynamic crate " + std::to_string(z * 20 + x);
+			glm::vec3 position = DynamicCratesCenter + glm::vec3((x - 9.5f) * 1.0f, random.Next(0.2f, 1.5f), (z - 9.5f) * 1.0f);
+			object.model = glm::translate(glm::mat4(1.0f), position);
+			object.model = glm::rotate(object.model, glm::radians(random.Next(0.0f, 360.0f)), glm::normalize(glm::vec3(random.Next(-1.0f, 1.0f), 1.0f, random.Next(-1.0f, 1.0f))));
+			object.model = glm::scale(object.model, glm::vec3(0.3f));
+			object.isStatic = false;
+			object.isOccluder = false;
+			object.collidable = false;
+			objects.push_back(object);
+		}
+	}
+}
+
+std::vector<RegressionCase> GetRegressionCases()
+{
+	std::vector<RegressionCase> cases;
+	cases.push_back({ "room_start", glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), false });
+	cases.push_back({ "room_corner", glm::vec3(3.5f, 0.5f, 3.5f), glm::vec3(-2.0f, -2.0f, -3.0f), false });
+	cases.push_back({ "room_deferred", glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), true });
+	cases.push_back({ "crate_field", CrateFieldCenter + glm::vec3(0.0f, 6.0f, 16.0f), CrateFieldCenter, false });
+	cases.push_back({ "chair_rows", ChairRowsCenter + glm::vec3(4.0f, 4.0f, 14.0f), ChairRowsCenter, false });
+	cases.push_back({ "dynamic_crates", DynamicCratesCenter + glm::vec3(0.0f, 5.0f, 14.0f), DynamicCratesCenter, true });
+	return cases;
+}
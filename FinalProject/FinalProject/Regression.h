@@ -0,0 +1,167 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "RenderStats.h"
+#include "Scene.h"
+
+// Frames rendered before a case is measured, so that detail levels and texture streaming settle
+const int RegressionWarmupFrames = 5;
+
+// Frames measured per case; the median CPU frame time is compared against the budget
+const int RegressionMeasuredFrames = 20;
+
+// A pixel differs if its perceptual (YIQ) color distance to every pixel around the same position in the golden
+// image is above this share of the largest possible distance; looking at the neighbours tolerates edges that
+// moved by one pixel
+const float RegressionPixelThreshold = 0.1f;
+
+// A case fails if more than this share of its pixels differ
+const double RegressionMaxDifferentPixels = 0.005;
+
+// A case fails if its draw calls or state changes exceed the recorded budget by more than this share
+const double RegressionCountTolerance = 0.05;
+
+// A case fails if its CPU frame time exceeds the recorded budget by more than this share plus the slack (in
+// milliseconds); frame times are noisy, especially next to a software rasterizer
+const double RegressionTimeTolerance = 0.25;
+const double RegressionTimeSlack = 0.5;
+
+/// <summary>
+/// One view that the regression suite renders and checks.
+/// </summary>
+struct RegressionCase
+{
+	std::string name;
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraTarget;
+	bool deferredShading;
+};
+
+/// <summary>
+/// Draw calls, state changes and CPU frame time that a case may use, recorded with --update-golden.
+/// </summary>
+struct RegressionBudget
+{
+	long long drawCalls;
+	long long stateChanges;
+	double cpuMilliseconds;
+};
+
+/// <summary>
+/// Renders a list of views and checks them against golden images and performance budgets, so that changes to
+/// the renderer can't silently change the image or make frames more expensive.
+///
+/// Every case is rendered for a few warm-up frames and then measured; its last frame is read back and compared
+/// with golden/&lt;case&gt;.png with a perceptual tolerance, and its draw calls, state changes and median CPU frame
+/// time are compared with golden/budgets.txt. Failed cases write their image and a difference image into the
+/// working directory. In update mode, the images and budgets are recorded instead.
+///
+/// The golden images are meant to be recorded with Mesa's llvmpipe rasterizer (see UseSoftwareRasterizer()),
+/// which gives the same image on every machine; hardware drivers differ in small details. budgets.txt notes the
+/// renderer and the driver version they were recorded with. Without golden files, the suite fails right away.
+/// </summary>
+class RegressionSuite
+{
+public:
+	/// <summary>
+	/// Loads the budgets and creates the framebuffer that the frames are rendered into. Needs a current GL context.
+	/// </summary>
+	/// <param name="cases">Views to render, in order</param>
+	/// <param name="goldenDirectory">Directory of the golden images and budgets.txt</param>
+	/// <param name="updateGolden">Record new golden images and budgets instead of checking them</param>
+	/// <param name="width">Width of the frames</param>
+	/// <param name="height">Height of the frames</param>
+	/// <returns>False if the golden files to check against don't exist</returns>
+	bool Create(const std::vector<RegressionCase>& cases, const std::string& goldenDirectory, bool updateGolden, int width, int height);
+
+	/// <summary>
+	/// Deletes the framebuffer.
+	/// </summary>
+	void Destroy();
+
+	/// <returns>Framebuffer that the frames must end in instead of the window's; the pixels of a hidden window are
+	/// undefined, since they fail the pixel ownership test</returns>
+	GLuint GetFramebuffer() const { return framebuffer; }
+
+	/// <returns>True once every case was rendered</returns>
+	bool IsFinished() const { return current >= cases.size(); }
+
+	/// <returns>The case that the next frame renders</returns>
+	const RegressionCase& GetCurrentCase() const { return cases[current]; }
+
+	/// <summary>
+	/// Records a rendered frame of the current case. After the last frame of a case, reads the frame back from
+	/// the suite's framebuffer, checks or records it, and moves to the next case.
+	/// </summary>
+	/// <param name="stats">Draw calls and state changes of the frame</param>
+	/// <param name="cpuMilliseconds">CPU time of the frame, without waiting for the GPU</param>
+	void EndFrame(const FrameStats& stats, double cpuMilliseconds);
+
+	/// <summary>
+	/// Prints the summary and, in update mode, writes the budgets.
+	/// </summary>
+	/// <returns>True if every case passed (or everything was recorded)</returns>
+	bool Finish();
+
+private:
+	/// <summary>
+	/// Checks or records the frame and the measurements of the current case.
+	/// </summary>
+	void FinishCase();
+
+	/// <summary>
+	/// Compares a frame with its golden image and writes a difference image.
+	/// </summary>
+	/// <param name="pixels">RGBA pixels of the frame, bottom row first</param>
+	/// <param name="golden">RGBA pixels of the golden image, bottom row first</param>
+	/// <param name="difference">Receives the difference image: differing pixels in red, the rest in gray</param>
+	/// <returns>Share of the pixels that differ</returns>
+	static double CompareImages(const std::vector<unsigned char>& pixels, const std::vector<unsigned char>& golden,
+		int width, int height, std::vector<unsigned char>& difference);
+
+	std::vector<RegressionCase> cases;
+	std::string goldenDirectory;
+	bool updateGolden = false;
+	std::string renderer;				// GL_RENDERER of this run
+	std::string goldenRenderer;			// GL_RENDERER that the budgets were recorded with
+	std::string driver;					// GL_VENDOR and GL_VERSION of this run, recorded with the budgets
+
+	GLuint framebuffer = 0;				// Offscreen framebuffer with an RGBA8 color renderbuffer
+	GLuint colorBuffer = 0;
+	int width = 0;
+	int height = 0;
+
+	size_t current = 0;
+	int frame = 0;						// Frame of the current case
+	std::vector<double> frameTimes;		// CPU times of the measured frames of the current case
+	FrameStats caseStats = {};			// Largest counts of the measured frames of the current case
+
+	std::map<std::string, RegressionBudget> budgets;
+	int failedCases = 0;
+};
+
+/// <summary>
+/// Makes Mesa use its llvmpipe software rasterizer, unless the environment already picks a driver. Must be called
+/// before the GL context is created. Has no effect with other GL implementations.
+/// </summary>
+void UseSoftwareRasterizer();
+
+/// <summary>
+/// Adds the generated stress scenes to the scene: a field of static crates, rows of static chairs and a grid of
+/// crates that are not static (so that they are neither batched nor lightmapped). The scenes are placed far from
+/// the room and from each other, so that every case only sees its own scene.
+/// </summary>
+/// <param name="objects">Scene objects that receive the copies</param>
+/// <param name="crate">Object whose mesh and material the crates use</param>
+/// <param name="chair">Objects that make up one chair, copied as a whole</param>
+void AddStressScenes(std::vector<SceneObject>& objects, const SceneObject& crate, const std::vector<SceneObject>& chair);
+
+/// <returns>The views of the suite: the room from several places and with both shading paths, and every stress scene</returns>
+std::vector<RegressionCase> GetRegressionCases();
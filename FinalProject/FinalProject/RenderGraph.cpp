@@ -0,0 +1,491 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "RenderStats.h"
+
+void RenderGraph::Destroy()
+{
+	for (const CachedFramebuffer& cached : framebuffers)
+	{
+		glDeleteFramebuffers(1, &cached.framebuffer);
+	}
+	for (const PooledTexture& pooled : pool)
+	{
+		glDeleteTextures(1, &pooled.texture);
+	}
+	framebuffers.clear();
+	pool.clear();
+	resources.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+	backbufferWidth = 0;
+	backbufferHeight = 0;
+}
+
+void RenderGraph::BeginFrame()
+{
+	frame++;
+	resources.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+
+	// Nothing refers to the pool by index between the frames, so unused textures can be removed here
+	ReleaseTextures([this](const PooledTexture& pooled) { return frame - pooled.lastUsedFrame > RenderGraphUnusedFrames; });
+}
+
+RenderResource RenderGraph::CreateTarget(const char* name, const RenderTargetDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = false;
+	resource.firstPass = -1;
+	resource.lastPass = -1;
+	resource.texture = -1;
+	resources.push_back(resource);
+	return static_cast<RenderResource>(resources.size()) - 1;
+}
+
+RenderResource RenderGraph::ImportBackbuffer(int width, int height, GLuint framebuffer)
+{
+	// Targets of the window's old size won't be asked for again. Free them right away instead of after
+	// RenderGraphUnusedFrames, or dragging the window's border would keep a set of textures for every size it passed.
+	if (backbufferWidth != 0 && (width != backbufferWidth || height != backbufferHeight))
+	{
+		int oldWidth = backbufferWidth;
+		int oldHeight = backbufferHeight;
+		ReleaseTextures([=](const PooledTexture& pooled) { return pooled.desc.width == oldWidth && pooled.desc.height == oldHeight; });
+	}
+	backbufferWidth = width;
+	backbufferHeight = height;
+
+	RenderResource backbuffer = CreateTarget("Backbuffer", { width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_NEAREST, GL_CLAMP_TO_EDGE });
+	resources[backbuffer].imported = true;
+	resources[backbuffer].framebuffer = framebuffer;
+	return backbuffer;
+}
+
+int RenderGraph::AddPass(const char* name, const RenderPassExecute& execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.alive = false;
+	passes.push_back(pass);
+	return static_cast<int>(passes.size()) - 1;
+}
+
+void RenderGraph::Read(int pass, RenderResource resource)
+{
+	passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::Write(int pass, RenderResource resource)
+{
+	passes[pass].writes.push_back(resource);
+}
+
+bool RenderGraph::Compile()
+{
+	PROFILE_ZONE("Compile render graph");
+	size_t passCount = passes.size();
+
+	// A pass depends on every pass that writes a target it reads, and on the earlier passes that write a target
+	// it writes too (it adds to their result)
+	std::vector<std::vector<int>> dependencies(passCount);
+	for (size_t i = 0; i < passCount; i++)
+	{
+		for (size_t writer = 0; writer < passCount; writer++)
+		{
+			if (writer == i)
+			{
+				continue;
+			}
+			const std::vector<RenderResource>& written = passes[writer].writes;
+			bool readsResult = std::any_of(passes[i].reads.begin(), passes[i].reads.end(),
+				[&](RenderResource resource) { return std::find(written.begin(), written.end(), resource) != written.end(); });
+			bool addsToResult = writer < i && std::any_of(passes[i].writes.begin(), passes[i].writes.end(),
+				[&](RenderResource resource) { return std::find(written.begin(), written.end(), resource) != written.end(); });
+			if (readsResult || addsToResult)
+			{
+				dependencies[i].push_back(static_cast<int>(writer));
+			}
+		}
+	}
+
+	// Culling: the passes that write to the window run, and so does everything they depend on
+	std::vector<int> pending;
+	for (size_t i = 0; i < passCount; i++)
+	{
+		passes[i].alive = std::any_of(passes[i].writes.begin(), passes[i].writes.end(),
+			[&](RenderResource resource) { return resources[resource].imported; });
+		if (passes[i].alive)
+		{
+			pending.push_back(static_cast<int>(i));
+		}
+	}
+	while (!pending.empty())
+	{
+		int pass = pending.back();
+		pending.pop_back();
+		for (int dependency : dependencies[pass])
+		{
+			if (!passes[dependency].alive)
+			{
+				passes[dependency].alive = true;
+				pending.push_back(dependency);
+			}
+		}
+	}
+
+	// Order the passes that run; among the passes that are ready, the one declared first goes first
+	std::vector<bool> scheduled(passCount, false);
+	order.clear();
+	bool progress = true;
+	while (progress)
+	{
+		progress = false;
+		for (size_t i = 0; i < passCount; i++)
+		{
+			if (!passes[i].alive || scheduled[i]
+				|| !std::all_of(dependencies[i].begin(), dependencies[i].end(), [&](int dependency) { return scheduled[dependency]; }))
+			{
+				continue;
+			}
+			scheduled[i] = true;
+			order.push_back(static_cast<int>(i));
+			progress = true;
+			break;
+		}
+	}
+	for (size_t i = 0; i < passCount; i++)
+	{
+		if (passes[i].alive && !scheduled[i])
+		{
+			std::cerr << "Render graph: the pass " << passes[i].name << " depends on itself through the passes it reads from" << std::endl;
+			order.clear();
+			return false;
+		}
+	}
+
+	// Lifetime of every target: from the first to the last pass that uses it
+	for (size_t position = 0; position < order.size(); position++)
+	{
+		const Pass& pass = passes[order[position]];
+		for (const std::vector<RenderResource>* used : { &pass.reads, &pass.writes })
+		{
+			for (RenderResource resource : *used)
+			{
+				Resource& target = resources[resource];
+				if (target.firstPass < 0)
+				{
+					target.firstPass = static_cast<int>(position);
+				}
+				target.lastPass = static_cast<int>(position);
+			}
+		}
+	}
+
+	// Give the targets their textures in execution order, and hand a texture back to the pool after the last pass
+	// that uses its target, so that a later target with the same description can take it over
+	for (PooledTexture& pooled : pool)
+	{
+		pooled.inUse = false;
+	}
+	for (int position = 0; position < static_cast<int>(order.size()); position++)
+	{
+		for (Resource& target : resources)
+		{
+			if (!target.imported && target.firstPass == position)
+			{
+				target.texture = AcquireTexture(target.desc);
+			}
+		}
+		for (const Resource& target : resources)
+		{
+			if (!target.imported && target.lastPass == position)
+			{
+				pool[target.texture].inUse = false;
+			}
+		}
+	}
+
+	compiled = true;
+	return true;
+}
+
+void RenderGraph::Execute(GpuProfiler& gpuProfiler)
+{
+	if (!compiled)
+	{
+		return;
+	}
+
+	for (int index : order)
+	{
+		const Pass& pass = passes[index];
+		GpuProfileScope passZone(gpuProfiler, pass.name);
+
+		// Color targets in the order they were written, and the depth target
+		std::vector<GLuint> colors;
+		GLuint depth = 0;
+		bool toBackbuffer = false;
+		GLuint backbufferFramebuffer = 0;
+		int width = 0;
+		int height = 0;
+		for (RenderResource resource : pass.writes)
+		{
+			const Resource& target = resources[resource];
+			width = target.desc.width;
+			height = target.desc.height;
+			if (target.imported)
+			{
+				toBackbuffer = true;
+				backbufferFramebuffer = target.framebuffer;
+			}
+			else if (IsDepthFormat(target.desc.internalFormat))
+			{
+				depth = pool[target.texture].texture;
+			}
+			else
+			{
+				colors.push_back(pool[target.texture].texture);
+			}
+		}
+
+		if (!pass.writes.empty())
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, toBackbuffer ? backbufferFramebuffer : GetFramebuffer(colors, depth));
+			glViewport(0, 0, width, height);
+			RenderStats::CountStateChange();
+		}
+		pass.execute(*this);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint RenderGraph::GetTexture(RenderResource resource) const
+{
+	const Resource& target = resources[resource];
+	return target.texture >= 0 ? pool[target.texture].texture : 0;
+}
+
+GLuint RenderGraph::GetReadFramebuffer(RenderResource resource) const
+{
+	const Resource& target = resources[resource];
+	if (target.imported)
+	{
+		return target.framebuffer;
+	}
+
+	GLuint texture = GetTexture(resource);
+	if (IsDepthFormat(target.desc.internalFormat))
+	{
+		return GetFramebuffer({}, texture);
+	}
+	return GetFramebuffer({ texture }, 0);
+}
+
+size_t RenderGraph::GetMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (const PooledTexture& pooled : pool)
+	{
+		bytes += static_cast<size_t>(pooled.desc.width) * pooled.desc.height * GetBytesPerPixel(pooled.desc.internalFormat);
+	}
+	return bytes;
+}
+
+void RenderGraph::PrintStats() const
+{
+	const double megabyte = 1024.0 * 1024.0;
+
+	// Memory that the targets of the frame would take with a texture each
+	size_t unsharedBytes = 0;
+	size_t targetCount = 0;
+	for (const Resource& target : resources)
+	{
+		if (!target.imported && target.texture >= 0)
+		{
+			unsharedBytes += static_cast<size_t>(target.desc.width) * target.desc.height * GetBytesPerPixel(target.desc.internalFormat);
+			targetCount++;
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Render graph: " << order.size() << " of " << passes.size() << " passes run, " << targetCount << " targets in "
+		<< pool.size() << " pooled textures, " << GetMemoryUsage() / megabyte << " MB (" << unsharedBytes / megabyte
+		<< " MB with a texture per target)" << std::endl;
+
+	for (size_t position = 0; position < order.size(); position++)
+	{
+		std::cout << "  " << position << ": " << passes[order[position]].name << std::endl;
+	}
+	for (const Pass& pass : passes)
+	{
+		if (!pass.alive)
+		{
+			std::cout << "  culled: " << pass.name << std::endl;
+		}
+	}
+	for (const Resource& target : resources)
+	{
+		if (target.imported || target.texture < 0)
+		{
+			continue;
+		}
+		std::cout << "  " << target.name << ": " << target.desc.width << "x" << target.desc.height << ", passes "
+			<< target.firstPass << "-" << target.lastPass << ", texture " << target.texture << std::endl;
+	}
+	std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+int RenderGraph::AcquireTexture(const RenderTargetDesc& desc)
+{
+	for (size_t i = 0; i < pool.size(); i++)
+	{
+		if (!pool[i].inUse && pool[i].desc == desc)
+		{
+			pool[i].inUse = true;
+			pool[i].lastUsedFrame = frame;
+			return static_cast<int>(i);
+		}
+	}
+
+	PooledTexture pooled;
+	pooled.desc = desc;
+	pooled.inUse = true;
+	pooled.lastUsedFrame = frame;
+	glGenTextures(1, &pooled.texture);
+	glBindTexture(GL_TEXTURE_2D, pooled.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pool.push_back(pooled);
+	return static_cast<int>(pool.size()) - 1;
+}
+
+GLuint RenderGraph::GetFramebuffer(const std::vector<GLuint>& colors, GLuint depth) const
+{
+	for (CachedFramebuffer& cached : framebuffers)
+	{
+		if (cached.colors == colors && cached.depth == depth)
+		{
+			cached.lastUsedFrame = frame;
+			return cached.framebuffer;
+		}
+	}
+
+	// Creating the framebuffer must not change the one that the current pass renders into
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	CachedFramebuffer cached;
+	cached.colors = colors;
+	cached.depth = depth;
+	cached.lastUsedFrame = frame;
+	glGenFramebuffers(1, &cached.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+
+	std::vector<GLenum> drawBuffers;
+	for (size_t i = 0; i < colors.size(); i++)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), GL_TEXTURE_2D, colors[i], 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+	}
+	if (depth != 0)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	}
+	if (drawBuffers.empty())
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Error! Render graph framebuffer not complete!" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+
+	framebuffers.push_back(cached);
+	return cached.framebuffer;
+}
+
+void RenderGraph::ReleaseTextures(const std::function<bool(const PooledTexture&)>& release)
+{
+	// Framebuffers go first, since they may refer to the textures
+	std::vector<GLuint> released;
+	for (const PooledTexture& pooled : pool)
+	{
+		if (release(pooled))
+		{
+			released.push_back(pooled.texture);
+		}
+	}
+
+	auto isReleased = [&](GLuint texture) { return std::find(released.begin(), released.end(), texture) != released.end(); };
+	auto framebufferEnd = std::remove_if(framebuffers.begin(), framebuffers.end(), [&](const CachedFramebuffer& cached)
+	{
+		bool unused = frame - cached.lastUsedFrame > RenderGraphUnusedFrames || isReleased(cached.depth)
+			|| std::any_of(cached.colors.begin(), cached.colors.end(), isReleased);
+		if (unused)
+		{
+			glDeleteFramebuffers(1, &cached.framebuffer);
+		}
+		return unused;
+	});
+	framebuffers.erase(framebufferEnd, framebuffers.end());
+
+	auto poolEnd = std::remove_if(pool.begin(), pool.end(), [&](const PooledTexture& pooled)
+	{
+		if (isReleased(pooled.texture))
+		{
+			glDeleteTextures(1, &pooled.texture);
+			return true;
+		}
+		return false;
+	});
+	pool.erase(poolEnd, pool.end());
+}
+
+bool RenderGraph::IsDepthFormat(GLenum internalFormat)
+{
+	return internalFormat == GL_DEPTH_COMPONENT || internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24
+		|| internalFormat == GL_DEPTH_COMPONENT32F;
+}
+
+size_t RenderGraph::GetBytesPerPixel(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGBA16F:
+	case GL_RG32F:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		// GL_RGBA8, GL_RG16, GL_R32F, the 24 and 32 bit depth formats
+		return 4;
+	}
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "Profiler.h"
+
+// Frames that a pooled texture may stay unused before it is deleted; switching between the shading paths back and
+// forth within this time doesn't reallocate anything
+const int RenderGraphUnusedFrames = 120;
+
+// Handle of a resource of the current frame's graph
+typedef int RenderResource;
+
+/// <summary>
+/// Size and format of a render target. Targets with equal descriptions can share one texture.
+/// </summary>
+struct RenderTargetDesc
+{
+	int width;
+	int height;
+	GLenum internalFormat;		// GL_RGBA8, GL_DEPTH_COMPONENT24, ...
+	GLenum format;				// Pixel format and type that match the internal format
+	GLenum type;
+	GLint filter;				// Minification and magnification filter
+	GLint wrap;					// Wrap mode along both axes
+
+	bool operator==(const RenderTargetDesc& other) const
+	{
+		return width == other.width && height == other.height && internalFormat == other.internalFormat && format == other.format
+			&& type == other.type && filter == other.filter && wrap == other.wrap;
+	}
+};
+
+class RenderGraph;
+
+// Records the GL commands of a pass; the graph has bound the pass's framebuffer and set the viewport to its size
+typedef std::function<void(const RenderGraph& graph)> RenderPassExecute;
+
+/// <summary>
+/// Declarative description of the passes of a frame.
+///
+/// Every frame, the passes are declared with the render targets they read and write, then Compile() works out
+/// what actually has to run: passes whose results no other pass reads (and that don't write to the window) are
+/// culled, and the rest are ordered so that every pass runs after the passes that write what it reads. Passes
+/// may be declared in any order; passes that write the same target keep their declaration order.
+///
+/// The targets are transient: they only live from the first to the last pass that uses them. Their textures
+/// come from a pool that persists over the frames, and targets with the same description whose lifetimes don't
+/// overlap are given the same texture. A pass that only needs a target for a moment therefore doesn't add to the
+/// render-target memory, and targets of passes that are culled or no longer declared (like the G-buffer in forward
+/// shading) are freed after a while. Textures of the window's size are freed as soon as the window is resized.
+/// Framebuffers are cached per set of attached textures.
+/// </summary>
+class RenderGraph
+{
+public:
+	/// <summary>
+	/// Deletes the pooled textures and the cached framebuffers.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Forgets the passes and targets of the last frame, so that the new frame can be declared.
+	/// </summary>
+	void BeginFrame();
+
+	/// <summary>
+	/// Declares a transient render target. Its contents are undefined until a pass writes them.
+	/// </summary>
+	/// <param name="name">Name for the statistics (a string literal)</param>
+	RenderResource CreateTarget(const char* name, const RenderTargetDesc& desc);
+
+	/// <summary>
+	/// Declares the framebuffer that the frame ends in: the window's default framebuffer, or an offscreen framebuffer
+	/// of the caller. A pass that writes it always runs. When the size changed since the last frame, the pooled
+	/// textures of the old size are deleted.
+	/// </summary>
+	RenderResource ImportBackbuffer(int width, int height, GLuint framebuffer = 0);
+
+	/// <summary>
+	/// Declares a pass. Its reads and writes are declared with Read() and Write().
+	/// </summary>
+	/// <param name="name">Name of the pass, also used for its profiler zones (a string literal)</param>
+	/// <returns>Handle of the pass</returns>
+	int AddPass(const char* name, const RenderPassExecute& execute);
+
+	/// <summary>
+	/// Declares that a pass samples or blits from a target.
+	/// </summary>
+	void Read(int pass, RenderResource resource);
+
+	/// <summary>
+	/// Declares that a pass renders into a target. Color targets are attached in the order they are written,
+	/// a depth target is attached as the depth buffer. All targets of a pass must have the same size.
+	/// </summary>
+	void Write(int pass, RenderResource resource);
+
+	/// <summary>
+	/// Culls and orders the passes and gives every target that is used a texture.
+	/// </summary>
+	/// <returns>False if the passes depend on each other in a cycle</returns>
+	bool Compile();
+
+	/// <summary>
+	/// Runs the passes that were not culled, in order, each in a CPU and GPU profiler zone.
+	/// </summary>
+	void Execute(GpuProfiler& gpuProfiler);
+
+	/// <returns>Texture of a target, valid while the passes are executed</returns>
+	GLuint GetTexture(RenderResource resource) const;
+
+	/// <returns>Framebuffer with only the target attached (as color or depth), for blits from it; the imported
+	/// framebuffer for the backbuffer</returns>
+	GLuint GetReadFramebuffer(RenderResource resource) const;
+
+	/// <returns>Size of a target</returns>
+	const RenderTargetDesc& GetDesc(RenderResource resource) const { return resources[resource].desc; }
+
+	/// <returns>GPU memory of the pooled textures in bytes</returns>
+	size_t GetMemoryUsage() const;
+
+	/// <summary>
+	/// Prints the passes of the last compiled frame and how the targets were placed in the pooled textures.
+	/// </summary>
+	void PrintStats() const;
+
+private:
+	struct Resource
+	{
+		const char* name;
+		RenderTargetDesc desc;
+		bool imported;					// The backbuffer; not allocated from the pool
+		GLuint framebuffer;				// Framebuffer of the backbuffer (0 for the window's)
+		int firstPass;					// Position in the execution order of the first and last pass that use it
+		int lastPass;
+		int texture;					// Index into the pool, or -1
+	};
+
+	struct Pass
+	{
+		const char* name;
+		RenderPassExecute execute;
+		std::vector<RenderResource> reads;
+		std::vector<RenderResource> writes;
+		bool alive;						// Not culled
+	};
+
+	struct PooledTexture
+	{
+		RenderTargetDesc desc;
+		GLuint texture;
+		bool inUse;						// Holds a target whose lifetime hasn't ended yet at the current pass
+		int lastUsedFrame;
+	};
+
+	struct CachedFramebuffer
+	{
+		std::vector<GLuint> colors;
+		GLuint depth;
+		GLuint framebuffer;
+		int lastUsedFrame;
+	};
+
+	/// <summary>
+	/// Takes a free pooled texture with the description, or creates one.
+	/// </summary>
+	/// <returns>Index into the pool</returns>
+	int AcquireTexture(const RenderTargetDesc& desc);
+
+	/// <summary>
+	/// Returns the framebuffer with the given attachments, creating it if needed.
+	/// </summary>
+	GLuint GetFramebuffer(const std::vector<GLuint>& colors, GLuint depth) const;
+
+	/// <summary>
+	/// Deletes the pooled textures that the condition selects, the framebuffers that refer to them, and the
+	/// framebuffers that weren't used for a while.
+	/// </summary>
+	void ReleaseTextures(const std::function<bool(const PooledTexture&)>& release);
+
+	/// <returns>True for the depth formats</returns>
+	static bool IsDepthFormat(GLenum internalFormat);
+
+	/// <returns>Bytes per pixel of a texture with the internal format</returns>
+	static size_t GetBytesPerPixel(GLenum internalFormat);
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<int> order;				// Passes that run, in execution order
+
+	std::vector<PooledTexture> pool;
+	mutable std::vector<CachedFramebuffer> framebuffers;
+	int frame = 0;
+	bool compiled = false;
+	int backbufferWidth = 0;			// Size of the last imported backbuffer
+	int backbufferHeight = 0;
+};
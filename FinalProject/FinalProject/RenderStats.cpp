@@ -0,0 +1,10 @@
+#include "RenderStats.h"
+
+FrameStats RenderStats::current = {};
+
+FrameStats RenderStats::EndFrame()
+{
+	FrameStats stats = current;
+	current = {};
+	return stats;
+}
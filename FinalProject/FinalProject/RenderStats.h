@@ -0,0 +1,32 @@
+#pragma once
+
+/// <summary>
+/// GL commands issued during one frame.
+/// </summary>
+struct FrameStats
+{
+	long long drawCalls;
+	long long stateChanges;		// Program, framebuffer, vertex array and texture bindings, and per-draw uniform updates
+};
+
+/// <summary>
+/// Counts the GL commands whose CPU cost grows with the scene: draw calls and state changes. The render code counts
+/// at the places where it issues them, so the counts are exact without wrapping every GL function. Only the thread
+/// that owns the GL context counts.
+/// </summary>
+class RenderStats
+{
+public:
+	static void CountDrawCall() { current.drawCalls++; }
+
+	/// <param name="count">Number of bindings or uniform updates</param>
+	static void CountStateChange(int count = 1) { current.stateChanges += count; }
+
+	/// <summary>
+	/// Returns the counts of the frame and starts counting the next one.
+	/// </summary>
+	static FrameStats EndFrame();
+
+private:
+	static FrameStats current;
+};
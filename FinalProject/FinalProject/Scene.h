@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "Lod.h"
+
+/// <summary>
+/// An object placed in the scene: which mesh to draw and where to draw it.
+/// </summary>
+struct SceneObject
+{
+	std::string name;
+	MeshLods mesh;				// Detail levels of the object's mesh
+	glm::mat4 model;			// Model matrix (object space -> world space)
+	int material;				// Index of the object's material in the material library
+	bool castsShadow;			// Whether the object is drawn in the shadow map pass
+	bool isOccluder;			// Whether the object hides other objects during occlusion culling
+	bool collidable;			// Whether the camera is blocked by the object
+	bool isStatic;				// Whether the object never moves, so it can be merged into a static batch
+	int lod[LodPassCount];		// Detail level picked in the previous frame, per pass
+	Aabb bounds;				// World-space bounding box, kept in sync with the scene BVH
+	bool isBatched;				// Whether the object is drawn as part of a static batch instead of on its own
+	bool lightmapped;			// Whether the object's mesh has lightmap UVs and its lighting is baked into the lightmap
+};
+
+/// <summary>
+/// One draw of a pass, after culling and detail level selection. The GL passes and the software renderer
+/// consume the same lists of draws.
+/// </summary>
+struct DrawCommand
+{
+	MeshHandle mesh;			// Mesh of the selected detail level
+	glm::mat4 model;			// Model matrix (object space -> world space)
+	int material;				// Index of the material in the material library
+	bool lightmapped;			// Whether the lighting comes from the lightmap instead of the lights and the shadow map
+};
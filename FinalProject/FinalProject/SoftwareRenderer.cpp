@@ -0,0 +1,775 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Lightmap.h"
+#include "Profiler.h"
+
+// SSE2 is part of every x64 CPU (and of 32-bit builds that target it); other targets use the scalar fallback
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOFTWARE_RENDERER_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Triangles are clipped against x and y at this multiple of the viewport, instead of at the viewport itself;
+// the rasterizer only visits pixels inside the viewport anyway, and most triangles don't need clipping this way
+static const float GuardBand = 2.0f;
+
+// Vertex positions are snapped to 1/256 of a pixel, like the subpixel precision of GPUs
+static const float SubpixelSteps = 256.0f;
+
+// Most vertices a triangle can have after clipping against 6 planes
+static const int MaxClippedVertices = 9;
+
+// ---------------
+// SIMD helpers
+// ---------------
+
+/// <summary>
+/// Four floats, one per pixel of a horizontal run of 4 pixels.
+/// </summary>
+struct Float4
+{
+#if SOFTWARE_RENDERER_SSE
+	__m128 v;
+#else
+	float v[4];
+#endif
+};
+
+/// <summary>
+/// One flag per pixel of a run of 4 pixels.
+/// </summary>
+struct Mask4
+{
+#if SOFTWARE_RENDERER_SSE
+	__m128 v;
+#else
+	bool v[4];
+#endif
+};
+
+#if SOFTWARE_RENDERER_SSE
+
+static inline Float4 Splat(float value) { Float4 r; r.v = _mm_set1_ps(value); return r; }
+static inline Float4 Ramp() { Float4 r; r.v = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); return r; }
+static inline Float4 Load(const float* source) { Float4 r; r.v = _mm_loadu_ps(source); return r; }
+static inline Float4 operator+(Float4 a, Float4 b) { Float4 r; r.v = _mm_add_ps(a.v, b.v); return r; }
+static inline Float4 operator*(Float4 a, Float4 b) { Float4 r; r.v = _mm_mul_ps(a.v, b.v); return r; }
+static inline Mask4 operator<(Float4 a, Float4 b) { Mask4 r; r.v = _mm_cmplt_ps(a.v, b.v); return r; }
+static inline Mask4 operator<=(Float4 a, Float4 b) { Mask4 r; r.v = _mm_cmple_ps(a.v, b.v); return r; }
+static inline Mask4 operator&(Mask4 a, Mask4 b) { Mask4 r; r.v = _mm_and_ps(a.v, b.v); return r; }
+static inline bool Any(Mask4 mask) { return _mm_movemask_ps(mask.v) != 0; }
+
+static inline void StoreMasked(float* destination, Float4 value, Mask4 mask)
+{
+	__m128 old = _mm_loadu_ps(destination);
+	_mm_storeu_ps(destination, _mm_or_ps(_mm_and_ps(mask.v, value.v), _mm_andnot_ps(mask.v, old)));
+}
+
+static inline void StoreMasked(int* destination, int value, Mask4 mask)
+{
+	__m128i selected = _mm_castps_si128(mask.v);
+	__m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination));
+	__m128i result = _mm_or_si128(_mm_and_si128(selected, _mm_set1_epi32(value)), _mm_andnot_si128(selected, old));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(destination), result);
+}
+
+#else
+
+static inline Float4 Splat(float value) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = value; return r; }
+static inline Float4 Ramp() { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = static_cast<float>(i); return r; }
+static inline Float4 Load(const float* source) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = source[i]; return r; }
+static inline Float4 operator+(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+static inline Float4 operator*(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+static inline Mask4 operator<(Float4 a, Float4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] < b.v[i]; return r; }
+static inline Mask4 operator<=(Float4 a, Float4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] <= b.v[i]; return r; }
+static inline Mask4 operator&(Mask4 a, Mask4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] && b.v[i]; return r; }
+static inline bool Any(Mask4 mask) { return mask.v[0] || mask.v[1] || mask.v[2] || mask.v[3]; }
+
+static inline void StoreMasked(float* destination, Float4 value, Mask4 mask)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (mask.v[i])
+		{
+			destination[i] = value.v[i];
+		}
+	}
+}
+
+static inline void StoreMasked(int* destination, int value, Mask4 mask)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (mask.v[i])
+		{
+			destination[i] = value;
+		}
+	}
+}
+
+#endif
+
+/// <summary>
+/// Which of 4 pixels are inside an edge. Pixels exactly on the edge only count for top-left edges, so pixels on an edge
+/// shared by two triangles are drawn exactly once.
+/// </summary>
+static inline Mask4 InsideEdge(Float4 edge, bool topLeft)
+{
+	return topLeft ? Splat(0.0f) <= edge : Splat(0.0f) < edge;
+}
+
+// ---------------
+// Sampling
+// ---------------
+
+/// <summary>
+/// Samples an RGBA8 texture with bilinear filtering and repeat wrapping, like the texture array in main.fsh.
+/// </summary>
+static glm::vec4 SampleTexture(const unsigned char* pixels, int width, int height, float u, float v)
+{
+	float x = u * width - 0.5f;
+	float y = v * height - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fractionX = x - floorX;
+	float fractionY = y - floorY;
+
+	int x0 = static_cast<int>(floorX) % width;
+	int y0 = static_cast<int>(floorY) % height;
+	x0 = x0 < 0 ? x0 + width : x0;
+	y0 = y0 < 0 ? y0 + height : y0;
+	int x1 = x0 + 1 == width ? 0 : x0 + 1;
+	int y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+	const unsigned char* p00 = pixels + (static_cast<size_t>(y0) * width + x0) * 4;
+	const unsigned char* p10 = pixels + (static_cast<size_t>(y0) * width + x1) * 4;
+	const unsigned char* p01 = pixels + (static_cast<size_t>(y1) * width + x0) * 4;
+	const unsigned char* p11 = pixels + (static_cast<size_t>(y1) * width + x1) * 4;
+
+	glm::vec4 result;
+	for (int i = 0; i < 4; i++)
+	{
+		float bottom = p00[i] + (p10[i] - p00[i]) * fractionX;
+		float top = p01[i] + (p11[i] - p01[i]) * fractionX;
+		result[i] = (bottom + (top - bottom) * fractionY) / 255.0f;
+	}
+	return result;
+}
+
+/// <summary>
+/// Samples a texture layer of the material library with trilinear filtering, like GL_LINEAR_MIPMAP_LINEAR. Only the
+/// levels that are resident on the GPU are used, so the result follows texture streaming like the GL image does.
+/// </summary>
+/// <param name="lod">Level of detail computed from the UV derivatives (log2 of the texels per pixel at level 0)</param>
+static glm::vec3 SampleMaterialTexture(const MaterialLibrary& materials, int layer, float u, float v, float lod)
+{
+	float maxLevel = static_cast<float>(materials.GetMaxLevel());
+	float level = std::min(std::max(lod, static_cast<float>(materials.GetBaseLevel())), maxLevel);
+	int detailed = static_cast<int>(level);
+	float fraction = level - detailed;
+
+	int width = std::max(materials.GetLayerWidth() >> detailed, 1);
+	int height = std::max(materials.GetLayerHeight() >> detailed, 1);
+	glm::vec3 color = glm::vec3(SampleTexture(materials.GetLayerPixels(layer, detailed), width, height, u, v));
+	if (fraction > 0.0f)
+	{
+		// Blend with the next, coarser level
+		glm::vec3 coarser = glm::vec3(SampleTexture(materials.GetLayerPixels(layer, detailed + 1), std::max(width >> 1, 1), std::max(height >> 1, 1), u, v));
+		color = color + (coarser - color) * fraction;
+	}
+	return color;
+}
+
+/// <summary>
+/// Samples a depth buffer with bilinear filtering and repeat wrapping, like the shadow map in main.fsh.
+/// </summary>
+static float SampleDepth(const float* depth, int width, int height, int stride, float u, float v)
+{
+	float x = u * width - 0.5f;
+	float y = v * height - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fractionX = x - floorX;
+	float fractionY = y - floorY;
+
+	int x0 = static_cast<int>(floorX) % width;
+	int y0 = static_cast<int>(floorY) % height;
+	x0 = x0 < 0 ? x0 + width : x0;
+	y0 = y0 < 0 ? y0 + height : y0;
+	int x1 = x0 + 1 == width ? 0 : x0 + 1;
+	int y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+	float d00 = depth[static_cast<size_t>(y0) * stride + x0];
+	float d10 = depth[static_cast<size_t>(y0) * stride + x1];
+	float d01 = depth[static_cast<size_t>(y1) * stride + x0];
+	float d11 = depth[static_cast<size_t>(y1) * stride + x1];
+	float bottom = d00 + (d10 - d00) * fractionX;
+	float top = d01 + (d11 - d01) * fractionX;
+	return bottom + (top - bottom) * fractionY;
+}
+
+// ---------------
+// SoftwareRenderer
+// ---------------
+
+void SoftwareRenderer::Create(int width, int height, int shadowMapSize, int threadCount)
+{
+	pool.Create(threadCount);
+	ResizeTarget(shadow, shadowMapSize, shadowMapSize);
+	Resize(width, height);
+}
+
+void SoftwareRenderer::Destroy()
+{
+	pool.Destroy();
+
+	if (presentFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &presentFramebuffer);
+		presentFramebuffer = 0;
+	}
+	if (presentTexture != 0)
+	{
+		glDeleteTextures(1, &presentTexture);
+		presentTexture = 0;
+	}
+	presentWidth = 0;
+	presentHeight = 0;
+}
+
+void SoftwareRenderer::Resize(int width, int height)
+{
+	if (width == this->width && height == this->height)
+	{
+		return;
+	}
+
+	this->width = width;
+	this->height = height;
+	ResizeTarget(scene, width, height);
+	sceneTriangleIds.assign(scene.depth.size(), -1);
+	color.assign(static_cast<size_t>(width) * height * 4, 0);
+}
+
+void SoftwareRenderer::ResizeTarget(Target& target, int width, int height)
+{
+	target.width = width;
+	target.height = height;
+	target.tilesX = (width + SoftwareTileSize - 1) / SoftwareTileSize;
+	target.tilesY = (height + SoftwareTileSize - 1) / SoftwareTileSize;
+	target.stride = target.tilesX * SoftwareTileSize;
+	target.depth.assign(static_cast<size_t>(target.stride) * target.tilesY * SoftwareTileSize, 1.0f);
+}
+
+void SoftwareRenderer::RenderShadowMap(const MeshRegistry& meshes, const std::vector<DrawCommand>& draws, const glm::mat4& lightViewProjection)
+{
+	PROFILE_ZONE("Software shadow pass");
+
+	BinTriangles(meshes, draws, lightViewProjection, shadow, false);
+
+	PROFILE_ZONE("Rasterize shadow tiles");
+	pool.ParallelFor(shadow.tilesX * shadow.tilesY, [this](int tile)
+	{
+		RasterizeTile(shadow, tile, nullptr);
+	});
+}
+
+void SoftwareRenderer::RenderScene(const MeshRegistry& meshes, const MaterialLibrary& materials, const std::vector<DrawCommand>& draws,
+	const glm::mat4& viewProjection, const SoftwareLighting& lighting)
+{
+	PROFILE_ZONE("Software scene pass");
+
+	this->materials = &materials;
+	this->lighting = lighting;
+	BinTriangles(meshes, draws, viewProjection, scene, true);
+
+	PROFILE_ZONE("Rasterize and shade tiles");
+	pool.ParallelFor(scene.tilesX * scene.tilesY, [this](int tile)
+	{
+		RasterizeTile(scene, tile, sceneTriangleIds.data());
+		ShadeTile(tile);
+	});
+}
+
+void SoftwareRenderer::Present(int windowWidth, int windowHeight)
+{
+	PROFILE_ZONE("Software present");
+
+	if (presentTexture == 0)
+	{
+		glGenTextures(1, &presentTexture);
+		glGenFramebuffers(1, &presentFramebuffer);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, presentTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (width != presentWidth || height != presentHeight)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, presentFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, presentTexture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		presentWidth = width;
+		presentHeight = height;
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SoftwareRenderer::BinTriangles(const MeshRegistry& meshes, const std::vector<DrawCommand>& draws, const glm::mat4& viewProjection,
+	const Target& target, bool withAttributes)
+{
+	PROFILE_ZONE("Set up and bin triangles");
+
+	// Vertex stage and triangle setup, in parallel over the draws
+	if (drawTriangles.size() < draws.size())
+	{
+		drawTriangles.resize(draws.size());
+	}
+	pool.ParallelFor(static_cast<int>(draws.size()), [&](int drawIndex)
+	{
+		const DrawCommand& draw = draws[drawIndex];
+		std::vector<Triangle>& output = drawTriangles[drawIndex];
+		output.clear();
+		if (!meshes.IsValid(draw.mesh))
+		{
+			return;
+		}
+
+		const MeshInfo& mesh = meshes.Get(draw.mesh);
+		glm::mat4 modelViewProjection = viewProjection * draw.model;
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(draw.model)));
+		glm::mat4 lightModelViewProjection = lighting.lightViewProjection * draw.model;
+
+		static thread_local std::vector<ClipVertex> vertices;
+		vertices.resize(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			const Vertex& source = mesh.vertices[i];
+			glm::vec4 position(source.x, source.y, source.z, 1.0f);
+			ClipVertex& vertex = vertices[i];
+			vertex.position = modelViewProjection * position;
+			if (withAttributes)
+			{
+				// Same outputs as main.vsh
+				glm::vec3 worldPosition = glm::vec3(draw.model * position);
+				glm::vec3 normal = normalMatrix * glm::vec3(source.nx, source.ny, source.nz);
+				glm::vec4 lightPosition = lightModelViewProjection * position;
+				for (int j = 0; j < 3; j++)
+				{
+					vertex.attributes[j] = worldPosition[j];
+					vertex.attributes[3 + j] = normal[j];
+				}
+				vertex.attributes[6] = source.u;
+				vertex.attributes[7] = source.v;
+				for (int j = 0; j < 4; j++)
+				{
+					vertex.attributes[8 + j] = lightPosition[j];
+				}
+				vertex.attributes[12] = source.lu;
+				vertex.attributes[13] = source.lv;
+			}
+		}
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			ClipTriangle(vertices[mesh.indices[i]], vertices[mesh.indices[i + 1]], vertices[mesh.indices[i + 2]],
+				target, withAttributes, draw.material, output);
+		}
+		for (Triangle& triangle : output)
+		{
+			triangle.lightmapped = draw.lightmapped;
+		}
+	});
+
+	// Merge in submission order and bin; a triangle goes into every tile its bounding box overlaps
+	triangles.clear();
+	bins.resize(static_cast<size_t>(target.tilesX) * target.tilesY);
+	for (std::vector<int>& bin : bins)
+	{
+		bin.clear();
+	}
+
+	for (size_t drawIndex = 0; drawIndex < draws.size(); drawIndex++)
+	{
+		for (const Triangle& triangle : drawTriangles[drawIndex])
+		{
+			int index = static_cast<int>(triangles.size());
+			triangles.push_back(triangle);
+
+			int firstTileX = triangle.minX / SoftwareTileSize;
+			int lastTileX = triangle.maxX / SoftwareTileSize;
+			int firstTileY = triangle.minY / SoftwareTileSize;
+			int lastTileY = triangle.maxY / SoftwareTileSize;
+			for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+			{
+				for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+				{
+					bins[tileY * target.tilesX + tileX].push_back(index);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::ClipTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Target& target,
+	bool withAttributes, int material, std::vector<Triangle>& output)
+{
+	// Signed distance of a vertex to each clip plane; inside is positive
+	const int planeCount = 6;
+	auto distance = [](const ClipVertex& vertex, int plane)
+	{
+		const glm::vec4& p = vertex.position;
+		switch (plane)
+		{
+		case 0: return p.w + p.z;					// Near
+		case 1: return p.w - p.z;					// Far
+		case 2: return GuardBand * p.w + p.x;		// Left
+		case 3: return GuardBand * p.w - p.x;		// Right
+		case 4: return GuardBand * p.w + p.y;		// Bottom
+		default: return GuardBand * p.w - p.y;		// Top
+		}
+	};
+
+	// Most triangles are entirely inside or entirely outside one plane
+	int outsideAll = 0x3F;
+	int outsideAny = 0;
+	const ClipVertex* corners[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		int outside = 0;
+		for (int plane = 0; plane < planeCount; plane++)
+		{
+			outside |= distance(*corners[i], plane) < 0.0f ? 1 << plane : 0;
+		}
+		outsideAll &= outside;
+		outsideAny |= outside;
+	}
+	if (outsideAll != 0)
+	{
+		return;
+	}
+	if (outsideAny == 0)
+	{
+		SetupTriangle(a, b, c, target, withAttributes, material, output);
+		return;
+	}
+
+	// Sutherland-Hodgman against the planes that are crossed
+	ClipVertex buffers[2][MaxClippedVertices];
+	int counts[2] = { 3, 0 };
+	buffers[0][0] = a;
+	buffers[0][1] = b;
+	buffers[0][2] = c;
+	int current = 0;
+	int attributeCount = withAttributes ? SoftwareAttributeCount : 0;
+
+	for (int plane = 0; plane < planeCount; plane++)
+	{
+		if ((outsideAny & (1 << plane)) == 0)
+		{
+			continue;
+		}
+
+		const ClipVertex* input = buffers[current];
+		ClipVertex* clipped = buffers[1 - current];
+		int inputCount = counts[current];
+		int clippedCount = 0;
+		for (int i = 0; i < inputCount; i++)
+		{
+			const ClipVertex& from = input[i];
+			const ClipVertex& to = input[(i + 1) % inputCount];
+			float fromDistance = distance(from, plane);
+			float toDistance = distance(to, plane);
+
+			if (fromDistance >= 0.0f)
+			{
+				clipped[clippedCount++] = from;
+			}
+			if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+			{
+				float t = fromDistance / (fromDistance - toDistance);
+				ClipVertex& vertex = clipped[clippedCount++];
+				vertex.position = from.position + (to.position - from.position) * t;
+				for (int j = 0; j < attributeCount; j++)
+				{
+					vertex.attributes[j] = from.attributes[j] + (to.attributes[j] - from.attributes[j]) * t;
+				}
+			}
+		}
+
+		counts[1 - current] = clippedCount;
+		current = 1 - current;
+		if (clippedCount < 3)
+		{
+			return;
+		}
+	}
+
+	// The clipped polygon is convex; draw it as a fan
+	const ClipVertex* polygon = buffers[current];
+	for (int i = 1; i + 1 < counts[current]; i++)
+	{
+		SetupTriangle(polygon[0], polygon[i], polygon[i + 1], target, withAttributes, material, output);
+	}
+}
+
+void SoftwareRenderer::SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Target& target,
+	bool withAttributes, int material, std::vector<Triangle>& output)
+{
+	const ClipVertex* corners[3] = { &a, &b, &c };
+	float x[3], y[3], z[3], inverseW[3];
+	for (int i = 0; i < 3; i++)
+	{
+		// Perspective divide and viewport transform, with the default depth range
+		const glm::vec4& p = corners[i]->position;
+		inverseW[i] = 1.0f / p.w;
+		float screenX = (p.x * inverseW[i] * 0.5f + 0.5f) * target.width;
+		float screenY = (p.y * inverseW[i] * 0.5f + 0.5f) * target.height;
+		x[i] = std::floor(screenX * SubpixelSteps + 0.5f) / SubpixelSteps;
+		y[i] = std::floor(screenY * SubpixelSteps + 0.5f) / SubpixelSteps;
+		z[i] = p.z * inverseW[i] * 0.5f + 0.5f;
+	}
+
+	// Twice the signed area; both windings are drawn, as GL_CULL_FACE is off
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.0f)
+	{
+		return;
+	}
+
+	Triangle triangle;
+	triangle.minX = std::max(static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))), 0);
+	triangle.minY = std::max(static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))), 0);
+	triangle.maxX = std::min(static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))), target.width - 1);
+	triangle.maxY = std::min(static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))), target.height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	// Edge i is opposite of vertex i, so its function divided by the area is the barycentric weight of vertex i
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	float inverseArea = 1.0f / (area * sign);
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		triangle.edgeA[i] = (y[j] - y[k]) * sign;
+		triangle.edgeB[i] = (x[k] - x[j]) * sign;
+		triangle.edgeX[i] = x[j];
+		triangle.edgeY[i] = y[j];
+		triangle.topLeft[i] = triangle.edgeA[i] > 0.0f || (triangle.edgeA[i] == 0.0f && triangle.edgeB[i] < 0.0f);
+	}
+	triangle.originX = x[0];
+	triangle.originY = y[0];
+	triangle.material = material;
+
+	auto makePlane = [&](float v0, float v1, float v2, float* plane)
+	{
+		plane[0] = (v0 * triangle.edgeA[0] + v1 * triangle.edgeA[1] + v2 * triangle.edgeA[2]) * inverseArea;
+		plane[1] = (v0 * triangle.edgeB[0] + v1 * triangle.edgeB[1] + v2 * triangle.edgeB[2]) * inverseArea;
+		plane[2] = v0;
+	};
+
+	makePlane(z[0], z[1], z[2], triangle.depth);
+	if (withAttributes)
+	{
+		makePlane(inverseW[0], inverseW[1], inverseW[2], triangle.inverseW);
+		for (int j = 0; j < SoftwareAttributeCount; j++)
+		{
+			makePlane(a.attributes[j] * inverseW[0], b.attributes[j] * inverseW[1], c.attributes[j] * inverseW[2],
+				triangle.attributes[j]);
+		}
+	}
+
+	output.push_back(triangle);
+}
+
+void SoftwareRenderer::RasterizeTile(Target& target, int tile, int* triangleIds)
+{
+	int tileX = (tile % target.tilesX) * SoftwareTileSize;
+	int tileY = (tile / target.tilesX) * SoftwareTileSize;
+
+	for (int row = 0; row < SoftwareTileSize; row++)
+	{
+		size_t offset = static_cast<size_t>(tileY + row) * target.stride + tileX;
+		std::fill(target.depth.begin() + offset, target.depth.begin() + offset + SoftwareTileSize, 1.0f);
+		if (triangleIds != nullptr)
+		{
+			std::fill(triangleIds + offset, triangleIds + offset + SoftwareTileSize, -1);
+		}
+	}
+
+	const Float4 ramp = Ramp();
+	for (int index : bins[tile])
+	{
+		const Triangle& triangle = triangles[index];
+
+		// Pixel rectangle of the triangle inside the tile; runs of 4 pixels start at a multiple of 4
+		int startX = std::max(triangle.minX, tileX) & ~3;
+		int endX = std::min(triangle.maxX, tileX + SoftwareTileSize - 1);
+		int startY = std::max(triangle.minY, tileY);
+		int endY = std::min(triangle.maxY, tileY + SoftwareTileSize - 1);
+
+		// Edge functions and depth at the center of the first pixel; evaluated in double, as the coordinates can be
+		// large compared to the distance of a pixel to an edge
+		double centerX = startX + 0.5;
+		double centerY = startY + 0.5;
+		float edges[3];
+		Float4 edgeSteps[3];
+		for (int i = 0; i < 3; i++)
+		{
+			edges[i] = static_cast<float>(triangle.edgeA[i] * (centerX - triangle.edgeX[i]) + triangle.edgeB[i] * (centerY - triangle.edgeY[i]));
+			edgeSteps[i] = Splat(triangle.edgeA[i]) * ramp;
+		}
+		float depth = static_cast<float>(triangle.depth[2] + triangle.depth[0] * (centerX - triangle.originX)
+			+ triangle.depth[1] * (centerY - triangle.originY));
+		Float4 depthStep = Splat(triangle.depth[0]) * ramp;
+		Float4 minX = Splat(static_cast<float>(triangle.minX));
+		Float4 maxX = Splat(static_cast<float>(triangle.maxX));
+
+		for (int y = startY; y <= endY; y++)
+		{
+			float dy = static_cast<float>(y - startY);
+			size_t rowOffset = static_cast<size_t>(y) * target.stride;
+			for (int x = startX; x <= endX; x += 4)
+			{
+				float dx = static_cast<float>(x - startX);
+				Float4 pixelX = Splat(static_cast<float>(x)) + ramp;
+				Mask4 inside = (minX <= pixelX) & (pixelX <= maxX);
+				for (int i = 0; i < 3; i++)
+				{
+					Float4 edge = Splat(edges[i] + triangle.edgeA[i] * dx + triangle.edgeB[i] * dy) + edgeSteps[i];
+					inside = inside & InsideEdge(edge, triangle.topLeft[i]);
+				}
+				if (!Any(inside))
+				{
+					continue;
+				}
+
+				// Depth test (GL_LESS)
+				Float4 z = Splat(depth + triangle.depth[0] * dx + triangle.depth[1] * dy) + depthStep;
+				float* depthBuffer = &target.depth[rowOffset + x];
+				Mask4 passed = inside & (z < Load(depthBuffer));
+				if (!Any(passed))
+				{
+					continue;
+				}
+
+				StoreMasked(depthBuffer, z, passed);
+				if (triangleIds != nullptr)
+				{
+					StoreMasked(triangleIds + rowOffset + x, index, passed);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::ShadeTile(int tile)
+{
+	int tileX = (tile % scene.tilesX) * SoftwareTileSize;
+	int tileY = (tile / scene.tilesX) * SoftwareTileSize;
+	int endX = std::min(tileX + SoftwareTileSize, width);
+	int endY = std::min(tileY + SoftwareTileSize, height);
+
+	float layerWidth = static_cast<float>(materials->GetLayerWidth());
+	float layerHeight = static_cast<float>(materials->GetLayerHeight());
+	glm::vec3 ambient = 0.5f * lighting.ambientIntensity;
+	glm::vec3 lightDirection = -lighting.lightDirection;
+
+	for (int y = tileY; y < endY; y++)
+	{
+		for (int x = tileX; x < endX; x++)
+		{
+			unsigned char* output = &color[(static_cast<size_t>(y) * width + x) * 4];
+			int index = sceneTriangleIds[static_cast<size_t>(y) * scene.stride + x];
+			if (index < 0)
+			{
+				output[0] = 0;
+				output[1] = 0;
+				output[2] = 0;
+				output[3] = 255;
+				continue;
+			}
+
+			// Perspective-correct attributes at the pixel center
+			const Triangle& triangle = triangles[index];
+			float dx = x + 0.5f - triangle.originX;
+			float dy = y + 0.5f - triangle.originY;
+			float w = 1.0f / (triangle.inverseW[2] + triangle.inverseW[0] * dx + triangle.inverseW[1] * dy);
+			float attributes[SoftwareAttributeCount];
+			for (int j = 0; j < SoftwareAttributeCount; j++)
+			{
+				const float* plane = triangle.attributes[j];
+				attributes[j] = (plane[2] + plane[0] * dx + plane[1] * dy) * w;
+			}
+			glm::vec3 position(attributes[0], attributes[1], attributes[2]);
+			glm::vec3 normal(attributes[3], attributes[4], attributes[5]);
+			glm::vec4 lightPosition(attributes[8], attributes[9], attributes[10], attributes[11]);
+
+			// Screen-space derivatives of the UV coordinates, from the planes of u / w, v / w and 1 / w
+			float u = attributes[6];
+			float v = attributes[7];
+			float dudx = (triangle.attributes[6][0] - u * triangle.inverseW[0]) * w;
+			float dudy = (triangle.attributes[6][1] - u * triangle.inverseW[1]) * w;
+			float dvdx = (triangle.attributes[7][0] - v * triangle.inverseW[0]) * w;
+			float dvdy = (triangle.attributes[7][1] - v * triangle.inverseW[1]) * w;
+			float texelsX = std::sqrt(dudx * dudx * layerWidth * layerWidth + dvdx * dvdx * layerHeight * layerHeight);
+			float texelsY = std::sqrt(dudy * dudy * layerWidth * layerWidth + dvdy * dvdy * layerHeight * layerHeight);
+			float lod = std::log2(std::max(std::max(texelsX, texelsY), 1e-6f));
+
+			// The rest follows main.fsh
+			const MaterialParams& material = materials->GetMaterial(triangle.material);
+			glm::vec3 texColor = SampleMaterialTexture(*materials, static_cast<int>(material.layer), u, v, lod);
+
+			glm::vec3 norm = glm::normalize(normal);
+			float diffuse = std::max(glm::dot(norm, lightDirection), 0.0f);
+
+			glm::vec3 viewDirection = glm::normalize(lighting.eyePosition - position);
+			glm::vec3 reflected = -lightDirection - 2.0f * glm::dot(normal, -lightDirection) * normal;
+			float specular = std::pow(std::max(glm::dot(viewDirection, reflected), 0.0f), material.shininess);
+
+			glm::vec3 light = ambient;
+			if (triangle.lightmapped && lighting.lightmap != nullptr)
+			{
+				glm::vec4 baked = SampleTexture(lighting.lightmap, lighting.lightmapSize, lighting.lightmapSize, attributes[12], attributes[13]);
+				light = glm::vec3(baked) * LightmapScale + specular * material.specular * baked.w * lighting.specularIntensity;
+			}
+			else
+			{
+				float lightX = (lightPosition.x / lightPosition.w + 1.0f) / 2.0f;
+				float lightY = (lightPosition.y / lightPosition.w + 1.0f) / 2.0f;
+				float lightZ = (lightPosition.z / lightPosition.w + 1.0f) / 2.0f;
+				float bias = 0.05f;
+				bool shadowed = SampleDepth(shadow.depth.data(), shadow.width, shadow.height, shadow.stride, lightX, lightY) < lightZ - bias;
+				if (!shadowed)
+				{
+					light = light + diffuse * lighting.diffuseIntensity + specular * material.specular * lighting.specularIntensity;
+				}
+			}
+			glm::vec3 sum = light * texColor;
+			for (int i = 0; i < 3; i++)
+			{
+				float value = std::min(std::max(sum[i], 0.0f), 1.0f);
+				output[i] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+			}
+			output[3] = 255;
+		}
+	}
+}
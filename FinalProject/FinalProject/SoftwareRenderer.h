@@ -0,0 +1,188 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MaterialLibrary.h"
+#include "MeshRegistry.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+
+// Size of the square screen tiles that the triangles are binned into; a multiple of 4 (the SIMD width)
+const int SoftwareTileSize = 32;
+
+// Interpolated values per vertex of the scene pass: world position (3), normal (3), UV (2), light clip position (4),
+// lightmap UV (2)
+const int SoftwareAttributeCount = 14;
+
+/// <summary>
+/// Light and camera values of the scene pass, the same ones SetLightingUniforms() gives main.fsh.
+/// </summary>
+struct SoftwareLighting
+{
+	glm::vec3 eyePosition;
+	glm::vec3 lightDirection;		// directional_light
+	glm::vec3 ambientIntensity;
+	glm::vec3 diffuseIntensity;
+	glm::vec3 specularIntensity;
+	glm::mat4 lightViewProjection;	// projectionLight * viewLight
+	const unsigned char* lightmap;	// Baked lighting (Lightmap::GetPixels()) for lightmapped draws, or nullptr if lightmaps are off
+	int lightmapSize;
+};
+
+/// <summary>
+/// Renders the scene on the CPU, for machines without a usable GPU. It draws the same lists of DrawCommands as
+/// the GL passes and reproduces main.vsh / main.fsh: a depth-only shadow map pass, then the textured, lit and
+/// shadowed scene.
+///
+/// Every pass transforms and clips the triangles of all draws, then sorts them into screen tiles (binning).
+/// The tiles are processed in parallel by a thread pool; each tile first rasterizes depth and the ID of the
+/// closest triangle for its pixels (4 pixels at a time with SIMD edge functions), then shades every covered pixel
+/// once. Triangles are kept in submission order inside a tile, so the result doesn't depend on the thread count.
+/// </summary>
+class SoftwareRenderer
+{
+public:
+	/// <summary>
+	/// Allocates the render targets and starts the worker threads.
+	/// </summary>
+	/// <param name="width">Width of the color buffer</param>
+	/// <param name="height">Height of the color buffer</param>
+	/// <param name="shadowMapSize">Width and height of the shadow map</param>
+	/// <param name="threadCount">Number of threads (0 to use every hardware thread)</param>
+	void Create(int width, int height, int shadowMapSize, int threadCount = 0);
+
+	/// <summary>
+	/// Stops the worker threads and deletes the GL objects used by Present().
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Reallocates the color and depth buffers, if the size changed.
+	/// </summary>
+	void Resize(int width, int height);
+
+	/// <summary>
+	/// Renders the depth of the draws into the shadow map.
+	/// </summary>
+	void RenderShadowMap(const MeshRegistry& meshes, const std::vector<DrawCommand>& draws, const glm::mat4& lightViewProjection);
+
+	/// <summary>
+	/// Renders the draws into the color buffer, shaded like main.fsh with the last shadow map.
+	/// </summary>
+	void RenderScene(const MeshRegistry& meshes, const MaterialLibrary& materials, const std::vector<DrawCommand>& draws,
+		const glm::mat4& viewProjection, const SoftwareLighting& lighting);
+
+	/// <summary>
+	/// Uploads the color buffer and stretches it over the window (default framebuffer).
+	/// </summary>
+	void Present(int windowWidth, int windowHeight);
+
+	/// <returns>RGBA color buffer, bottom row first (like glReadPixels)</returns>
+	const std::vector<unsigned char>& GetColorBuffer() const { return color; }
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetThreadCount() const { return pool.GetThreadCount(); }
+
+	/// <returns>Triangles that reached the binning stage in the last scene pass</returns>
+	size_t GetTriangleCount() const { return triangles.size(); }
+
+private:
+	/// <summary>
+	/// A triangle after clipping and setup. Every value that varies over the triangle is stored as a plane
+	/// v(x, y) = a * x + b * y + c in screen space.
+	/// </summary>
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3];			// Edge functions a * (x - edgeX) + b * (y - edgeY), positive inside
+		float edgeX[3], edgeY[3];			// A point on each edge
+		bool topLeft[3];					// Whether pixels exactly on the edge belong to the triangle
+		float originX, originY;				// Screen position of the first vertex, where the planes below are evaluated from
+		float depth[3];						// Window-space depth (0 to 1): d/dx, d/dy, value at the origin
+		float inverseW[3];					// 1 / w, for perspective-correct interpolation
+		float attributes[SoftwareAttributeCount][3];	// Attributes divided by w
+		int minX, minY, maxX, maxY;			// Pixel bounding box, clamped to the target
+		int material;
+		bool lightmapped;
+	};
+
+	/// <summary>
+	/// A vertex after the vertex stage, in clip space.
+	/// </summary>
+	struct ClipVertex
+	{
+		glm::vec4 position;
+		float attributes[SoftwareAttributeCount];
+	};
+
+	/// <summary>
+	/// Render target of a pass. The buffers are padded to whole tiles.
+	/// </summary>
+	struct Target
+	{
+		int width;
+		int height;
+		int stride;				// Width padded to whole tiles
+		int tilesX;
+		int tilesY;
+		std::vector<float> depth;
+	};
+
+	/// <summary>
+	/// Transforms, clips and sets up the triangles of all draws, and sorts them into the tiles of the target.
+	/// </summary>
+	void BinTriangles(const MeshRegistry& meshes, const std::vector<DrawCommand>& draws, const glm::mat4& viewProjection,
+		const Target& target, bool withAttributes);
+
+	/// <summary>
+	/// Clips a triangle against the near and far planes and the guard band, and sets up the resulting triangles.
+	/// </summary>
+	static void ClipTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Target& target,
+		bool withAttributes, int material, std::vector<Triangle>& output);
+
+	/// <summary>
+	/// Computes the edge functions and interpolation planes of a triangle that is inside the clip volume.
+	/// </summary>
+	static void SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Target& target,
+		bool withAttributes, int material, std::vector<Triangle>& output);
+
+	/// <summary>
+	/// Rasterizes the triangles of one tile into the depth buffer, and optionally records the closest triangle per pixel.
+	/// </summary>
+	void RasterizeTile(Target& target, int tile, int* triangleIds);
+
+	/// <summary>
+	/// Shades the pixels of one tile of the scene pass.
+	/// </summary>
+	void ShadeTile(int tile);
+
+	static void ResizeTarget(Target& target, int width, int height);
+
+	ThreadPool pool;
+
+	Target scene = {};
+	Target shadow = {};
+	std::vector<int> sceneTriangleIds;	// Closest triangle per pixel of the scene pass (-1 for none)
+	std::vector<unsigned char> color;	// RGBA, unpadded
+	int width = 0;
+	int height = 0;
+
+	// Triangles of the current pass, and the indices of the triangles overlapping each tile in submission order
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<int>> bins;
+	std::vector<std::vector<Triangle>> drawTriangles;	// Triangles set up per draw, before they are merged in order
+
+	// State of the scene pass, read by the shading of every tile
+	const MaterialLibrary* materials = nullptr;
+	SoftwareLighting lighting = {};
+
+	// GL objects that Present() uploads the color buffer through
+	GLuint presentTexture = 0;
+	GLuint presentFramebuffer = 0;
+	int presentWidth = 0;
+	int presentHeight = 0;
+};
@@ -0,0 +1,130 @@
+#include "StaticBatcher.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "Profiler.h"
+
+/// <summary>
+/// Objects are merged only if all of these match.
+/// </summary>
+struct BatchKey
+{
+	int material;
+	bool castsShadow;
+	int cellX, cellY, cellZ;
+
+	bool operator<(const BatchKey& other) const
+	{
+		if (material != other.material) return material < other.material;
+		if (castsShadow != other.castsShadow) return castsShadow < other.castsShadow;
+		if (cellX != other.cellX) return cellX < other.cellX;
+		if (cellY != other.cellY) return cellY < other.cellY;
+		return cellZ < other.cellZ;
+	}
+};
+
+std::vector<SceneObject> BuildStaticBatches(MeshRegistry& meshes, std::vector<SceneObject>& objects, float chunkSize)
+{
+	PROFILE_ZONE("Build static batches");
+
+	// Sort the static objects into batches by material, shadow setting and the grid cell of their center
+	std::map<BatchKey, std::vector<int>> groups;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& object = objects[i];
+		if (!object.isStatic || object.isOccluder)
+		{
+			continue;
+		}
+
+		const MeshInfo& mesh = meshes.Get(object.mesh.levels[0]);
+		glm::vec3 center = Aabb::Transform(mesh.boundsMin, mesh.boundsMax, object.model).Center();
+
+		BatchKey key;
+		key.material = object.material;
+		key.castsShadow = object.castsShadow;
+		key.cellX = static_cast<int>(std::floor(center.x / chunkSize));
+		key.cellY = static_cast<int>(std::floor(center.y / chunkSize));
+		key.cellZ = static_cast<int>(std::floor(center.z / chunkSize));
+		groups[key].push_back(static_cast<int>(i));
+	}
+
+	std::vector<SceneObject> batches;
+	int mergedCount = 0;
+	for (const std::pair<const BatchKey, std::vector<int>>& group : groups)
+	{
+		// Merging a single object saves nothing
+		if (group.second.size() < 2)
+		{
+			continue;
+		}
+
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		for (int index : group.second)
+		{
+			SceneObject& object = objects[index];
+			const MeshInfo& mesh = meshes.Get(object.mesh.levels[0]);
+			glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(object.model)));
+
+			GLuint firstVertex = static_cast<GLuint>(vertices.size());
+			for (const Vertex& source : mesh.vertices)
+			{
+				Vertex vertex = source;
+
+				glm::vec3 position = glm::vec3(object.model * glm::vec4(source.x, source.y, source.z, 1.0f));
+				vertex.x = position.x;
+				vertex.y = position.y;
+				vertex.z = position.z;
+
+				// Some meshes have no normals (all zeros), which must stay that way instead of becoming NaN
+				glm::vec3 normal = normalMatrix * glm::vec3(source.nx, source.ny, source.nz);
+				float length = glm::length(normal);
+				if (length > 0.0f)
+				{
+					normal /= length;
+				}
+				vertex.nx = normal.x;
+				vertex.ny = normal.y;
+				vertex.nz = normal.z;
+
+				vertices.push_back(vertex);
+			}
+
+			for (GLuint index : mesh.indices)
+			{
+				indices.push_back(firstVertex + index);
+			}
+
+			object.isBatched = true;
+			mergedCount++;
+		}
+
+		MeshHandle batchMesh = meshes.Add(vertices, indices);
+
+		// Vertices are already in world space, so the mesh bounds are the world bounds
+		SceneObject batch;
+		batch.bounds.min = meshes.Get(batchMesh).boundsMin;
+		batch.bounds.max = meshes.Get(batchMesh).boundsMax;
+		batch.name = "Static batch " + std::to_string(batches.size());
+		batch.mesh = BuildMeshLods(meshes, batchMesh);
+		batch.model = glm::mat4(1.0f);
+		batch.material = group.first.material;
+		batch.castsShadow = group.first.castsShadow;
+		batch.isOccluder = false;
+		batch.collidable = false;
+		batch.isStatic = true;
+		batch.lod[LodPassMain] = 0;
+		batch.lod[LodPassShadow] = 0;
+		batch.isBatched = false;
+		batch.lightmapped = false;
+		batches.push_back(batch);
+	}
+
+	std::cout << "Static batching: " << mergedCount << " objects merged into " << batches.size() << " batches" << std::endl;
+
+	return batches;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "MeshRegistry.h"
+#include "Scene.h"
+
+/// <summary>
+/// Merges static objects into a few large meshes at load time.
+///
+/// Every static object is pre-transformed into world space, and objects that share a material and shadow
+/// setting are appended into one combined mesh per cell of a uniform grid. The grid keeps every batch
+/// spatially compact, so whole batches can still be frustum culled. A batch is drawn with one call and an
+/// identity model matrix, no matter how many objects it contains.
+///
+/// Occluders are left alone, since occlusion culling rasterizes and skips them one by one.
+/// </summary>
+/// <param name="meshes">Registry that holds the objects' meshes and receives the merged meshes</param>
+/// <param name="objects">Scene objects; the merged ones are flagged with isBatched and should no longer be drawn</param>
+/// <param name="chunkSize">Size of the grid cells in world units</param>
+/// <returns>One scene object per batch</returns>
+std::vector<SceneObject> BuildStaticBatches(MeshRegistry& meshes, std::vector<SceneObject>& objects, float chunkSize);
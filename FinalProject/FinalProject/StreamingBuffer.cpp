@@ -0,0 +1,275 @@
+#include "StreamingBuffer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <iostream>
+
+// glBufferStorage is a GL 4.4 entry point, so it is looked up at runtime instead of
+// relying on the GLAD loader having been generated with it.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRY* BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// How long a single glClientWaitSync call may block before we try again (in nanoseconds)
+static const GLuint64 FenceWaitTimeout = 1000000;
+
+/// <summary>
+/// Rounds the value up to the next multiple of the alignment.
+/// </summary>
+static GLsizeiptr AlignUp(GLsizeiptr value, GLsizeiptr alignment)
+{
+	if (alignment <= 1)
+	{
+		return value;
+	}
+	return ((value + alignment - 1) / alignment) * alignment;
+}
+
+bool StreamingBuffer::Create(GLsizeiptr capacity, bool allowPersistent)
+{
+	this->capacity = capacity;
+
+	glGenBuffers(1, &buffer);
+
+	// Use the copy-write target so that creating / mapping the buffer never disturbs
+	// the GL_ARRAY_BUFFER or the element buffer binding of the currently bound VAO
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+	BufferStorageProc bufferStorage = nullptr;
+	if (allowPersistent && glfwExtensionSupported("GL_ARB_buffer_storage"))
+	{
+		bufferStorage = reinterpret_cast<BufferStorageProc>(glfwGetProcAddress("glBufferStorage"));
+	}
+
+	if (bufferStorage != nullptr)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, capacity, nullptr, flags);
+		persistentPtr = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, capacity, flags));
+		persistent = persistentPtr != nullptr;
+	}
+
+	if (!persistent)
+	{
+		// The immutable storage could not be mapped, so start over with a regular buffer object
+		if (bufferStorage != nullptr)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		}
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (buffer == 0)
+	{
+		std::cerr << "Failed to create streaming buffer" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void StreamingBuffer::Destroy()
+{
+	while (!inFlight.empty())
+	{
+		WaitForOldestFrame();
+	}
+
+	if (buffer != 0)
+	{
+		if (persistent || mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	buffer = 0;
+	persistentPtr = nullptr;
+	mapped = false;
+	head = 0;
+	usedBytes = 0;
+	currentFrameBytes = 0;
+}
+
+void StreamingBuffer::BeginFrame()
+{
+	frameStallTime = 0.0;
+	currentFrameBytes = 0;
+
+	// Reclaim every frame that the GPU already finished, without blocking
+	while (!inFlight.empty())
+	{
+		GLenum status = glClientWaitSync(inFlight.front().fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+
+		glDeleteSync(inFlight.front().fence);
+		usedBytes -= inFlight.front().bytes;
+		inFlight.pop_front();
+	}
+}
+
+StreamAllocation StreamingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	StreamAllocation allocation = { nullptr, 0, 0 };
+
+	if (mapped)
+	{
+		std::cerr << "Streaming buffer: Commit() the previous allocation before allocating again" << std::endl;
+		return allocation;
+	}
+
+	if (size <= 0 || size > capacity)
+	{
+		std::cerr << "Streaming buffer: allocation of " << size << " bytes does not fit in the ring" << std::endl;
+		return allocation;
+	}
+
+	// Find where the region would start, wrapping around to the beginning if it would run past the end.
+	// The skipped bytes at the end of the ring count towards this frame so that they are reclaimed with it.
+	GLsizeiptr start = AlignUp(head, alignment);
+	GLsizeiptr consumed = (start - head) + size;
+	bool wraps = start + size > capacity;
+	if (wraps)
+	{
+		start = 0;
+		consumed = (capacity - head) + size;
+	}
+
+	if (persistent)
+	{
+		// Wait for old frames until the region is no longer in use by the GPU
+		while (usedBytes + consumed > capacity)
+		{
+			if (inFlight.empty())
+			{
+				std::cerr << "Streaming buffer: frame allocations exceed the ring capacity" << std::endl;
+				return allocation;
+			}
+			WaitForOldestFrame();
+		}
+
+		allocation.data = persistentPtr + start;
+	}
+	else
+	{
+		// Without fences, the only safe way to reuse the start of the buffer is to orphan it
+		if (wraps)
+		{
+			Orphan();
+			consumed = size;
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size, flags);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		if (allocation.data == nullptr)
+		{
+			std::cerr << "Streaming buffer: failed to map " << size << " bytes" << std::endl;
+			return allocation;
+		}
+		mapped = true;
+	}
+
+	head = start + size;
+	if (head == capacity)
+	{
+		head = 0;
+	}
+	usedBytes += consumed;
+	currentFrameBytes += consumed;
+
+	allocation.offset = start;
+	allocation.size = size;
+	return allocation;
+}
+
+void StreamingBuffer::Commit()
+{
+	// Coherent persistent mappings are visible to the GPU without any extra work
+	if (!mapped)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	mapped = false;
+}
+
+void StreamingBuffer::EndFrame()
+{
+	Commit();
+
+	if (persistent && currentFrameBytes > 0)
+	{
+		FrameRegion region;
+		region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region.bytes = currentFrameBytes;
+		inFlight.push_back(region);
+	}
+
+	if (frameStallTime > 0.0)
+	{
+		stalledFrameCount++;
+	}
+}
+
+void StreamingBuffer::WaitForOldestFrame()
+{
+	FrameRegion region = inFlight.front();
+	inFlight.pop_front();
+
+	std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceWaitTimeout);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+		if (status == GL_WAIT_FAILED)
+		{
+			std::cerr << "Streaming buffer: waiting on a fence failed" << std::endl;
+			break;
+		}
+	}
+
+	std::chrono::duration<double> waited = std::chrono::steady_clock::now() - waitStart;
+	frameStallTime += waited.count();
+	totalStallTime += waited.count();
+
+	glDeleteSync(region.fence);
+	usedBytes -= region.bytes;
+}
+
+void StreamingBuffer::Orphan()
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	head = 0;
+	usedBytes = 0;
+	currentFrameBytes = 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <deque>
+
+/// <summary>
+/// A region of the streaming buffer that was handed out by StreamingBuffer::Allocate().
+/// </summary>
+struct StreamAllocation
+{
+	void* data;			// CPU pointer to write into (nullptr if the allocation failed)
+	GLintptr offset;	// Byte offset of the region inside the buffer object
+	GLsizeiptr size;	// Size of the region in bytes
+};
+
+/// <summary>
+/// Ring buffer for data that changes every frame (dynamic vertices, instance data, uniforms).
+/// Memory written in a frame is reclaimed once the fence inserted at the end of that frame has signaled,
+/// so the CPU never writes into a region that the GPU might still be reading from.
+///
+/// When glBufferStorage is available (GL 4.4 / ARB_buffer_storage), the buffer is mapped once
+/// with persistent + coherent flags. Otherwise, on plain GL 3.3, every allocation is mapped
+/// unsynchronized and the buffer is orphaned whenever the ring wraps around.
+///
+/// Usage per frame: BeginFrame(), then Allocate() / write / Commit() for every sub-allocation, then EndFrame().
+/// </summary>
+class StreamingBuffer
+{
+public:
+	/// <summary>
+	/// Creates the buffer object.
+	/// </summary>
+	/// <param name="capacity">Size of the ring in bytes</param>
+	/// <param name="allowPersistent">Set to false to force the orphaning path</param>
+	/// <returns>True if the buffer was created successfully</returns>
+	bool Create(GLsizeiptr capacity, bool allowPersistent = true);
+
+	/// <summary>
+	/// Waits for all pending frames and deletes the buffer object.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Marks the start of a new frame. Frames whose fences have already signaled are reclaimed.
+	/// </summary>
+	void BeginFrame();
+
+	/// <summary>
+	/// Sub-allocates a region of the ring for the current frame.
+	/// The returned pointer is only valid until Commit() is called.
+	/// </summary>
+	/// <param name="size">Size of the region in bytes</param>
+	/// <param name="alignment">Alignment of the region's offset (e.g., GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)</param>
+	/// <returns>The allocated region; data is nullptr if the request can never fit in the ring</returns>
+	StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 256);
+
+	/// <summary>
+	/// Finishes writing into the last allocation. Must be called before the GPU uses the data.
+	/// </summary>
+	void Commit();
+
+	/// <summary>
+	/// Marks the end of the frame by inserting a fence after all commands that used this frame's allocations.
+	/// </summary>
+	void EndFrame();
+
+	/// <returns>OpenGL handle to the buffer object</returns>
+	GLuint GetBuffer() const { return buffer; }
+
+	/// <returns>Size of the ring in bytes</returns>
+	GLsizeiptr GetCapacity() const { return capacity; }
+
+	/// <returns>True if the buffer is persistently mapped</returns>
+	bool IsPersistent() const { return persistent; }
+
+	/// <returns>Time (in seconds) the CPU spent waiting on fences during the last frame</returns>
+	double GetFrameStallTime() const { return frameStallTime; }
+
+	/// <returns>Time (in seconds) the CPU spent waiting on fences since the buffer was created</returns>
+	double GetTotalStallTime() const { return totalStallTime; }
+
+	/// <returns>Number of frames in which the CPU had to wait on a fence</returns>
+	int GetStalledFrameCount() const { return stalledFrameCount; }
+
+private:
+	/// <summary>
+	/// Bytes of the ring consumed by one frame, and the fence that tells us when the GPU is done with them.
+	/// </summary>
+	struct FrameRegion
+	{
+		GLsync fence;
+		GLsizeiptr bytes;
+	};
+
+	/// <summary>
+	/// Blocks until the oldest in-flight frame is done and returns its bytes to the ring.
+	/// </summary>
+	void WaitForOldestFrame();
+
+	/// <summary>
+	/// Gives the buffer a fresh data store (orphaning path only).
+	/// </summary>
+	void Orphan();
+
+	GLuint buffer = 0;
+	GLsizeiptr capacity = 0;
+	bool persistent = false;
+	unsigned char* persistentPtr = nullptr;
+	bool mapped = false;
+
+	GLsizeiptr head = 0;
+	GLsizeiptr usedBytes = 0;
+	GLsizeiptr currentFrameBytes = 0;
+	std::deque<FrameRegion> inFlight;
+
+	double frameStallTime = 0.0;
+	double totalStallTime = 0.0;
+	int stalledFrameCount = 0;
+};
@@ -0,0 +1,332 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "Profiler.h"
+
+void TextureResidency::Create(size_t budget, size_t streamingBytesPerFrame)
+{
+	this->budget = budget;
+	this->streamingBytesPerFrame = streamingBytesPerFrame;
+	resources.clear();
+	frame = 0;
+	evictedLevels = 0;
+	streamedLevels = 0;
+	failedAllocations = 0;
+	overBudgetReported = false;
+}
+
+void TextureResidency::Destroy()
+{
+	resources.clear();
+}
+
+int TextureResidency::AddFixedResource(const std::string& name, size_t bytes)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.streamed = false;
+	resource.fixedBytes = bytes;
+	resources.push_back(resource);
+	return static_cast<int>(resources.size()) - 1;
+}
+
+void TextureResidency::SetFixedResourceSize(int resource, size_t bytes)
+{
+	resources[resource].fixedBytes = bytes;
+}
+
+int TextureResidency::AddTexture(const std::string& name, GLuint texture, int width, int height, int layers, const TextureLevelSource& source)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.streamed = true;
+	resource.texture = texture;
+	resource.width = width;
+	resource.height = height;
+	resource.layers = layers;
+	resource.levelCount = static_cast<int>(std::floor(std::log2(static_cast<float>(std::max(width, height))))) + 1;
+	resource.source = source;
+
+	resource.tailLevel = 0;
+	while (resource.tailLevel < resource.levelCount - 1 && std::max(width >> resource.tailLevel, height >> resource.tailLevel) > ResidentTailSize)
+	{
+		resource.tailLevel++;
+	}
+	resource.residentLevel = resource.levelCount;
+	resource.wantedLevel = resource.tailLevel;
+	resource.requestedLevel = static_cast<float>(resource.levelCount);
+	resource.heldLevel = resource.levelCount;
+	resource.heldSince = 0;
+	resource.lastUsedFrame = -1;
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, resource.levelCount - 1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// The tail is small and always needed; it is uploaded outside of the budget and the per-frame limit
+	for (int level = resource.levelCount - 1; level >= resource.tailLevel; level--)
+	{
+		UploadLevel(resource, level);
+	}
+
+	resources.push_back(resource);
+	return static_cast<int>(resources.size()) - 1;
+}
+
+void TextureResidency::RequestLevel(int texture, float level)
+{
+	Resource& resource = resources[texture];
+	resource.requestedLevel = std::min(resource.requestedLevel, std::max(level, 0.0f));
+}
+
+void TextureResidency::Update()
+{
+	UpdateResidency(streamingBytesPerFrame);
+}
+
+void TextureResidency::Flush()
+{
+	UpdateResidency(static_cast<size_t>(-1));
+}
+
+size_t TextureResidency::GetUsedBytes() const
+{
+	size_t used = 0;
+	for (const Resource& resource : resources)
+	{
+		used += resource.streamed ? GetResidentBytes(resource, resource.residentLevel) : resource.fixedBytes;
+	}
+	return used;
+}
+
+size_t TextureResidency::GetSourceBytes() const
+{
+	size_t bytes = 0;
+	for (const Resource& resource : resources)
+	{
+		if (resource.streamed)
+		{
+			bytes += GetResidentBytes(resource, 0);
+		}
+	}
+	return bytes;
+}
+
+void TextureResidency::PrintStats() const
+{
+	const double megabyte = 1024.0 * 1024.0;
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Texture residency: " << GetUsedBytes() / megabyte << " of " << budget / megabyte << " MB used, "
+		<< streamedLevels << " levels streamed in, " << evictedLevels << " evicted";
+	if (failedAllocations > 0)
+	{
+		std::cout << ", " << failedAllocations << " allocations failed";
+	}
+	std::cout << std::endl;
+
+	for (const Resource& resource : resources)
+	{
+		if (resource.streamed)
+		{
+			std::cout << "  " << resource.name << ": " << GetResidentBytes(resource, resource.residentLevel) / megabyte
+				<< " MB, levels " << resource.residentLevel << "-" << resource.levelCount - 1 << " resident ("
+				<< std::max(resource.width >> resource.residentLevel, 1) << "x" << std::max(resource.height >> resource.residentLevel, 1)
+				<< "), " << GetResidentBytes(resource, 0) / megabyte << " MB in system memory" << std::endl;
+		}
+		else
+		{
+			std::cout << "  " << resource.name << ": " << resource.fixedBytes / megabyte << " MB" << std::endl;
+		}
+	}
+	std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+size_t TextureResidency::GetLevelBytes(const Resource& resource, int level)
+{
+	size_t width = static_cast<size_t>(std::max(resource.width >> level, 1));
+	size_t height = static_cast<size_t>(std::max(resource.height >> level, 1));
+	return width * height * 4 * resource.layers;
+}
+
+size_t TextureResidency::GetResidentBytes(const Resource& resource, int firstLevel)
+{
+	size_t bytes = 0;
+	for (int level = firstLevel; level < resource.levelCount; level++)
+	{
+		bytes += GetLevelBytes(resource, level);
+	}
+	return bytes;
+}
+
+bool TextureResidency::UploadLevel(Resource& resource, int level)
+{
+	int width = std::max(resource.width >> level, 1);
+	int height = std::max(resource.height >> level, 1);
+
+	// Clear older errors, so that an out-of-memory error can be told apart
+	while (glGetError() != GL_NO_ERROR)
+	{
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, resource.texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, resource.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	if (glGetError() == GL_OUT_OF_MEMORY)
+	{
+		// Give the level up and lower the budget to what actually fit, instead of failing
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		failedAllocations++;
+		budget = std::min(budget, GetUsedBytes());
+		std::cerr << "Out of GPU memory while streaming " << resource.name << " level " << level
+			<< ", texture budget lowered to " << budget / (1024 * 1024) << " MB" << std::endl;
+		return false;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int layer = 0; layer < resource.layers; layer++)
+	{
+		const unsigned char* pixels = resource.source(layer, level);
+		if (pixels != nullptr)
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Only the levels from the base level on are sampled, so the texture stays complete while finer levels are missing
+	resource.residentLevel = level;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return true;
+}
+
+void TextureResidency::EvictLevels(Resource& resource, int level)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, resource.texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+
+	// Redefining a level with a size of zero releases its memory
+	for (int evicted = resource.residentLevel; evicted < level; evicted++)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, evicted, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		evictedLevels++;
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	resource.residentLevel = level;
+}
+
+void TextureResidency::UpdateResidency(size_t uploadLimit)
+{
+	PROFILE_ZONE("Texture residency");
+	frame++;
+
+	// Wanted level of every texture, from the usage reported in the last frame. Textures that were never drawn
+	// are wanted in full detail, so that they are ready when they come into view; textures that weren't drawn
+	// for a while fall back to their tail.
+	size_t wantedBytes = 0;
+	for (Resource& resource : resources)
+	{
+		if (!resource.streamed)
+		{
+			wantedBytes += resource.fixedBytes;
+			continue;
+		}
+
+		int requested = std::min(static_cast<int>(std::floor(resource.requestedLevel)), resource.levelCount);
+		if (requested < resource.levelCount)
+		{
+			resource.lastUsedFrame = frame;
+			if (requested <= resource.heldLevel || frame - resource.heldSince > ResidencyHoldFrames)
+			{
+				resource.heldLevel = requested;
+				resource.heldSince = frame;
+			}
+		}
+		resource.requestedLevel = static_cast<float>(resource.levelCount);
+
+		if (resource.lastUsedFrame < 0)
+		{
+			resource.wantedLevel = 0;
+		}
+		else if (frame - resource.lastUsedFrame > ResidencyHoldFrames)
+		{
+			resource.wantedLevel = resource.tailLevel;
+		}
+		else
+		{
+			resource.wantedLevel = std::min(resource.heldLevel, resource.tailLevel);
+		}
+		wantedBytes += GetResidentBytes(resource, resource.wantedLevel);
+	}
+
+	// Over the budget: drop the finest wanted level of the least recently used texture (the largest one among
+	// equally recent ones) until everything fits
+	while (wantedBytes > budget)
+	{
+		Resource* victim = nullptr;
+		for (Resource& resource : resources)
+		{
+			if (!resource.streamed || resource.wantedLevel >= resource.tailLevel)
+			{
+				continue;
+			}
+			if (victim == nullptr || resource.lastUsedFrame < victim->lastUsedFrame
+				|| (resource.lastUsedFrame == victim->lastUsedFrame && GetLevelBytes(resource, resource.wantedLevel) > GetLevelBytes(*victim, victim->wantedLevel)))
+			{
+				victim = &resource;
+			}
+		}
+
+		if (victim == nullptr)
+		{
+			if (!overBudgetReported)
+			{
+				std::cerr << "Texture residency: the fixed resources and resident tails alone exceed the budget of "
+					<< budget / (1024 * 1024) << " MB" << std::endl;
+				overBudgetReported = true;
+			}
+			break;
+		}
+
+		wantedBytes -= GetLevelBytes(*victim, victim->wantedLevel);
+		victim->wantedLevel++;
+	}
+
+	// Evict first, so the memory is free before anything is streamed in
+	for (Resource& resource : resources)
+	{
+		if (resource.streamed && resource.residentLevel < resource.wantedLevel)
+		{
+			EvictLevels(resource, resource.wantedLevel);
+		}
+	}
+
+	// Stream in one level at a time, coarse to fine, until the limit of this frame is reached
+	size_t uploaded = 0;
+	bool progress = true;
+	while (progress && uploaded < uploadLimit)
+	{
+		progress = false;
+		for (Resource& resource : resources)
+		{
+			if (!resource.streamed || resource.residentLevel <= resource.wantedLevel || uploaded >= uploadLimit)
+			{
+				continue;
+			}
+
+			int level = resource.residentLevel - 1;
+			if (!UploadLevel(resource, level))
+			{
+				return;
+			}
+			uploaded += GetLevelBytes(resource, level);
+			streamedLevels++;
+			progress = true;
+		}
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Mip levels of this size or smaller (in texels, along the longer side) always stay resident, so that a streamed
+// texture can be sampled whatever the budget
+const int ResidentTailSize = 64;
+
+// Frames a texture keeps its finer levels after it was last needed, so that objects at the edge of a level or
+// briefly out of view don't make the levels stream out and back in
+const int ResidencyHoldFrames = 60;
+
+/// <summary>
+/// Returns the RGBA8 pixels of one layer of one mip level of a streamed texture, or nullptr if that layer has no
+/// image (yet).
+/// </summary>
+typedef std::function<const unsigned char*(int layer, int level)> TextureLevelSource;
+
+/// <summary>
+/// Keeps the GPU memory of the renderer inside a budget.
+///
+/// Every GPU allocation is registered with its size: fixed resources (render targets, buffers) are only counted,
+/// while streamed textures are made resident one mip level at a time. The owner of a streamed texture keeps the
+/// full mip chain in system memory and reports each frame how detailed the texture needs to be on screen
+/// (RequestLevel); Update() then streams the needed levels in, a limited number of bytes per frame, and evicts the
+/// finest levels of the least recently needed textures when the budget would be exceeded. Levels are made
+/// resident through GL_TEXTURE_BASE_LEVEL, so evicting a level never changes the texture handle.
+///
+/// Streamed textures are RGBA8 2D texture arrays, like the texture array of the material library.
+/// </summary>
+class TextureResidency
+{
+public:
+	/// <summary>
+	/// Sets the budget. Resources can be added afterwards.
+	/// </summary>
+	/// <param name="budget">GPU memory that all registered resources may use together, in bytes</param>
+	/// <param name="streamingBytesPerFrame">Most bytes uploaded per frame by Update()</param>
+	void Create(size_t budget, size_t streamingBytesPerFrame);
+
+	/// <summary>
+	/// Forgets all resources. The GL objects belong to their owners and are not deleted.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Registers a resource that is never evicted (a render target, a buffer). Its size is counted against the budget.
+	/// </summary>
+	/// <returns>ID of the resource</returns>
+	int AddFixedResource(const std::string& name, size_t bytes);
+
+	/// <summary>
+	/// Updates the size of a fixed resource, e.g., after a render target was resized.
+	/// </summary>
+	void SetFixedResourceSize(int resource, size_t bytes);
+
+	/// <summary>
+	/// Registers a streamed texture and makes its coarsest levels (the resident tail) resident.
+	/// The texture must be bound to no unit that is drawn from while levels change.
+	/// </summary>
+	/// <param name="texture">GL_TEXTURE_2D_ARRAY whose level images the residency manager defines</param>
+	/// <param name="width">Width of level 0</param>
+	/// <param name="height">Height of level 0</param>
+	/// <param name="layers">Number of layers</param>
+	/// <param name="source">Pixels of every level, uploaded when a level is made resident</param>
+	/// <returns>ID of the resource</returns>
+	int AddTexture(const std::string& name, GLuint texture, int width, int height, int layers, const TextureLevelSource& source);
+
+	/// <summary>
+	/// Reports that the texture was drawn this frame and needs the given mip level (0 is the most detailed).
+	/// The finest level requested in a frame is kept.
+	/// </summary>
+	void RequestLevel(int texture, float level);
+
+	/// <summary>
+	/// Decides the levels every streamed texture gets this frame, evicts the levels that don't fit into the budget
+	/// and streams in missing levels, up to the per-frame limit. Call once per frame, before drawing.
+	/// </summary>
+	void Update();
+
+	/// <summary>
+	/// Like Update(), but streams in every wanted level without the per-frame limit (e.g., after loading).
+	/// </summary>
+	void Flush();
+
+	/// <returns>Finest resident level of a streamed texture (the texture's GL_TEXTURE_BASE_LEVEL)</returns>
+	int GetResidentLevel(int texture) const { return resources[texture].residentLevel; }
+
+	/// <returns>Number of mip levels of a streamed texture</returns>
+	int GetLevelCount(int texture) const { return resources[texture].levelCount; }
+
+	size_t GetBudget() const { return budget; }
+
+	/// <returns>GPU memory used by all registered resources, in bytes</returns>
+	size_t GetUsedBytes() const;
+
+	/// <returns>System memory holding the mip chains of the streamed textures, in bytes</returns>
+	size_t GetSourceBytes() const;
+
+	long long GetEvictedLevelCount() const { return evictedLevels; }
+	long long GetStreamedLevelCount() const { return streamedLevels; }
+
+	/// <summary>
+	/// Prints the memory used per resource, the budget, and the number of streamed and evicted levels.
+	/// </summary>
+	void PrintStats() const;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		bool streamed;
+		size_t fixedBytes;			// Size of a fixed resource
+
+		// Streamed textures
+		GLuint texture;
+		int width;
+		int height;
+		int layers;
+		int levelCount;
+		int tailLevel;				// First level of the resident tail
+		int residentLevel;			// Finest resident level
+		int wantedLevel;			// Level decided by the last update
+		float requestedLevel;		// Finest level requested this frame (levelCount if none)
+		int heldLevel;				// Finest level requested within the last ResidencyHoldFrames frames
+		long long heldSince;		// Frame in which heldLevel was requested
+		long long lastUsedFrame;	// Last frame the texture was requested in (-1 if never)
+		TextureLevelSource source;
+	};
+
+	/// <returns>Bytes of one mip level of a streamed texture (all layers)</returns>
+	static size_t GetLevelBytes(const Resource& resource, int level);
+
+	/// <returns>Bytes of the levels [firstLevel, levelCount) of a streamed texture</returns>
+	static size_t GetResidentBytes(const Resource& resource, int firstLevel);
+
+	/// <summary>
+	/// Allocates and uploads one level of a streamed texture.
+	/// </summary>
+	/// <returns>False if the GPU ran out of memory</returns>
+	bool UploadLevel(Resource& resource, int level);
+
+	/// <summary>
+	/// Frees the levels [residentLevel, level) of a streamed texture.
+	/// </summary>
+	void EvictLevels(Resource& resource, int level);
+
+	/// <summary>
+	/// Picks the wanted level of every streamed texture, evicts, and streams in at most uploadLimit bytes.
+	/// </summary>
+	void UpdateResidency(size_t uploadLimit);
+
+	std::vector<Resource> resources;
+	size_t budget = 0;
+	size_t streamingBytesPerFrame = 0;
+	long long frame = 0;
+
+	long long evictedLevels = 0;
+	long long streamedLevels = 0;
+	long long failedAllocations = 0;
+	bool overBudgetReported = false;
+};
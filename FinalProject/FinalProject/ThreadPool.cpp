@@ -0,0 +1,103 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+ThreadPool::~ThreadPool()
+{
+	Destroy();
+}
+
+void ThreadPool::Create(int threadCount)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = static_cast<int>(std::thread::hardware_concurrency());
+	}
+
+	stopping = false;
+	nextIteration.store(0);
+	for (int i = 1; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+void ThreadPool::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		iterationCount = count;
+		nextIteration.store(0);
+		busyWorkers = static_cast<int>(workers.size());
+		generation++;
+	}
+	jobAvailable.notify_all();
+
+	RunIterations();
+
+	// The job must stay alive until every worker has stopped looking at it
+	std::unique_lock<std::mutex> lock(mutex);
+	jobDone.wait(lock, [this]() { return busyWorkers == 0; });
+	this->job = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	Profiler::SetThreadName("Worker");
+
+	long long seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this, seenGeneration]() { return stopping || generation != seenGeneration; });
+			if (stopping)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		RunIterations();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+		{
+			jobDone.notify_one();
+		}
+	}
+}
+
+void ThreadPool::RunIterations()
+{
+	while (true)
+	{
+		int iteration = nextIteration.fetch_add(1);
+		if (iteration >= iterationCount)
+		{
+			return;
+		}
+		(*job)(iteration);
+	}
+}
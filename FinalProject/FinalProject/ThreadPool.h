@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A fixed set of worker threads that run the iterations of a parallel loop.
+///
+/// ParallelFor() publishes a job to every worker and takes part in it itself; iterations are handed out one at a
+/// time through an atomic counter, so threads that finish early simply take more of them.
+/// </summary>
+class ThreadPool
+{
+public:
+	~ThreadPool();
+
+	/// <summary>
+	/// Starts the worker threads.
+	/// </summary>
+	/// <param name="threadCount">Total number of threads working on a job, including the calling thread
+	/// (0 to use every hardware thread)</param>
+	void Create(int threadCount);
+
+	/// <summary>
+	/// Stops and joins the worker threads.
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Runs job(i) for every i in [0, count) and returns when all of them are done.
+	/// </summary>
+	void ParallelFor(int count, const std::function<void(int)>& job);
+
+	/// <returns>Number of threads working on a job, including the calling thread</returns>
+	int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+private:
+	/// <summary>
+	/// Waits for jobs and works on them. Runs on every worker thread.
+	/// </summary>
+	void WorkerLoop();
+
+	/// <summary>
+	/// Takes iterations of the current job until there are none left.
+	/// </summary>
+	void RunIterations();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobDone;
+
+	const std::function<void(int)>* job = nullptr;
+	int iterationCount = 0;
+	std::atomic<int> nextIteration;
+	int busyWorkers = 0;
+	long long generation = 0;
+	bool stopping = false;
+};
@@ -0,0 +1,128 @@
+#include "TransformBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BatchTransform.h"
+
+// Number of timed runs per kernel; the fastest one is reported, which filters out interruptions
+static const int BenchmarkRuns = 15;
+
+// Largest difference from glm that still counts as a match (the kernels reorder the floating-point operations)
+static const float MaxAllowedError = 1e-3f;
+
+/// <summary>
+/// Runs a function several times.
+/// </summary>
+/// <returns>Duration of the fastest run in milliseconds</returns>
+template <typename Function>
+static double TimeBest(Function function)
+{
+	double best = 1e30;
+	for (int run = 0; run < BenchmarkRuns; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		auto end = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static float MaxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b)
+{
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				maxDifference = std::max(maxDifference, std::abs(a[i][c][r] - b[i][c][r]));
+			}
+		}
+	}
+	return maxDifference;
+}
+
+int RunTransformBenchmarks(size_t objectCount)
+{
+	// Random transforms in a range similar to the scene; the seed is fixed so that runs are comparable
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+	std::uniform_real_distribution<float> scale(0.1f, 3.0f);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+
+	TransformArrays transforms;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		glm::vec3 rotationAxis(axis(random), axis(random), axis(random) + 1.5f);
+		glm::quat rotation = glm::angleAxis(angle(random), glm::normalize(rotationAxis));
+		transforms.Add(glm::vec3(position(random), position(random), position(random)), rotation,
+			glm::vec3(scale(random), scale(random), scale(random)));
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+
+	// Reference: what the renderer used to do for every object
+	std::vector<glm::mat4> referenceModels(objectCount);
+	std::vector<glm::mat4> referenceResults(objectCount);
+	double referenceTime = TimeBest([&]()
+	{
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			glm::vec3 t(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+			glm::quat q(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]);
+			glm::vec3 s(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]);
+			referenceModels[i] = glm::translate(glm::mat4(1.0f), t) * glm::mat4_cast(q) * glm::scale(glm::mat4(1.0f), s);
+			referenceResults[i] = viewProjection * referenceModels[i];
+		}
+	});
+
+	std::cout << "Transform benchmark: " << objectCount << " objects, best of " << BenchmarkRuns << " runs" << std::endl;
+	std::cout << "Best instruction set: " << GetSimdLevelName(DetectSimdLevel()) << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "  glm (per object)           " << std::setw(8) << referenceTime << " ms" << std::endl;
+
+	std::vector<glm::mat4> models(objectCount);
+	std::vector<glm::mat4> results(objectCount);
+	bool allMatch = true;
+	for (int level = 0; level <= DetectSimdLevel(); level++)
+	{
+		SimdLevel simdLevel = static_cast<SimdLevel>(level);
+
+		double composeTime = TimeBest([&]()
+		{
+			ComposeTransforms(transforms, 0, objectCount, &viewProjection, models.data(), results.data(), simdLevel);
+		});
+		float composeError = std::max(MaxDifference(models, referenceModels), MaxDifference(results, referenceResults));
+
+		// The renderer's other use: models that are already built, multiplied by the new view-projection every frame
+		double multiplyTime = TimeBest([&]()
+		{
+			MultiplyMatrices(viewProjection, referenceModels.data(), results.data(), objectCount, simdLevel);
+		});
+		float multiplyError = MaxDifference(results, referenceResults);
+
+		bool match = composeError <= MaxAllowedError && multiplyError <= MaxAllowedError;
+		allMatch = allMatch && match;
+
+		std::cout << "  " << std::left << std::setw(7) << GetSimdLevelName(simdLevel) << std::right
+			<< " compose " << std::setw(8) << composeTime << " ms (" << std::setprecision(2) << referenceTime / composeTime << "x)"
+			<< std::setprecision(3) << ", multiply " << std::setw(8) << multiplyTime << " ms"
+			<< ", max error " << std::scientific << std::max(composeError, multiplyError) << std::fixed
+			<< (match ? "" : "  MISMATCH") << std::endl;
+	}
+
+	return allMatch ? 0 : 1;
+}
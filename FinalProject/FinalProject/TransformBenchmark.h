@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+/// <summary>
+/// Times the batch transform kernels against the per-object glm code they replace and prints the results.
+///
+/// Every kernel builds the model and model-view-projection matrices of the same random transforms; the best of
+/// several runs is reported, together with the largest difference from the glm results.
+/// </summary>
+/// <param name="objectCount">Number of transforms per run</param>
+/// <returns>0 if every kernel matches glm, 1 otherwise (usable as the exit code of the program)</returns>
+int RunTransformBenchmarks(size_t objectCount);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/// <summary>
+/// Struct containing data about a vertex
+/// </summary>
+struct Vertex
+{
+	GLfloat x, y, z;	// Position
+	GLubyte r, g, b;	// Color
+	GLfloat u, v;		// UV coordinates
+	GLfloat nx, ny, nz; // Normal Vectors
+	GLfloat lu = 0.0f, lv = 0.0f;	// Lightmap UV coordinates (second UV set, zero for meshes without a lightmap)
+
+};
+
+/// <summary>
+/// Compares two vertices attribute by attribute (the padding bytes after the color are ignored).
+/// </summary>
+inline bool operator==(const Vertex& a, const Vertex& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z
+		&& a.r == b.r && a.g == b.g && a.b == b.b
+		&& a.u == b.u && a.v == b.v
+		&& a.nx == b.nx && a.ny == b.ny && a.nz == b.nz
+		&& a.lu == b.lu && a.lv == b.lv;
+}